@@ -0,0 +1,192 @@
+/******************************************************************************
+ * File Name:	adc.c
+ * Program:		Project for Real-Time Embedded Systems Programming class
+ * Purpose:		Background A/D sampling. The ADC free-runs, and its ISR
+ *				steps through the channels in round-robin order. Each
+ *				channel has a ring of its last ADC_AVERAGE_SIZE conversions
+ *				and a running sum of them, so a boxcar average is always
+ *				ready and can be read in constant time. Nobody ever waits
+ *				for a conversion.
+ *
+ *				In free-running mode the next conversion starts as soon as
+ *				one finishes, so a change to ADMUX in the ISR only affects
+ *				the conversion after the one already under way. The ISR
+ *				keeps track of which channel each conversion belongs to.
+ ******************************************************************************/
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+
+#include "lib.h"
+#include "errors.h"
+#include "profile.h"
+#include "adc.h"
+
+/* ADMUX value for each channel, indexed by eAtoDChannelType. All use the
+ * AVCC reference, right-adjusted. */
+static const unsigned char ChannelMux[ADC_NUM_CHANNELS] PROGMEM =
+{
+	_BV(REFS0) | _BV(MUX0),		// ADC_CHANNEL_TEMP: ADC1
+	_BV(REFS0)					// ADC_CHANNEL_DTOA: ADC0
+};
+
+#define ADC_AVERAGE_INDEX(i)	((i) & (ADC_AVERAGE_SIZE - 1))
+
+/* Per-channel averaging rings and running sums. Only the ISR writes them. */
+static unsigned int auiSamples[ADC_NUM_CHANNELS][ADC_AVERAGE_SIZE];
+static unsigned char aucSampleIndex[ADC_NUM_CHANNELS];
+static volatile unsigned int auiSampleSum[ADC_NUM_CHANNELS];
+static eBooleanType abPrimed[ADC_NUM_CHANNELS];
+
+/* Channel of the conversion now finishing, and of the one already started */
+static unsigned char ucConvertingChannel;
+static unsigned char ucQueuedChannel;
+
+static volatile unsigned int uiConversions;
+
+/******************************************************************************
+ * Initialization for A/D. Starts the ADC free-running on the first channel,
+ * with its interrupt feeding the averages.
+ *****************************************************************************/
+void InitAtoD(void)
+{
+	unsigned char i;
+
+	for (i = 0; i < ADC_NUM_CHANNELS; ++i)
+	{
+		abPrimed[i] = FALSE;
+		auiSampleSum[i] = 0;
+		aucSampleIndex[i] = 0;
+	}
+	uiConversions = 0;
+
+	/*------------------ Set ADMUX values --------------------------
+	 * First channel. The first two conversions are both on it, since the
+	 * ISR's ADMUX change is a conversion behind.
+	 */
+	ADMUX = pgm_read_byte(&ChannelMux[0]);
+	ucConvertingChannel = 0;
+	ucQueuedChannel = 0;
+
+	/*------------------ Set ADCSRB values --------------------------
+	 * Bit(s)   6: ACME   = 0  No analog multiplexing
+	 *          3  MUX5   = 0
+	 *        2-0: ADTS   = 0  Free running mode on A/D conversion.
+	 */
+	ADCSRB = 0;
+
+	/*------------------ Set DIDR0 and DIDR2 values -----------------
+	 * Bit(s) 7-0:  ADCxD = 1  Disable all digital input buffers.
+	 */
+	DIDR0 = 0xFF;
+	DIDR2 = 0xFF;
+
+	/*------------------ Set ADCSRA values --------------------------
+	 * Bit(s)   7:  ADEN  = 1  Enable the ADC
+	 *          6:  ADSC  = 1  Start a conversion
+	 *          5: ADATE  = 1  Enable auto triggering
+	 *          4:  ADIF  = 1  Clear any pending interrupt
+	 *          3:  ADIE  = 1  Enable interrupt
+	 *        2-0: ADPS   = 7  Divide 8 MHz clock by 128 to get 62.5 kHz,
+	 *                         about 4800 conversions/second.
+	 */
+	ADCSRA = _BV(ADEN) | _BV(ADSC) | _BV(ADATE) | _BV(ADIF) | _BV(ADIE)
+					   | _BV(ADPS2) | _BV(ADPS1) | _BV(ADPS0);
+}
+
+/******************************************************************************
+ * Returns the sum of the last ADC_AVERAGE_SIZE conversions on a channel.
+ * That's the average with ADC_AVERAGE_SHIFT extra bits of resolution.
+ * Returns 0 until the channel's first conversion.
+ *****************************************************************************/
+unsigned int GetAtoDSum(eAtoDChannelType Channel)
+{
+	unsigned int uiSum;
+	unsigned char ucSREG;
+
+	if (Channel >= ADC_NUM_CHANNELS)
+	{
+		ReportError(PARAMETER_OUT_OF_RANGE);
+		return 0;
+	}
+
+	// 16-bit read; don't let the ADC ISR change it halfway through.
+	ucSREG = SREG;
+	cli();
+	uiSum = auiSampleSum[Channel];
+	SREG = ucSREG;
+	return uiSum;
+}
+
+/******************************************************************************
+ * Returns the average of the last ADC_AVERAGE_SIZE conversions on a channel,
+ * in A/D counts.
+ *****************************************************************************/
+unsigned int GetAtoDAverage(eAtoDChannelType Channel)
+{
+	// Round to nearest
+	return (GetAtoDSum(Channel) + (ADC_AVERAGE_SIZE / 2)) >> ADC_AVERAGE_SHIFT;
+}
+
+/******************************************************************************
+ * Returns the number of conversions since InitAtoD. It wraps at 65536. Two
+ * reads 2 * ADC_NUM_CHANNELS * ADC_AVERAGE_SIZE conversions apart mean every
+ * average has been wholly refreshed.
+ *****************************************************************************/
+unsigned int GetAtoDCount(void)
+{
+	unsigned int uiCount;
+	unsigned char ucSREG;
+
+	ucSREG = SREG;
+	cli();
+	uiCount = uiConversions;
+	SREG = ucSREG;
+	return uiCount;
+}
+
+/*****************************************************************************
+ * Interrupt Handler for A/D Conversion Complete. Adds the result to its
+ * channel's average, then picks the channel for the conversion after next.
+ *****************************************************************************/
+ISR(ADC_vect)
+{
+	unsigned int uiSample;
+	unsigned char ucChannel;
+	unsigned char ucIndex;
+	unsigned char i;
+	PROFILE_START(PROFILE_ADC);
+
+	uiSample = ADC;		// Read both bytes in one operation
+	ucChannel = ucConvertingChannel;
+
+	if (abPrimed[ucChannel] == FALSE)
+	{	// First result. Fill the ring with it, so the average is right
+		// from the start.
+		for (i = 0; i < ADC_AVERAGE_SIZE; ++i)
+		{
+			auiSamples[ucChannel][i] = uiSample;
+		}
+		auiSampleSum[ucChannel] = uiSample << ADC_AVERAGE_SHIFT;
+		abPrimed[ucChannel] = TRUE;
+	}
+	else
+	{	// Boxcar: swap the oldest sample for the newest in the sum
+		ucIndex = aucSampleIndex[ucChannel];
+		auiSampleSum[ucChannel] += uiSample - auiSamples[ucChannel][ucIndex];
+		auiSamples[ucChannel][ucIndex] = uiSample;
+		aucSampleIndex[ucChannel] = ADC_AVERAGE_INDEX(ucIndex + 1);
+	}
+	++uiConversions;
+
+	// The conversion already running is on the queued channel. Queue the
+	// next one behind it.
+	ucConvertingChannel = ucQueuedChannel;
+	if (++ucQueuedChannel >= ADC_NUM_CHANNELS)
+	{
+		ucQueuedChannel = 0;
+	}
+	ADMUX = pgm_read_byte(&ChannelMux[ucQueuedChannel]);
+
+	PROFILE_END(PROFILE_ADC);
+}
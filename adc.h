@@ -0,0 +1,29 @@
+/******************************************************************************
+ * File Name:	adc.h
+ * Program:		Project for Real-Time Embedded Systems Programming class
+ * Purpose:		Header file for adc.c file.
+ ******************************************************************************/
+#if !defined(ADC_H)		/* Prevents including this file multiple times */
+#define ADC_H
+
+/* Number of conversions averaged for each channel. Must be a power of 2,
+ * and no more than 64, so the sum of 10-bit samples fits in 16 bits. */
+#define ADC_AVERAGE_SIZE                16
+#define ADC_AVERAGE_SHIFT               4	/* log2(ADC_AVERAGE_SIZE) */
+
+/* Channels sampled, in round-robin order. Indexes into the channel table
+ * in adc.c. */
+typedef enum
+{
+	ADC_CHANNEL_TEMP = 0,		// ADC1, thermistor
+	ADC_CHANNEL_DTOA,			// ADC0, D/A output read back
+	ADC_NUM_CHANNELS
+} eAtoDChannelType;
+
+/* Function Prototypes */
+void InitAtoD(void);
+unsigned int GetAtoDAverage(eAtoDChannelType);	// 10-bit average
+unsigned int GetAtoDSum(eAtoDChannelType);		// Sum of the last ADC_AVERAGE_SIZE
+unsigned int GetAtoDCount(void);				// Conversions since reset, wraps
+
+#endif /* ADC_H */
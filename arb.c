@@ -0,0 +1,543 @@
+/******************************************************************************
+ * File Name:	arb.c
+ * Program:		Project for Real-Time Embedded Systems Programming class
+ * Purpose:		Arbitrary waveform upload. The host sends a block of D/A
+ *				samples over the serial port in frames (see arb.h), and the
+ *				waveform generator plays it back in WAVE_MODE_ARBITRARY.
+ *
+ *				While an upload runs, the serial RX ISR hands every byte to
+ *				ArbReceiveByte instead of the menu's input buffer. It decodes
+ *				the frame as it arrives, writing the samples straight into
+ *				the sample ring, and only moves the ring's head once the CRC
+ *				and sequence number check out. The ISR only writes the head
+ *				and the producer only writes the tail, as in samplebuf.c, but
+ *				the indexes are 16 bits, so each side reads the other's with
+ *				interrupts disabled.
+ *
+ *				Replies are sent from the foreground loop. A block played
+ *				once is streamed through the ring, and the ACK for a frame is
+ *				held back until there's room for another, which paces the
+ *				host to the sample rate.
+ *
+ *				If nothing arrives for ARB_TIMEOUT_MS, the upload is
+ *				abandoned, so a host that has gone away can't keep the menu
+ *				locked out.
+ ******************************************************************************/
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <util/crc16.h>
+
+#include "lib.h"
+#include "errors.h"
+#include "config.h"
+#include "sched.h"
+#include "serial.h"
+#include "dtoa.h"
+#include "waveform.h"
+#include "arb.h"
+#include "trace.h"
+
+/* Time with nothing received before an upload is abandoned, in mSecs */
+#define ARB_TIMEOUT_MS                  2000
+#define ARB_TIMEOUT_TICKS               ((unsigned int)TICKS_FOR_MS(ARB_TIMEOUT_MS))
+
+/* Macros for the ring indexes */
+#define ARB_INDEX(index)				((index) & (ARB_BUFFER_SIZE - 1))
+#define ARB_COUNT(head, tail)			ARB_INDEX((head) - (tail))
+#define ARB_SPACE(head, tail)			((ARB_BUFFER_SIZE - 1) - ARB_COUNT(head, tail))
+
+/* Where the RX decoder is in a frame */
+typedef enum
+{
+	ARB_RX_SYNC1 = 0,
+	ARB_RX_SYNC2,
+	ARB_RX_SEQ,
+	ARB_RX_COUNT,
+	ARB_RX_SAMPLE_LOW,
+	ARB_RX_SAMPLE_HIGH,
+	ARB_RX_CRC_LOW,
+	ARB_RX_CRC_HIGH,
+	ARB_RX_DISCARD			// Upload stopped. Ignore the rest.
+} ArbRxStateType;
+
+/* Foreground state */
+typedef enum
+{
+	ARB_IDLE = 0,
+	ARB_UPLOADING,
+	ARB_PLAYING
+} ArbStateType;
+
+static ArbStateType ArbState = ARB_IDLE;
+static eArbModeType ArbMode = ARB_ONCE;
+static eErrorType ArbResult = NO_ERROR;
+static unsigned int uiIdleStart;		// Tick of the last sign of the host
+
+/* Sample ring */
+static unsigned int auiArbSamples[ARB_BUFFER_SIZE];
+static volatile unsigned int uiArbHead = 0;	// RX ISR only writes this
+static volatile unsigned int uiArbTail = 0;	// Producer only writes this
+
+/* Playback. Only the producer, in the foreground, uses these. */
+static eBooleanType bArbPlaying = FALSE;
+static eBooleanType bArbFinished = FALSE;
+static unsigned int uiArbPlay = 0;		// Next sample, when looping
+static unsigned int uiLastSample = 0;
+static unsigned int uiArbGaps = 0;
+
+/* RX decoder. Only the RX ISR uses these. */
+static ArbRxStateType RxState = ARB_RX_SYNC1;
+static unsigned char ucRxSeq;
+static unsigned char ucRxExpected;
+static unsigned char ucRxLeft;
+static unsigned char ucRxLow;
+static unsigned char ucRxCount;
+static unsigned int uiRxIndex;
+static unsigned int uiRxCRC;
+
+/* Set by the RX ISR for the foreground */
+static volatile unsigned char ucArbReply = 0;	// 0 if none waiting
+static volatile unsigned char ucArbReplySeq;
+static volatile eBooleanType bArbRxActivity = FALSE;
+static volatile eBooleanType bArbEnded = FALSE;
+static volatile eBooleanType bArbOverflow = FALSE;
+static volatile unsigned long ulArbSamples = 0;
+static volatile unsigned int uiArbFrames = 0;
+static volatile unsigned int uiArbRetries = 0;
+
+static void ArbReceiveByte(unsigned char ucData, eBooleanType bError);
+static void EndFrame(unsigned char ucReply, unsigned char ucSeq);
+static void StopUpload(eErrorType Result);
+
+/******************************************************************************
+ * Starts an upload, and selects arbitrary mode to play it. Anything already
+ * playing is stopped; the D/A holds its value until the new block starts.
+ ******************************************************************************/
+eErrorType StartArbUpload(eArbModeType Mode)
+{
+	WaveStatusType Status;
+
+	if (Mode > ARB_LOOP)
+	{
+		return INVALID_PARAMETER;
+	}
+	if (ArbState == ARB_UPLOADING)
+	{
+		return INVALID_PARAMETER;
+	}
+
+	/* The RX handler isn't set yet and the producer only runs in the
+	 * foreground, so nothing else is using these. */
+	ArbMode      = Mode;
+	ArbResult    = NO_ERROR;
+	bArbPlaying  = FALSE;
+	bArbFinished = FALSE;
+	uiArbPlay    = 0;
+	uiLastSample = GetDtoAValue();
+	uiArbGaps    = 0;
+	uiArbHead    = 0;
+	uiArbTail    = 0;
+
+	RxState        = ARB_RX_SYNC1;
+	ucRxExpected   = 0;
+	ucArbReply     = 0;
+	bArbRxActivity = FALSE;
+	bArbEnded      = FALSE;
+	bArbOverflow   = FALSE;
+	ulArbSamples   = 0;
+	uiArbFrames    = 0;
+	uiArbRetries   = 0;
+
+	SetWaveMode(WAVE_MODE_ARBITRARY);
+	GetWaveStatus(&Status);
+	if (Status.Shape == WAVE_OFF)
+	{	// Any other shape plays the block
+		SetWaveShape(WAVE_SINE);
+	}
+
+	ArbState = ARB_UPLOADING;
+	uiIdleStart = GetTickCount();
+	SCISetRxHandler(ArbReceiveByte);
+	return NO_ERROR;
+}
+
+/******************************************************************************
+ * Sends replies, starts playback, and watches for the upload ending or
+ * timing out. Called from the foreground loop.
+ ******************************************************************************/
+void ServiceArbitrary(void)
+{
+	unsigned char aucReply[2];
+	unsigned char ucSREG;
+	unsigned int uiStored;
+	unsigned int uiTicks;
+	eBooleanType bTxRoom;
+
+	if (ArbState == ARB_IDLE)
+	{
+		return;
+	}
+
+	if (ArbState == ARB_PLAYING)
+	{	// Only a block played once comes to an end
+		if (bArbFinished == TRUE)
+		{
+			SetWaveShape(WAVE_OFF);
+			ArbState = ARB_IDLE;
+		}
+		return;
+	}
+
+	uiTicks = GetTickCount();
+	bTxRoom = (SCITxSpace() >= sizeof(aucReply)) ? TRUE : FALSE;
+
+	ucSREG = SREG;
+	cli();
+	uiStored = ARB_COUNT(uiArbHead, uiArbTail);
+	aucReply[0] = ucArbReply;
+	aucReply[1] = ucArbReplySeq;
+	if ((aucReply[0] == ARB_ACK) && (ArbMode == ARB_ONCE) &&
+		(ARB_SPACE(uiArbHead, uiArbTail) < ARB_MAX_FRAME_SAMPLES))
+	{	// No room for another frame yet. The host waits for the ACK, so
+		// this doesn't count as it going quiet.
+		aucReply[0] = 0;
+		bArbRxActivity = TRUE;
+	}
+	else if (bTxRoom == FALSE)
+	{	// Try again next time
+		aucReply[0] = 0;
+	}
+	else
+	{
+		ucArbReply = 0;
+	}
+	SREG = ucSREG;
+
+	if (aucReply[0] != 0)
+	{
+		SCIWriteBlock(aucReply, sizeof(aucReply));
+	}
+
+	if ((ArbMode == ARB_ONCE) && (bArbPlaying == FALSE) &&
+		((uiStored >= ARB_PREROLL_SAMPLES) || (bArbEnded == TRUE)))
+	{
+		bArbPlaying = TRUE;
+	}
+
+	if (bArbRxActivity == TRUE)
+	{
+		bArbRxActivity = FALSE;
+		uiIdleStart = uiTicks;
+	}
+
+	if (ucArbReply != 0)
+	{	// Last reply not sent yet
+		return;
+	}
+
+	if (bArbOverflow == TRUE)
+	{
+		StopUpload(ARB_BUFFER_FULL);
+	}
+	else if (bArbEnded == TRUE)
+	{
+		SCISetRxHandler(0);
+		ArbState = ARB_PLAYING;
+		if (ArbMode == ARB_LOOP)
+		{	// The head doesn't move any more
+			bArbPlaying = (uiArbHead != 0) ? TRUE : FALSE;
+		}
+	}
+	else if ((unsigned int)(uiTicks - uiIdleStart) >= ARB_TIMEOUT_TICKS)
+	{
+		StopUpload(ARB_UPLOAD_TIMEOUT);
+	}
+}
+
+/******************************************************************************
+ * Returns TRUE if ServiceArbitrary has something to do now: a reply it can
+ * send, the end of the upload or of playing, or the start of playing.
+ * Called by IdleSleep with interrupts disabled.
+ ******************************************************************************/
+eBooleanType ArbitraryWorkPending(void)
+{
+	if (ArbState == ARB_IDLE)
+	{
+		return FALSE;
+	}
+
+	if (ArbState == ARB_PLAYING)
+	{
+		return bArbFinished;
+	}
+
+	if ((ArbMode == ARB_ONCE) && (bArbPlaying == FALSE) &&
+		((ARB_COUNT(uiArbHead, uiArbTail) >= ARB_PREROLL_SAMPLES) ||
+		 (bArbEnded == TRUE)))
+	{
+		return TRUE;
+	}
+
+	if (ucArbReply != 0)
+	{	// Nothing else happens until it's gone; see ServiceArbitrary
+		if (((ucArbReply == ARB_ACK) && (ArbMode == ARB_ONCE) &&
+			 (ARB_SPACE(uiArbHead, uiArbTail) < ARB_MAX_FRAME_SAMPLES)) ||
+			(SCITxSpace() < 2))
+		{
+			return FALSE;
+		}
+		return TRUE;
+	}
+
+	return ((bArbOverflow == TRUE) || (bArbEnded == TRUE) ||
+			((unsigned int)(GetTickCount() - uiIdleStart) >= ARB_TIMEOUT_TICKS)) ?
+			TRUE : FALSE;
+}
+
+/******************************************************************************
+ * Returns TRUE until the upload has ended, successfully or not. A block
+ * played once may still be playing.
+ ******************************************************************************/
+eBooleanType ArbUploadBusy(void)
+{
+	return (ArbState == ARB_UPLOADING) ? TRUE : FALSE;
+}
+
+/******************************************************************************
+ * Copies the progress of the last upload.
+ ******************************************************************************/
+void GetArbStatus(ArbStatusType *ptrStatus)
+{
+	unsigned char ucSREG;
+
+	ptrStatus->Result = ArbResult;
+	ptrStatus->uiGaps = uiArbGaps;
+
+	// Multi-byte values the RX ISR changes
+	ucSREG = SREG;
+	cli();
+	ptrStatus->ulSamples = ulArbSamples;
+	ptrStatus->uiRetries = uiArbRetries;
+	SREG = ucSREG;
+}
+
+/******************************************************************************
+ * Sample producer for arbitrary mode. Called from the foreground loop to
+ * get the next sample. Until playback starts, and when the host falls
+ * behind, it repeats the last sample.
+ ******************************************************************************/
+unsigned int ProduceArbSample(void)
+{
+	unsigned int uiHead;
+	unsigned char ucSREG;
+
+	if (bArbPlaying == FALSE)
+	{
+		return uiLastSample;
+	}
+
+	if (ArbMode == ARB_LOOP)
+	{	// The whole block is stored, from 0 up to the head
+		uiLastSample = auiArbSamples[uiArbPlay];
+		if (++uiArbPlay >= uiArbHead)
+		{
+			uiArbPlay = 0;
+		}
+		return uiLastSample;
+	}
+
+	ucSREG = SREG;
+	cli();
+	uiHead = uiArbHead;
+	SREG = ucSREG;
+
+	if (uiArbTail == uiHead)
+	{
+		if (bArbEnded == TRUE)
+		{
+			bArbFinished = TRUE;
+		}
+		else if (uiArbGaps != 0xFFFF)
+		{
+			++uiArbGaps;
+		}
+		return uiLastSample;
+	}
+
+	uiLastSample = auiArbSamples[uiArbTail];
+
+	ucSREG = SREG;
+	cli();
+	uiArbTail = ARB_INDEX(uiArbTail + 1);
+	SREG = ucSREG;
+
+	return uiLastSample;
+}
+
+/******************************************************************************
+ * RX handler while an upload runs. Called from the RX ISR with each byte,
+ * so interrupts are disabled.
+ ******************************************************************************/
+static void ArbReceiveByte(unsigned char ucData, eBooleanType bError)
+{
+	unsigned int uiSample;
+
+	bArbRxActivity = TRUE;
+
+	if (RxState == ARB_RX_DISCARD)
+	{
+		return;
+	}
+
+	if (bError == TRUE)
+	{	// The frame is damaged. Ask for it again once it's over.
+		if (RxState >= ARB_RX_SEQ)
+		{
+			EndFrame(ARB_NAK, ucRxExpected);
+		}
+		RxState = ARB_RX_SYNC1;
+		return;
+	}
+
+	if ((RxState >= ARB_RX_SEQ) && (RxState <= ARB_RX_SAMPLE_HIGH))
+	{
+		uiRxCRC = _crc_xmodem_update(uiRxCRC, ucData);
+	}
+
+	switch (RxState)
+	{
+		case ARB_RX_SYNC1:
+			if (ucData == ARB_SYNC1)
+			{
+				RxState = ARB_RX_SYNC2;
+			}
+			break;
+
+		case ARB_RX_SYNC2:
+			if (ucData == ARB_SYNC2)
+			{
+				uiRxCRC = 0;
+				RxState = ARB_RX_SEQ;
+			}
+			else if (ucData != ARB_SYNC1)
+			{
+				RxState = ARB_RX_SYNC1;
+			}
+			break;
+
+		case ARB_RX_SEQ:
+			ucRxSeq = ucData;
+			RxState = ARB_RX_COUNT;
+			break;
+
+		case ARB_RX_COUNT:
+			ucRxCount = ucData;
+			ucRxLeft = ucData;
+			uiRxIndex = uiArbHead;
+			if (ucRxCount > ARB_MAX_FRAME_SAMPLES)
+			{	// Can't be a real frame
+				EndFrame(ARB_NAK, ucRxExpected);
+				RxState = ARB_RX_SYNC1;
+			}
+			else if (ucRxCount > ARB_SPACE(uiArbHead, uiArbTail))
+			{
+				if (ArbMode == ARB_LOOP)
+				{	// The block won't fit
+					bArbOverflow = TRUE;
+					EndFrame(ARB_CAN, ucRxSeq);
+					RxState = ARB_RX_DISCARD;
+				}
+				else
+				{	// Host didn't wait for the ACK. Try again later.
+					EndFrame(ARB_NAK, ucRxExpected);
+					RxState = ARB_RX_SYNC1;
+				}
+			}
+			else
+			{
+				RxState = (ucRxCount != 0) ? ARB_RX_SAMPLE_LOW : ARB_RX_CRC_LOW;
+			}
+			break;
+
+		case ARB_RX_SAMPLE_LOW:
+			ucRxLow = ucData;
+			RxState = ARB_RX_SAMPLE_HIGH;
+			break;
+
+		case ARB_RX_SAMPLE_HIGH:
+			// Goes into free space, which the producer doesn't read
+			uiSample = ((unsigned int)ucData << 8) | ucRxLow;
+			auiArbSamples[uiRxIndex] = (uiSample > DTOA_MAX_CODE) ?
+										DTOA_MAX_CODE : uiSample;
+			uiRxIndex = ARB_INDEX(uiRxIndex + 1);
+			RxState = (--ucRxLeft != 0) ? ARB_RX_SAMPLE_LOW : ARB_RX_CRC_LOW;
+			break;
+
+		case ARB_RX_CRC_LOW:
+			ucRxLow = ucData;
+			RxState = ARB_RX_CRC_HIGH;
+			break;
+
+		default:	// ARB_RX_CRC_HIGH
+			RxState = ARB_RX_SYNC1;
+			if ((((unsigned int)ucData << 8) | ucRxLow) != uiRxCRC)
+			{
+				EndFrame(ARB_NAK, ucRxExpected);
+			}
+			else if (ucRxSeq == ucRxExpected)
+			{	// New frame. Make its samples visible to the producer.
+				uiArbHead = uiRxIndex;
+				ulArbSamples += ucRxCount;
+				++uiArbFrames;
+				++ucRxExpected;
+				TRACE(ARB, TRACE_DEBUG, TRACE_ID_ARB_FRAME, ucRxSeq);
+				if (ucRxCount == 0)
+				{
+					bArbEnded = TRUE;
+					RxState = ARB_RX_DISCARD;
+				}
+				EndFrame(ARB_ACK, ucRxSeq);
+			}
+			else if ((ucRxSeq == (unsigned char)(ucRxExpected - 1)) &&
+					 (uiArbFrames != 0))
+			{	// Repeat of the last frame; its ACK was lost
+				EndFrame(ARB_ACK, ucRxSeq);
+			}
+			else
+			{
+				EndFrame(ARB_NAK, ucRxExpected);
+			}
+			break;
+	}
+}
+
+/******************************************************************************
+ * Leaves a reply for the foreground to send, and counts the frames that need
+ * sending again. Called from the RX ISR.
+ ******************************************************************************/
+static void EndFrame(unsigned char ucReply, unsigned char ucSeq)
+{
+	if (ucReply == ARB_NAK)
+	{
+		TRACE(ARB, TRACE_INFO, TRACE_ID_ARB_NAK, ucSeq);
+		if (uiArbRetries != 0xFFFF)
+		{
+			++uiArbRetries;
+		}
+	}
+	ucArbReplySeq = ucSeq;
+	ucArbReply = ucReply;
+}
+
+/******************************************************************************
+ * Abandons an upload, and stops the output. The D/A holds its last value.
+ ******************************************************************************/
+static void StopUpload(eErrorType Result)
+{
+	SCISetRxHandler(0);
+	ReportError(Result);
+	ArbResult = Result;
+	bArbPlaying = FALSE;
+	SetWaveShape(WAVE_OFF);
+	ArbState = ARB_IDLE;
+}
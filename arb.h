@@ -0,0 +1,70 @@
+/******************************************************************************
+ * File Name:	arb.h
+ * Program:		Project for Real-Time Embedded Systems Programming class
+ * Purpose:		Header file for arb.c file.
+ ******************************************************************************/
+#if !defined(ARB_H)			/* Prevents including this file multiple times */
+#define ARB_H
+
+#include "lib.h"
+#include "errors.h"
+
+/*
+ * A block is uploaded as a series of frames:
+ *
+ *   Byte 0-1:  Sync, ARB_SYNC1 then ARB_SYNC2
+ *        2:    Sequence number. The first frame is 0; it counts up and wraps.
+ *        3:    Number of samples, 0 to ARB_MAX_FRAME_SAMPLES. A frame with
+ *              no samples ends the upload.
+ *        4- :  Samples, in D/A counts (0 to 1023), 2 bytes each, LSB first
+ *   Last 2:    CRC of bytes 2 up to the end of the samples, LSB first.
+ *              XMODEM CRC, as for the memory dump.
+ *
+ * Each frame is answered with 2 bytes, a code and a sequence number:
+ *   ARB_ACK, seq       Frame stored. Send the next one.
+ *   ARB_NAK, expected  Frame damaged or out of order. Send 'expected' again.
+ *   ARB_CAN, seq       Upload stopped; the block doesn't fit.
+ * Only one frame may be outstanding. A repeat of the last frame, sent
+ * because its ACK was lost, is acknowledged again but not stored.
+ */
+#define ARB_SYNC1                       0xA5
+#define ARB_SYNC2                       0x5A
+#define ARB_ACK                         0x06
+#define ARB_NAK                         0x15
+#define ARB_CAN                         0x18
+
+#define ARB_MAX_FRAME_SAMPLES           64
+
+/* Samples held on board. Must be a power of 2. One entry is always left
+ * empty, so a looped block can be up to ARB_BUFFER_SIZE - 1 samples. A
+ * block played once can be any length; it's streamed through the buffer. */
+#define ARB_BUFFER_SIZE                 512
+
+/* A block played once starts playing when this many samples are stored, so
+ * there's some margin for the host falling behind. */
+#define ARB_PREROLL_SAMPLES             256
+
+typedef enum
+{
+	ARB_ONCE = 0,		// Play the block once as it arrives, then stop
+	ARB_LOOP			// Store the whole block, then play it repeatedly
+} eArbModeType;
+
+/* Progress of the last upload, for display */
+typedef struct
+{
+	eErrorType Result;			// NO_ERROR, or why the upload stopped
+	unsigned long ulSamples;	// Samples stored
+	unsigned int uiRetries;		// Frames that had to be sent again
+	unsigned int uiGaps;		// Samples repeated because none had arrived
+} ArbStatusType;
+
+/* Function Prototypes */
+eErrorType StartArbUpload(eArbModeType);
+void ServiceArbitrary(void);			// Called from foreground loop
+eBooleanType ArbitraryWorkPending(void);	// Called from IdleSleep
+eBooleanType ArbUploadBusy(void);
+void GetArbStatus(ArbStatusType *);
+unsigned int ProduceArbSample(void);	// Arbitrary mode's sample producer
+
+#endif /* ARB_H */
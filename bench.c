@@ -0,0 +1,239 @@
+/******************************************************************************
+ * File Name:	bench.c
+ * Program:		Project for Real-Time Embedded Systems Programming class
+ * Purpose:		On-target benchmarks of the routines whose speed matters,
+ *				in CPU cycles, so a change can be measured against the last
+ *				build on the same board.
+ *
+ *				Each benchmark calls its routine a number of times with
+ *				interrupts disabled, timed by the profiling clock (Timer
+ *				3). The cost of the timing loop itself, measured the same
+ *				way with an empty routine, is taken off. Timer 3 counts
+ *				every PROFILE_TIMER_SCALER cycles, so the more calls, the
+ *				finer the result. Keep each run to a few mSecs, so the
+ *				serial port doesn't lose characters while interrupts are off.
+ *
+ *				The same table is run without a board by the builds in
+ *				host/: under simavr, in cycles, and natively, by the host's
+ *				clock. See host/Makefile.
+ ******************************************************************************/
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+
+#include "lib.h"
+#include "errors.h"
+#include "profile.h"
+#include "format.h"
+#include "dtoa.h"
+#include "lcd.h"
+#include "tempsensor.h"
+#include "waveform.h"
+#include "menu.h"
+#include "bench.h"
+
+/* Calls per benchmark, unless the routine needs fewer */
+#define BENCH_ITERATIONS        16
+
+/* Index of the WriteDtoASample benchmark in the table */
+#define BENCH_DTOA              2
+
+typedef struct
+{
+	void (*pfnBench)(void);
+	unsigned char ucIterations;
+	PGM_P Name;
+} BenchmarkType;
+
+/* Results go here, so the compiler can't leave the calls out */
+static volatile unsigned int uiBenchSink;
+
+static void BenchEmpty(void);
+static void BenchFormatDec(void);
+static void BenchParseUnsigned(void);
+static void BenchWriteDtoA(void);
+static void BenchLCDWrite(void);
+static void BenchTemperature(void);
+static void BenchMenuCommand(void);
+
+static const char BenchName0[] PROGMEM = "  FormatDec      ";
+static const char BenchName1[] PROGMEM = "  ParseUnsigned  ";
+static const char BenchName2[] PROGMEM = "  WriteDtoASample";
+static const char BenchName3[] PROGMEM = "  LCDWrite       ";
+static const char BenchName4[] PROGMEM = "  ReadTemperature";
+static const char BenchName5[] PROGMEM = "  menu \"ge\"      ";
+
+static const BenchmarkType Benchmarks[] PROGMEM =
+{
+	{ BenchFormatDec,     BENCH_ITERATIONS, BenchName0 },
+	{ BenchParseUnsigned, BENCH_ITERATIONS, BenchName1 },
+	{ BenchWriteDtoA,     BENCH_ITERATIONS, BenchName2 },
+	{ BenchLCDWrite,      BENCH_ITERATIONS, BenchName3 },
+	{ BenchTemperature,   BENCH_ITERATIONS, BenchName4 },
+	// Each run queues a reply, so only once, or the transmit queue fills
+	{ BenchMenuCommand,   1,                BenchName5 }
+};
+
+#define NUM_BENCHMARKS	(sizeof(Benchmarks)/sizeof(Benchmarks[0]))
+
+/******************************************************************************
+ * The routines timed. Inputs are the slowest cases.
+ ******************************************************************************/
+static void BenchEmpty(void)
+{
+}
+
+static void BenchFormatDec(void)
+{
+	char zBuf[FORMAT_DEC16_SIZE];
+
+	FormatDec(zBuf, 65535, 0);
+	uiBenchSink = zBuf[0];
+}
+
+static void BenchParseUnsigned(void)
+{
+	unsigned int uiValue;
+
+	ParseUnsigned("65535", 10, &uiValue);
+	uiBenchSink = uiValue;
+}
+
+static void BenchWriteDtoA(void)
+{
+	WriteDtoASample(DTOA_MAX_CODE / 2);
+}
+
+static void BenchLCDWrite(void)
+{
+	LCDWrite('8', LCD_LAST_POSITION);
+}
+
+static void BenchTemperature(void)
+{
+	uiBenchSink = (unsigned int)ReadTemperature();
+}
+
+static void BenchMenuCommand(void)
+{
+	RunMenuLine("ge");
+}
+
+/******************************************************************************
+ * Returns the Timer 3 counts taken by calling pfnBench ucIterations times,
+ * with interrupts disabled.
+ ******************************************************************************/
+static unsigned int TimeCalls(void (*pfnBench)(void), unsigned char ucIterations)
+{
+	unsigned int uiStart, uiEnd;
+	unsigned char ucSREG;
+	unsigned char i;
+
+	ucSREG = SREG;
+	cli();
+	uiStart = ProfileTimestamp();
+	for (i = 0; i < ucIterations; ++i)
+	{
+		pfnBench();
+	}
+	uiEnd = ProfileTimestamp();
+	SREG = ucSREG;
+
+	return uiEnd - uiStart;
+}
+
+/******************************************************************************
+ * Gets ready for a set of benchmarks. The waveform is turned off, so the
+ * D/A is free and no sample interrupts are held off.
+ ******************************************************************************/
+void StartBenchmarks(void)
+{
+	SetWaveShape(WAVE_OFF);
+	while (DtoABusy() == TRUE);
+}
+
+/******************************************************************************
+ * Returns the number of benchmarks.
+ ******************************************************************************/
+unsigned char GetNumBenchmarks(void)
+{
+	return NUM_BENCHMARKS;
+}
+
+/******************************************************************************
+ * Returns a benchmark's name, padded to the same width as the others, or 0
+ * if the index is out of range.
+ ******************************************************************************/
+PGM_P GetBenchmarkName(unsigned char ucIndex)
+{
+	if (ucIndex >= NUM_BENCHMARKS)
+	{
+		return 0;
+	}
+	return (PGM_P)pgm_read_word(&Benchmarks[ucIndex].Name);
+}
+
+/******************************************************************************
+ * Runs one benchmark, and returns the CPU cycles per call, rounded. The
+ * call itself, and the loop around it, aren't counted. Returns 0 if the
+ * index is out of range.
+ ******************************************************************************/
+unsigned int RunBenchmark(unsigned char ucIndex)
+{
+	void (*pfnBench)(void);
+	unsigned char ucIterations;
+	unsigned int uiTicks, uiOverhead;
+	unsigned long ulCycles;
+
+	if (ucIndex >= NUM_BENCHMARKS)
+	{
+		ReportError(PARAMETER_OUT_OF_RANGE);
+		return 0;
+	}
+
+	pfnBench = (void (*)(void))pgm_read_word(&Benchmarks[ucIndex].pfnBench);
+	ucIterations = pgm_read_byte(&Benchmarks[ucIndex].ucIterations);
+
+	uiOverhead = TimeCalls(BenchEmpty, ucIterations);
+	uiTicks = TimeCalls(pfnBench, ucIterations);
+	if (uiTicks < uiOverhead)
+	{	// Too quick to see
+		return 0;
+	}
+
+	ulCycles = (unsigned long)(uiTicks - uiOverhead) * PROFILE_TIMER_SCALER;
+	return (unsigned int)((ulCycles + (ucIterations / 2)) / ucIterations);
+}
+
+/******************************************************************************
+ * Calls one benchmark's routine once, untimed, for timing by some other
+ * clock, as the host build does. Does nothing if the index is out of range.
+ ******************************************************************************/
+void CallBenchmark(unsigned char ucIndex)
+{
+	void (*pfnBench)(void);
+
+	if (ucIndex < NUM_BENCHMARKS)
+	{
+		pfnBench = (void (*)(void))pgm_read_word(&Benchmarks[ucIndex].pfnBench);
+		pfnBench();
+	}
+}
+
+/******************************************************************************
+ * Returns the most samples per second the D/A can be written at, from the
+ * time WriteDtoASample takes at this F_CPU. Nothing else is counted, so a
+ * waveform's sample ISR can't quite reach it. Returns 0 if it's too quick
+ * to measure.
+ ******************************************************************************/
+unsigned long MeasureDtoARate(void)
+{
+	unsigned int uiCycles;
+
+	uiCycles = RunBenchmark(BENCH_DTOA);
+	if (uiCycles == 0)
+	{
+		return 0;
+	}
+	return F_CPU / uiCycles;
+}
@@ -0,0 +1,19 @@
+/******************************************************************************
+ * File Name:	bench.h
+ * Program:		Project for Real-Time Embedded Systems Programming class
+ * Purpose:		Header file for bench.c file.
+ ******************************************************************************/
+#if !defined(BENCH_H)		/* Prevents including this file multiple times */
+#define BENCH_H
+
+#include <avr/pgmspace.h>
+
+/* Function Prototypes */
+void StartBenchmarks(void);
+unsigned char GetNumBenchmarks(void);
+PGM_P GetBenchmarkName(unsigned char);
+unsigned int RunBenchmark(unsigned char);	// Returns CPU cycles per call
+void CallBenchmark(unsigned char);			// Once, untimed
+unsigned long MeasureDtoARate(void);		// Returns samples/sec
+
+#endif /* BENCH_H */
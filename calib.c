@@ -0,0 +1,455 @@
+/******************************************************************************
+ * File Name:	calib.c
+ * Program:		Project for Real-Time Embedded Systems Programming class
+ * Purpose:		D/A calibration and self-test, using the A/D to read the
+ *				D/A output back.
+ *
+ *				A calibration sweeps the D/A through CAL_NUM_POINTS codes,
+ *				and records the averaged A/D reading at each. Those points
+ *				are this board's transfer curve. They're kept in EEPROM,
+ *				and at startup they're expanded into a correction table in
+ *				RAM, one signed byte per code. The D/A driver adds the
+ *				entry to every sample as it's sent, so the correction costs
+ *				one table read per sample, whatever the waveform mode.
+ *
+ *				The ideal board reads back the code it was sent, so the
+ *				table picks, for each wanted value, the code whose reading
+ *				is nearest to it.
+ *
+ *				Everything is done from ServiceCalibration(), called from the
+ *				foreground loop. It never waits: it returns until the A/D
+ *				averages have caught up with the D/A, and writes the EEPROM
+ *				a byte at a time when it's ready. A full calibration takes
+ *				well under a second.
+ ******************************************************************************/
+#include <stddef.h>
+#include <avr/io.h>
+#include <avr/eeprom.h>
+#include <util/crc16.h>
+
+#include "lib.h"
+#include "errors.h"
+#include "adc.h"
+#include "dtoa.h"
+#include "waveform.h"
+#include "calib.h"
+
+/* Marks a calibration record in EEPROM */
+#define CAL_MAGIC                   0xCA1B
+
+/* A/D conversions to wait after changing the D/A, before the readback
+ * average is all new. The extra two per channel cover the conversions
+ * already under way. */
+#define CAL_SETTLE_CONVERSIONS      (ADC_NUM_CHANNELS * (ADC_AVERAGE_SIZE + 2))
+
+/* Codes expanded per ServiceCalibration call while the table is built */
+#define CAL_BUILD_CHUNK             64
+
+/* Readings are sums of ADC_AVERAGE_SIZE conversions */
+#define CAL_FULL_SCALE              ((unsigned int)DTOA_MAX_CODE << ADC_AVERAGE_SHIFT)
+#define CAL_MAX_ERROR_SUM           (CAL_MAX_ERROR << ADC_AVERAGE_SHIFT)
+
+/* The full-scale span must be within 25% of ideal, or the readback probably
+ * isn't connected */
+#define CAL_MIN_SPAN                ((CAL_FULL_SCALE / 4) * 3)
+#define CAL_MAX_SPAN                ((CAL_FULL_SCALE / 4) * 5)
+
+/* Code measured at each point */
+#define CAL_POINT_CODE(k)			\
+	(((k) < (CAL_NUM_POINTS - 1)) ? ((unsigned int)(k) << CAL_POINT_SHIFT) : DTOA_MAX_CODE)
+
+/* What's kept in EEPROM. The CRC covers everything before it, and is
+ * written last, so a half-written record is never used. */
+typedef struct
+{
+	unsigned int uiMagic;
+	unsigned int auiPoints[CAL_NUM_POINTS];	// Readings, 1/16 A/D counts
+	unsigned int uiCRC;
+} CalRecordType;
+
+typedef enum
+{
+	CAL_IDLE = 0,
+	CAL_SETTLE,			// Waiting for the readback of a point
+	CAL_BUILD,			// Expanding the points into the table
+	CAL_SAVE			// Writing the record to EEPROM
+} eCalStateType;
+
+static CalRecordType EEMEM CalRecordEE;
+static CalRecordType CalRecord;
+
+/* Added to each sample by the D/A driver, indexed by sample */
+static signed char acCorrection[DTOA_NUM_CODES];
+
+static eCalStateType CalState = CAL_IDLE;
+static eCalModeType CalMode;
+static eBooleanType bCalVerifying;
+static unsigned char ucCalPoint;
+static unsigned char ucCalSegment;
+static unsigned int uiCalIndex;
+static unsigned int uiCalStartCount;
+static CalResultType CalResult;
+
+static void StartCalPoint(void);
+static void FinishSweep(void);
+static void FailCalibration(void);
+static eBooleanType CheckCalPoints(void);
+static unsigned int GetRecordCRC(void);
+static void BuildCorrection(unsigned int uiCount);
+
+/******************************************************************************
+ * Loads this board's calibration from EEPROM, if there is one, and puts
+ * it in use. Call after InitDtoA.
+ ******************************************************************************/
+void InitCalibration(void)
+{
+	CalResult.bCalibrated = FALSE;
+	CalResult.bPassed = FALSE;
+	CalResult.uiMaxError = 0;
+
+	eeprom_read_block(&CalRecord, &CalRecordEE, sizeof(CalRecord));
+	if ((CalRecord.uiMagic != CAL_MAGIC) ||
+		(CalRecord.uiCRC != GetRecordCRC()) ||
+		(CheckCalPoints() == FALSE))
+	{	// Uncalibrated. Samples go out as they are.
+		CalResult.uiDtoAOffset = 0;
+		CalResult.uiDtoASpan = 0;
+		return;
+	}
+
+	uiCalIndex = 0;
+	ucCalSegment = 0;
+	BuildCorrection(DTOA_NUM_CODES);
+	SetDtoACorrection(acCorrection);
+	CalResult.bCalibrated = TRUE;
+}
+
+/******************************************************************************
+ * Starts a calibration or self-test. The waveform is turned off, since the
+ * sweep needs the D/A. Returns INVALID_PARAMETER if one is already running.
+ ******************************************************************************/
+eErrorType StartCalibration(eCalModeType Mode)
+{
+	if (CalState != CAL_IDLE)
+	{
+		return INVALID_PARAMETER;
+	}
+	if (Mode > CAL_VERIFY)
+	{
+		return PARAMETER_OUT_OF_RANGE;
+	}
+
+	SetWaveShape(WAVE_OFF);
+
+	CalMode = Mode;
+	CalResult.bPassed = FALSE;
+	CalResult.uiMaxError = 0;
+	if (Mode == CAL_FULL)
+	{	// Measure the raw D/A
+		SetDtoACorrection(0);
+		CalResult.bCalibrated = FALSE;
+		bCalVerifying = FALSE;
+	}
+	else
+	{	// Measure what comes out now, corrected or not
+		bCalVerifying = TRUE;
+	}
+
+	ucCalPoint = 0;
+	StartCalPoint();
+	return NO_ERROR;
+}
+
+/******************************************************************************
+ * Returns TRUE while a calibration or self-test is running.
+ ******************************************************************************/
+eBooleanType CalibrationBusy(void)
+{
+	return (CalState != CAL_IDLE) ? TRUE : FALSE;
+}
+
+/******************************************************************************
+ * Returns the outcome of the last calibration or self-test.
+ ******************************************************************************/
+void GetCalibrationResult(CalResultType *ptrResult)
+{
+	*ptrResult = CalResult;
+}
+
+/******************************************************************************
+ * Does the next step of a calibration, if one is running. Called from the
+ * foreground loop.
+ ******************************************************************************/
+void ServiceCalibration(void)
+{
+	unsigned int uiReading;
+	unsigned int uiIdeal;
+	unsigned int uiError;
+
+	switch (CalState)
+	{
+		case CAL_SETTLE:
+			if ((GetAtoDCount() - uiCalStartCount) < CAL_SETTLE_CONVERSIONS)
+			{	// Average still includes the last point
+				return;
+			}
+
+			uiReading = GetAtoDSum(ADC_CHANNEL_DTOA);
+			if (bCalVerifying == FALSE)
+			{
+				CalRecord.auiPoints[ucCalPoint] = uiReading;
+			}
+			else
+			{
+				uiIdeal = CAL_POINT_CODE(ucCalPoint) << ADC_AVERAGE_SHIFT;
+				uiError = (uiReading > uiIdeal) ? (uiReading - uiIdeal)
+												: (uiIdeal - uiReading);
+
+				// Values beyond what the D/A can reach can't be corrected
+				if ((CalResult.bCalibrated == FALSE) ||
+					((uiIdeal >= CalRecord.auiPoints[0]) &&
+					 (uiIdeal <= CalRecord.auiPoints[CAL_NUM_POINTS - 1])))
+				{
+					if (uiError > CalResult.uiMaxError)
+					{
+						CalResult.uiMaxError = uiError;
+					}
+				}
+			}
+
+			if (++ucCalPoint < CAL_NUM_POINTS)
+			{
+				StartCalPoint();
+			}
+			else
+			{
+				FinishSweep();
+			}
+			break;
+
+		case CAL_BUILD:
+			BuildCorrection(CAL_BUILD_CHUNK);
+			if (uiCalIndex >= DTOA_NUM_CODES)
+			{	// Put the new table in use, and test it
+				SetDtoACorrection(acCorrection);
+				CalResult.bCalibrated = TRUE;
+				bCalVerifying = TRUE;
+				ucCalPoint = 0;
+				StartCalPoint();
+			}
+			break;
+
+		case CAL_SAVE:
+			// One byte per call, and only when the EEPROM is ready, so we
+			// never wait for a write to finish
+			if (eeprom_is_ready())
+			{
+				eeprom_update_byte(&((unsigned char *)&CalRecordEE)[uiCalIndex],
+								   ((unsigned char *)&CalRecord)[uiCalIndex]);
+				if (++uiCalIndex >= sizeof(CalRecord))
+				{
+					CalState = CAL_IDLE;
+				}
+			}
+			break;
+
+		default:
+			break;
+	}
+}
+
+/******************************************************************************
+ * Returns TRUE if ServiceCalibration has a step it can take now. Called by
+ * IdleSleep with interrupts disabled.
+ ******************************************************************************/
+eBooleanType CalibrationWorkPending(void)
+{
+	switch (CalState)
+	{
+		case CAL_SETTLE:
+			return ((GetAtoDCount() - uiCalStartCount) >= CAL_SETTLE_CONVERSIONS) ?
+					TRUE : FALSE;
+
+		case CAL_BUILD:
+			return TRUE;
+
+		case CAL_SAVE:
+			return eeprom_is_ready() ? TRUE : FALSE;
+
+		default:
+			return FALSE;
+	}
+}
+
+/******************************************************************************
+ * Sends the code for the current point, and starts waiting for its
+ * readback.
+ ******************************************************************************/
+static void StartCalPoint(void)
+{
+	WriteDtoASample(CAL_POINT_CODE(ucCalPoint));
+	uiCalStartCount = GetAtoDCount();
+	CalState = CAL_SETTLE;
+}
+
+/******************************************************************************
+ * Called after the last point of a sweep.
+ ******************************************************************************/
+static void FinishSweep(void)
+{
+	WriteDtoASample(0);
+
+	if (bCalVerifying == TRUE)
+	{	// Self-test done
+		CalResult.bPassed =
+			(CalResult.uiMaxError <= CAL_MAX_ERROR_SUM) ? TRUE : FALSE;
+
+		if (CalMode == CAL_VERIFY)
+		{	// Board stays as it was, pass or fail
+			if (CalResult.bPassed == FALSE)
+			{
+				ReportError(CALIBRATION_FAILED);
+			}
+			CalState = CAL_IDLE;
+		}
+		else if (CalResult.bPassed == FALSE)
+		{	// New table is no good. Don't use or keep it.
+			FailCalibration();
+		}
+		else
+		{	// New table passed. Keep it.
+			CalRecord.uiMagic = CAL_MAGIC;
+			CalRecord.uiCRC = GetRecordCRC();
+			uiCalIndex = 0;
+			CalState = CAL_SAVE;
+		}
+		return;
+	}
+
+	// Measurement sweep done. Make sure it looks like a D/A.
+	CalResult.uiDtoAOffset = CalRecord.auiPoints[0];
+	CalResult.uiDtoASpan = CalRecord.auiPoints[CAL_NUM_POINTS - 1] -
+						   CalRecord.auiPoints[0];
+	if (CheckCalPoints() == FALSE)
+	{
+		FailCalibration();
+		return;
+	}
+
+	// Build the table, then test it
+	uiCalIndex = 0;
+	ucCalSegment = 0;
+	CalState = CAL_BUILD;
+}
+
+/******************************************************************************
+ * Leaves the D/A uncorrected after a calibration that didn't work. The
+ * record in EEPROM isn't touched.
+ ******************************************************************************/
+static void FailCalibration(void)
+{
+	SetDtoACorrection(0);
+	CalResult.bCalibrated = FALSE;
+	CalResult.bPassed = FALSE;
+	ReportError(CALIBRATION_FAILED);
+	CalState = CAL_IDLE;
+}
+
+/******************************************************************************
+ * Returns TRUE if the points rise steadily, with a believable span.
+ ******************************************************************************/
+static eBooleanType CheckCalPoints(void)
+{
+	unsigned char k;
+	unsigned int uiSpan;
+
+	for (k = 1; k < CAL_NUM_POINTS; ++k)
+	{
+		if (CalRecord.auiPoints[k] <= CalRecord.auiPoints[k - 1])
+		{
+			return FALSE;
+		}
+	}
+
+	uiSpan = CalRecord.auiPoints[CAL_NUM_POINTS - 1] - CalRecord.auiPoints[0];
+	return ((uiSpan >= CAL_MIN_SPAN) && (uiSpan <= CAL_MAX_SPAN)) ? TRUE : FALSE;
+}
+
+/******************************************************************************
+ * Returns the CRC of the record, up to the CRC itself.
+ ******************************************************************************/
+static unsigned int GetRecordCRC(void)
+{
+	const unsigned char *ptrData = (const unsigned char *)&CalRecord;
+	unsigned int uiCRC = 0;
+	unsigned char i;
+
+	for (i = 0; i < (unsigned char)offsetof(CalRecordType, uiCRC); ++i)
+	{
+		uiCRC = _crc_xmodem_update(uiCRC, ptrData[i]);
+	}
+	return uiCRC;
+}
+
+/******************************************************************************
+ * Fills in the next uiCount entries of the correction table, starting at
+ * uiCalIndex. For each wanted value, finds the two points whose readings
+ * are either side of it, and interpolates between their codes. Values
+ * the D/A can't reach get the nearest code it has.
+ ******************************************************************************/
+static void BuildCorrection(unsigned int uiCount)
+{
+	unsigned int uiTarget;
+	unsigned int uiLow, uiHigh;
+	unsigned int uiLowCode, uiHighCode;
+	unsigned int uiCode;
+	int Delta;
+
+	for ( ; (uiCount != 0) && (uiCalIndex < DTOA_NUM_CODES); --uiCount)
+	{
+		// Reading an ideal D/A would give
+		uiTarget = uiCalIndex << ADC_AVERAGE_SHIFT;
+
+		// Wanted values only rise, so the segment only moves forward
+		while ((ucCalSegment < (CAL_NUM_POINTS - 2)) &&
+			   (uiTarget >= CalRecord.auiPoints[ucCalSegment + 1]))
+		{
+			++ucCalSegment;
+		}
+
+		uiLow = CalRecord.auiPoints[ucCalSegment];
+		uiHigh = CalRecord.auiPoints[ucCalSegment + 1];
+		uiLowCode = CAL_POINT_CODE(ucCalSegment);
+		uiHighCode = CAL_POINT_CODE(ucCalSegment + 1);
+
+		if (uiTarget <= uiLow)
+		{	// Below the bottom of the range
+			uiCode = uiLowCode;
+		}
+		else if (uiTarget >= uiHigh)
+		{	// Above the top
+			uiCode = uiHighCode;
+		}
+		else
+		{	// Rounded to nearest
+			uiCode = uiLowCode + (unsigned int)
+				((((unsigned long)(uiTarget - uiLow) * (uiHighCode - uiLowCode)) +
+				  ((uiHigh - uiLow) / 2)) / (uiHigh - uiLow));
+		}
+
+		// Keep within what a byte holds. Since the code is in range, so is
+		// anything between it and the value.
+		Delta = (int)uiCode - (int)uiCalIndex;
+		if (Delta > 127)
+		{
+			Delta = 127;
+		}
+		else if (Delta < -128)
+		{
+			Delta = -128;
+		}
+		acCorrection[uiCalIndex] = (signed char)Delta;
+
+		++uiCalIndex;
+	}
+}
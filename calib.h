@@ -0,0 +1,45 @@
+/******************************************************************************
+ * File Name:	calib.h
+ * Program:		Project for Real-Time Embedded Systems Programming class
+ * Purpose:		Header file for calib.c file.
+ ******************************************************************************/
+#if !defined(CALIB_H)		/* Prevents including this file multiple times */
+#define CALIB_H
+
+#include "lib.h"
+#include "errors.h"
+
+/* Number of D/A codes measured in a sweep. Points are every
+ * CAL_POINT_STEP codes, and the last is the top code. */
+#define CAL_POINT_SHIFT                 5
+#define CAL_POINT_STEP                  (1 << CAL_POINT_SHIFT)
+#define CAL_NUM_POINTS                  ((1024 / CAL_POINT_STEP) + 1)
+
+/* Largest error, in A/D counts, at which the self-test passes */
+#define CAL_MAX_ERROR                   2
+
+typedef enum
+{
+	CAL_FULL = 0,		// Measure, build and save a new table, then test it
+	CAL_VERIFY			// Only test the table in use
+} eCalModeType;
+
+/* Outcome of the last run */
+typedef struct
+{
+	eBooleanType bCalibrated;	// A table is in use
+	eBooleanType bPassed;		// Last run passed
+	unsigned int uiMaxError;	// Largest self-test error, 1/16 A/D counts
+	unsigned int uiDtoAOffset;	// D/A code 0, 1/16 A/D counts
+	unsigned int uiDtoASpan;	// Code 0 to full scale, 1/16 A/D counts
+} CalResultType;
+
+/* Function Prototypes */
+void InitCalibration(void);
+eErrorType StartCalibration(eCalModeType);
+void ServiceCalibration(void);		// Called from foreground loop
+eBooleanType CalibrationWorkPending(void);	// Called from IdleSleep
+eBooleanType CalibrationBusy(void);
+void GetCalibrationResult(CalResultType *);
+
+#endif /* CALIB_H */
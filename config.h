@@ -0,0 +1,146 @@
+/******************************************************************************
+ * File Name:	config.h
+ * Program:		Project for Real-Time Embedded Systems Programming class
+ * Purpose:		Clock configuration. Every timer prescaler, compare value,
+ *				task period and baud rate register value is worked out here
+ *				from F_CPU, in integer arithmetic, by the compiler. Values
+ *				that can't be generated from F_CPU stop the build.
+ ******************************************************************************/
+#if !defined(CONFIG_H)		/* Prevents including this file multiple times */
+#define CONFIG_H
+
+#if !defined(F_CPU)
+#error "F_CPU must be defined, in Hz"
+#endif
+
+/*
+ * Timer prescaler selection. Timers 0, 1 and 3 all offer clk/1, /8, /64,
+ * /256 and /1024, selected by the same CSn2:0 codes. TIMER_SCALER_FOR picks
+ * the smallest prescaler, so the finest resolution, that gets 'cycles'
+ * within a timer whose period can be up to 'top' counts. TIMER_COUNT is
+ * then the rounded number of counts in a period; the compare register is
+ * loaded with one less, since CTC mode counts 0 to OCRnA.
+ */
+#define TIMER_SCALER_FOR(cycles, top)							\
+	(((cycles) <= (top))        ? 1UL :							\
+	 ((cycles) <= (top) * 8)    ? 8UL :							\
+	 ((cycles) <= (top) * 64)   ? 64UL :						\
+	 ((cycles) <= (top) * 256)  ? 256UL : 1024UL)
+
+#define TIMER_CS_FOR(scaler)									\
+	(((scaler) == 1) ? 1 : ((scaler) == 8) ? 2 : ((scaler) == 64) ? 3 :	\
+	 ((scaler) == 256) ? 4 : 5)
+
+#define TIMER_COUNT(cycles, scaler)	(((cycles) + (scaler)/2) / (scaler))
+
+/* Error of the actual period, in tenths of a percent */
+#define TIMER_ERROR(cycles, scaler)								\
+	((((TIMER_COUNT(cycles, scaler) * (scaler)) > (cycles)) ?		\
+	  ((TIMER_COUNT(cycles, scaler) * (scaler)) - (cycles)) :		\
+	  ((cycles) - (TIMER_COUNT(cycles, scaler) * (scaler)))) * 1000 / (cycles))
+
+#define MAX_TIMER_ERROR					10		// 1.0%
+
+/*
+ * Timer 0, the "medium" thread tick. Every 25 mSecs.
+ * At 8 MHz, that's 200000 cycles: /1024, 195 counts, 24.96 mSecs.
+ */
+#define TIMER0_TICK_MS					25
+#define TIMER0_TOP						256UL
+
+#define TIMER0_CYCLES					(((unsigned long)(F_CPU) * TIMER0_TICK_MS) / 1000UL)
+#define TIMER0_SCALER					TIMER_SCALER_FOR(TIMER0_CYCLES, TIMER0_TOP)
+#define TIMER0_CS						TIMER_CS_FOR(TIMER0_SCALER)
+#define TIMER0_CNT						TIMER_COUNT(TIMER0_CYCLES, TIMER0_SCALER)
+
+/* CPU cycles in a tick as the timer actually runs it */
+#define TIMER0_TICK_CYCLES				(TIMER0_CNT * TIMER0_SCALER)
+
+_Static_assert(TIMER0_TICK_MS <= 100, "TIMER0_CYCLES would overflow");
+_Static_assert((TIMER0_CNT >= 1) && (TIMER0_CNT <= TIMER0_TOP),
+			   "Timer 0 tick too long for F_CPU, even at clk/1024");
+_Static_assert(TIMER_ERROR(TIMER0_CYCLES, TIMER0_SCALER) <= MAX_TIMER_ERROR,
+			   "Timer 0 tick can't be generated accurately from F_CPU");
+
+/*
+ * Medium-thread task periods, in mSecs. Each must be a whole number of
+ * ticks, and no more than 255 ticks, since the scheduler counts them in a
+ * byte.
+ */
+#define HEARTBEAT_MS					500		/* between toggling of LED */
+#define MENU_MS							100		/* between running menu */
+#define DISPLAY_MS						TIMER0_TICK_MS	/* one LCD status frame per tick */
+#define MAX_MEDIUM_THREAD_MS			5		/* max for any task */
+
+#define TICKS_FOR_MS(ms)				((ms) / TIMER0_TICK_MS)
+#define TASK_PERIOD_OK(ms)				((((ms) % TIMER0_TICK_MS) == 0) &&	\
+										 (TICKS_FOR_MS(ms) >= 1) &&			\
+										 (TICKS_FOR_MS(ms) <= 255))
+
+_Static_assert(TASK_PERIOD_OK(HEARTBEAT_MS), "Bad HEARTBEAT_MS");
+_Static_assert(TASK_PERIOD_OK(MENU_MS), "Bad MENU_MS");
+_Static_assert(TASK_PERIOD_OK(DISPLAY_MS), "Bad DISPLAY_MS");
+_Static_assert(MAX_MEDIUM_THREAD_MS < TIMER0_TICK_MS,
+			   "MAX_MEDIUM_THREAD_MS must be less than a tick");
+
+/*
+ * Timer 1, the waveform sample clock, for the fixed-rate modes. Table mode
+ * sets its rate from the frequency at run time.
+ * At 8 MHz, DDS is 400 counts and stream 1000, both at clk/1.
+ */
+#define DDS_SAMPLE_RATE					20000UL
+#define STREAM_SAMPLE_RATE				8000UL
+#define TIMER1_TOP						0x10000UL
+
+#define DDS_TIMER_CYCLES				((unsigned long)(F_CPU) / DDS_SAMPLE_RATE)
+#define DDS_TIMER_SCALER				TIMER_SCALER_FOR(DDS_TIMER_CYCLES, TIMER1_TOP)
+#define DDS_TIMER_CS					TIMER_CS_FOR(DDS_TIMER_SCALER)
+#define DDS_TIMER_CNT					TIMER_COUNT(DDS_TIMER_CYCLES, DDS_TIMER_SCALER)
+
+#define STREAM_TIMER_CYCLES				((unsigned long)(F_CPU) / STREAM_SAMPLE_RATE)
+#define STREAM_TIMER_SCALER				TIMER_SCALER_FOR(STREAM_TIMER_CYCLES, TIMER1_TOP)
+#define STREAM_TIMER_CS					TIMER_CS_FOR(STREAM_TIMER_SCALER)
+#define STREAM_TIMER_CNT				TIMER_COUNT(STREAM_TIMER_CYCLES, STREAM_TIMER_SCALER)
+
+_Static_assert(TIMER_ERROR(DDS_TIMER_CYCLES, DDS_TIMER_SCALER) <= MAX_TIMER_ERROR,
+			   "DDS_SAMPLE_RATE can't be generated accurately from F_CPU");
+_Static_assert(TIMER_ERROR(STREAM_TIMER_CYCLES, STREAM_TIMER_SCALER) <= MAX_TIMER_ERROR,
+			   "STREAM_SAMPLE_RATE can't be generated accurately from F_CPU");
+
+/*
+ * Baud rates. All of this is done by the compiler, and the macros work in
+ * #if too, so serial.c can leave out rates F_CPU can't generate.
+ *
+ * UBRR_FOR gives the rounded UBRR value for a clock divider of 16 (normal) or
+ * 8 (U2X0 double speed). BAUD_ERROR is then the error of the actual rate, in
+ * tenths of a percent. Double speed is only used when it gives a lower error,
+ * since normal speed samples each bit more times and so tolerates more noise.
+ */
+#define UART_CLOCK_DIVIDER		16
+#define UART_CLOCK_DIVIDER_U2X	8
+#define MAX_UBRR_VALUE			4095
+#define MAX_BAUD_ERROR			20		// 2.0%
+
+#define UBRR_FOR(baud, div)		((((F_CPU) + ((div)/2)*(baud)) / ((div)*(baud))) - 1)
+#define BAUD_ACTUAL(baud, div)	((F_CPU) / ((div) * (UBRR_FOR(baud, div) + 1)))
+#define BAUD_ERROR(baud, div)	(((BAUD_ACTUAL(baud, div) > (baud)) ?			\
+								  (BAUD_ACTUAL(baud, div) - (baud)) :			\
+								  ((baud) - BAUD_ACTUAL(baud, div))) * 1000 / (baud))
+
+#define BAUD_USE_U2X(baud)		(BAUD_ERROR(baud, UART_CLOCK_DIVIDER_U2X) <	\
+								 BAUD_ERROR(baud, UART_CLOCK_DIVIDER))
+#define BAUD_DIVIDER(baud)		(BAUD_USE_U2X(baud) ? UART_CLOCK_DIVIDER_U2X :	\
+								 UART_CLOCK_DIVIDER)
+#define BAUD_UBRR(baud)			UBRR_FOR(baud, BAUD_DIVIDER(baud))
+
+/* A rate can be used if it's within MAX_BAUD_ERROR, and UBRR is in range */
+#define BAUD_OK(baud)			((BAUD_ERROR(baud, BAUD_DIVIDER(baud)) <= MAX_BAUD_ERROR) && \
+								 (BAUD_UBRR(baud) <= MAX_UBRR_VALUE))
+
+/* Rate used at reset */
+#define BAUD_RATE				2400UL
+
+_Static_assert(BAUD_OK(BAUD_RATE),
+			   "BAUD_RATE can't be generated accurately from F_CPU");
+
+#endif /* CONFIG_H */
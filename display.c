@@ -0,0 +1,147 @@
+/******************************************************************************
+ * File Name:	display.c
+ * Program:		Project for Real-Time Embedded Systems Programming class
+ * Purpose:		Live status on the LCD. A one-letter label in the first
+ *				position says which value is shown, and the value goes in
+ *				the other five, right-justified.
+ *
+ *				DisplayTask is a low-priority scheduler task that runs every
+ *				tick. It reads the value, and does nothing more if it hasn't
+ *				changed. Otherwise only the characters that differ from the
+ *				last frame go to the LCD shadow registers, which the LCD
+ *				interrupt copies out as one frame. Nothing here runs in an
+ *				ISR, apart from that copy.
+ ******************************************************************************/
+#include <avr/pgmspace.h>
+
+#include "lib.h"
+#include "errors.h"
+#include "lcd.h"
+#include "format.h"
+#include "dtoa.h"
+#include "waveform.h"
+#include "display.h"
+
+#define DISPLAY_WIDTH		(LCD_LAST_POSITION - LCD_FIRST_POSITION + 1)
+#define DISPLAY_DIGITS		(DISPLAY_WIDTH - 1)
+#define DISPLAY_MAX_VALUE	99999UL
+
+/* Label for each value, indexed by LCDValueType */
+static const char Labels[NUM_LCD_VALUES] PROGMEM =
+{
+	'A',	// VOLTAGE_ACTUAL
+	'F',	// FREQUENCY_ACTUAL
+	'C',	// VOLTAGE_DESIRED
+	'd'		// FREQUENCY_DESIRED
+};
+
+static LCDValueType DisplayValue = VOLTAGE_ACTUAL;
+
+/* What's on the LCD now. bDisplayValid is FALSE until the first frame, and
+ * after the view changes, so everything gets redrawn. */
+static char azShown[DISPLAY_WIDTH];
+static unsigned long ulShownValue;
+static eBooleanType bDisplayValid = FALSE;
+
+/******************************************************************************
+ * Selects which value DisplayTask shows.
+ ******************************************************************************/
+eErrorType SetDisplayValue(LCDValueType Value)
+{
+	if (Value >= NUM_LCD_VALUES)
+	{
+		return PARAMETER_OUT_OF_RANGE;
+	}
+
+	// Runs from the menu task, so DisplayTask can't be in the middle of a
+	// frame.
+	DisplayValue = Value;
+	bDisplayValid = FALSE;
+	return NO_ERROR;
+}
+
+/******************************************************************************
+ * Returns the value for the current view.
+ ******************************************************************************/
+static unsigned long ReadDisplayValue(void)
+{
+	WaveStatusType Status;
+
+	if (DisplayValue == VOLTAGE_ACTUAL)
+	{	// Cheapest, and the one that changes most. Skip the status read.
+		return GetDtoAValue();
+	}
+
+	GetWaveStatus(&Status);
+	switch (DisplayValue)
+	{
+		case FREQUENCY_ACTUAL:
+			return Status.ulActualFrequency / WAVE_FREQ_SCALE;
+		case VOLTAGE_DESIRED:
+			return Status.uiAmplitude;
+		default:
+			return Status.ulFrequency / WAVE_FREQ_SCALE;
+	}
+}
+
+/******************************************************************************
+ * Medium-thread task. Puts the current value on the LCD, writing only the
+ * characters that changed.
+ ******************************************************************************/
+void DisplayTask(void)
+{
+	char azFrame[FORMAT_DEC32_SIZE];
+	char *ptrDigits;
+	unsigned long ulValue;
+	unsigned char ucLength;
+	unsigned char i;
+	eBooleanType bChanged = FALSE;
+
+	ulValue = ReadDisplayValue();
+	if ((bDisplayValid == TRUE) && (ulValue == ulShownValue))
+	{	// Same as last frame. Nothing to do.
+		return;
+	}
+
+	// Build the new frame: label, then the value padded with blanks
+	azFrame[0] = (char)pgm_read_byte(&Labels[DisplayValue]);
+	ptrDigits = &azFrame[1];
+	if (ulValue > DISPLAY_MAX_VALUE)
+	{	// Doesn't fit
+		for (i = 0; i < DISPLAY_DIGITS; ++i)
+		{
+			ptrDigits[i] = '-';
+		}
+	}
+	else
+	{
+		ucLength = (unsigned char)(FormatDec32(ptrDigits, ulValue, 0) - ptrDigits);
+		for (i = DISPLAY_DIGITS; i-- > 0; )
+		{	// Shift right, filling in blanks
+			ptrDigits[i] = (ucLength != 0) ? ptrDigits[--ucLength] : ' ';
+		}
+	}
+
+	// Write only what differs, all in one LCD frame. If nothing looks
+	// different (e.g. one overflow to another), no frame is committed.
+	for (i = 0; i < DISPLAY_WIDTH; ++i)
+	{
+		if ((bDisplayValid == FALSE) || (azFrame[i] != azShown[i]))
+		{
+			if (bChanged == FALSE)
+			{
+				LCDBeginUpdate();
+				bChanged = TRUE;
+			}
+			LCDWrite(azFrame[i], LCD_FIRST_POSITION + i);
+			azShown[i] = azFrame[i];
+		}
+	}
+	if (bChanged == TRUE)
+	{
+		LCDEndUpdate();
+	}
+
+	ulShownValue = ulValue;
+	bDisplayValid = TRUE;
+}
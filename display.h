@@ -0,0 +1,25 @@
+/******************************************************************************
+ * File Name:	display.h
+ * Program:		Project for Real-Time Embedded Systems Programming class
+ * Purpose:		Header file for display.c file.
+ ******************************************************************************/
+#if !defined(DISPLAY_H)		/* Prevents including this file multiple times */
+#define DISPLAY_H
+
+#include "errors.h"
+
+// Values for controlling what's displayed on LCD
+typedef enum
+{
+	VOLTAGE_ACTUAL,			// D/A output right now, counts
+	FREQUENCY_ACTUAL,		// Frequency being made, Hz
+	VOLTAGE_DESIRED,		// Amplitude setting, counts
+	FREQUENCY_DESIRED,		// Frequency setting, Hz
+	NUM_LCD_VALUES
+} LCDValueType;
+
+/* Function Prototypes */
+eErrorType SetDisplayValue(LCDValueType);
+void DisplayTask(void);		// Medium-thread task
+
+#endif /* DISPLAY_H */
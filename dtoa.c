@@ -11,16 +11,89 @@
  * 08Mar04  R Weber     Updated for Atmega169
  * 29Sep05	T Lill		Removed deprecated functions
  ******************************************************************************/
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+
 #include "lib.h"
 #include "errors.h"
 #include "dtoa.h"
-#include "serial.h"
+#include "profile.h"
+#include "trace.h"
 
-// Number of bytes to send on each SPI transmission
+// Number of bytes to send to each D/A
 #define SPI_NUM_BYTES               2
 
-// When in DEBUG mode
-//#define DEBUG
+// Number of bytes in a frame for all channels
+#define DTOA_FRAME_BYTES            (SPI_NUM_BYTES * DTOA_NUM_CHANNELS)
+
+#if !DTOA_POLLED
+/*
+ * Define the queue of frames waiting for the SPI interrupt. The Head and
+ * Tail pointers - but not the data being pointed to - need to be volatile.
+ */
+static DtoAFrameType aDtoAQueue[DTOA_QUEUE_SIZE];
+static DtoAFrameType * volatile ptrDtoAQueueHead = aDtoAQueue;
+static DtoAFrameType * volatile ptrDtoAQueueTail = aDtoAQueue;
+#endif
+
+/* Latest value asked for on each channel. A write of one channel sends
+ * these for the others. Only changed with interrupts disabled. */
+static DtoAFrameType DtoARequested;
+
+/* Frame being shifted out, already in D/A format and in the order it's
+ * sent, and the index of the next byte for the SPI interrupt to send */
+static unsigned char aucDtoAFrame[DTOA_FRAME_BYTES];
+static volatile unsigned char ucDtoANextByte = DTOA_FRAME_BYTES;
+static volatile eBooleanType bDtoABusy = FALSE;
+static void (* volatile pfnDtoAComplete)(void) = 0;
+
+/* Per-code correction added to each channel 0 sample before it's sent, or
+ * 0 for none. Set by the calibration module. */
+static const signed char * volatile ptrDtoACorrection = 0;
+
+/* Samples in the frame being sent, and the last ones latched into the D/As */
+static DtoAFrameType DtoAFrameValue;
+static volatile DtoAFrameType DtoAValue;
+
+/* Port B chip select for each channel */
+static const unsigned char ChipSelectMasks[DTOA_NUM_CHANNELS] PROGMEM =
+	DTOA_CS_MASKS;
+
+/*
+ * Chip select changes. With one chip select, its bit is set and cleared
+ * with sbi and cbi (SBI and CBI in lib.h): one instruction, at any
+ * optimization level, that an interrupt can't split. Separate chip selects
+ * are looked up by channel, so they need a read-modify-write of PORTB;
+ * they're only changed with interrupts disabled.
+ */
+#if DTOA_DAISY_CHAIN
+#define SELECT_FIRST_CS()			CBI(PORTB, D2A_CS_BIT)
+#define DESELECT_LAST_CS()			SBI(PORTB, D2A_CS_BIT)
+#else
+#define SELECT_FIRST_CS()			(PORTB &= ~pgm_read_byte(&ChipSelectMasks[0]))
+#define DESELECT_LAST_CS()			(PORTB |= pgm_read_byte(&ChipSelectMasks[DTOA_NUM_CHANNELS - 1]))
+// Deselects the D/A before 'word', which latches it, then selects its own
+#define SELECT_NEXT_CS(word)		(PORTB = (PORTB | pgm_read_byte(&ChipSelectMasks[(word) - 1])) & \
+											 ~pgm_read_byte(&ChipSelectMasks[word]))
+#endif
+
+/*
+ * Polled transfers. On the SPI port, SPIF sets once each byte is out;
+ * reading SPSR with it set, then writing SPDR, clears it. The USART holds
+ * a second byte, so a write only has to wait for room (UDRE1), and the end
+ * of a word waits for its last bit to go (TXC1, cleared by writing a 1).
+ */
+#if DTOA_USART_SPI
+#define DTOA_DATA					UDR1
+#define DTOA_WAIT_ROOM()			while (!(UCSR1A & _BV(UDRE1)))
+#define DTOA_WAIT_DONE()			while (!(UCSR1A & _BV(TXC1)))
+#define DTOA_CLEAR_DONE()			(UCSR1A = _BV(TXC1))
+#else
+#define DTOA_DATA					SPDR
+#define DTOA_WAIT_ROOM()			while (!(SPSR & _BV(SPIF)))
+#define DTOA_WAIT_DONE()			DTOA_WAIT_ROOM()
+#define DTOA_CLEAR_DONE()
+#endif
 
 /******************************************************************************
  * This function initializes the SPI port for communication with the D/A 
@@ -28,23 +101,59 @@
  ******************************************************************************/
 void InitDtoA(void)
 {
+    unsigned char i;
+
+#if DTOA_USART_SPI
+	/* The clock must be stopped (UBRR1 = 0) when the transmitter is enabled,
+	 * and XCK1 must be an output to make USART 1 the master. */
+	UBRR1 = 0;
+	SET_BIT(DDRD, PD5);
+
+	/*------------------ Set UCSR1C values --------------------------
+	 * Bit 7: UMSEL11 = 1  Master SPI mode
+	 *     6: UMSEL10 = 1
+	 *   5-3: unused  = 0
+	 *     2: UDORD1  = 0  MS bit first
+	 *     1: UCPHA1  = 0  Data sampled on clock's rising edge
+	 *     0: UCPOL1  = 0  XCK low when idle
+	 */
+	UCSR1C = _BV(UMSEL11) | _BV(UMSEL10);
+
+	/*------------------ Set UCSR1B values --------------------------
+	 * Bit 7-5: RXCIE1, TXCIE1, UDRIE1 = 0  No interrupts; frames are polled
+	 *       4: RXEN1  = 0  Receiver off; the D/A has nothing to send
+	 *       3: TXEN1  = 1  Transmitter on
+	 *     2-0: unused = 0
+	 */
+	UCSR1B = _BV(TXEN1);
+
+	// XCK = Fosc / (2 * (UBRR1 + 1)), so Fosc/2
+	UBRR1 = 0;
+#else
     /* Set SPI Control register, with:
-     *   SPIE:  0 - SPI Interrupt disabled
+     *   SPIE:  0 - SPI Interrupt disabled. Unless frames are polled,
+     *              WriteDtoASampleAsync enables it while queued frames
+     *              are being sent.
      *   SPE:   1 - SPI Enabled.
      *   DORD:  0 - Data order is MS bit first
      *   MSTR:  1 - CPU is the master
      *   CPOL:  0 - SCLK line is low when SPI is idling
      *   CPHA:  0 - Data sampled on clocks rising edge
      *   SPR1:	0 - 
-	 *   SPR0:  1 - Sck frequency = Fosc/8
-	 *              when SPI2X is set to 1
+	 *   SPR0:  x - With SPI2X set to 1, Sck frequency = Fosc/2 if 0 (fast),
+	 *              or Fosc/8 if 1
 	 */
+#if DTOA_SPI_FAST
+	SPCR = ( _BV(MSTR) | _BV(SPE) );
+#else
 	SPCR = ( _BV(MSTR) | _BV(SPR0) | _BV(SPE) );
+#endif
 	
 	/* Set SPI2X on SPSR to finish setting SCK frequency 
 	 * Note that since this only writable bit in this register is the SPI2X
 	 * bit, We can just write. */
 	SPSR = _BV(SPI2X);
+#endif
 	
 	/* Set Port B, pin 4 to be an output. This is actually already done in 
 	 * main.c, but I like to do it again here in case, sometime down the road,
@@ -54,11 +163,228 @@ void InitDtoA(void)
 	
 	/* And set PB4 high, so D/A is not selected */
 	SET_BIT(PORTB, D2A_CS_BIT); 
+
+	/* Same for the other chip selects, if each D/A has its own */
+	for (i = 0; i < DTOA_NUM_CHANNELS; ++i)
+	{
+		DDRB |= pgm_read_byte(&ChipSelectMasks[i]);
+		PORTB |= pgm_read_byte(&ChipSelectMasks[i]);
+	}
 	
-	/* Set D/A to 0 initially */
+	/* Set every D/A to 0 initially */
 	WriteDtoASample(0);
 }
 
+/******************************************************************************
+ * Applies the calibration correction, if any. One table read and an add;
+ * the table never takes a code outside 0 to DTOA_MAX_CODE.
+ ******************************************************************************/
+static inline unsigned int CorrectDtoASample(unsigned int Value)
+{
+	const signed char *ptrTable = ptrDtoACorrection;
+
+	Value &= DTOA_MAX_CODE;
+	if (ptrTable != 0)
+	{
+		Value += ptrTable[Value];
+	}
+	return Value;
+}
+
+/******************************************************************************
+ * Converts a frame to D/A format, ready to send.
+ *
+ * In a daisy chain, the first word sent is shifted on to the far end, so
+ * the channels are sent last first. With separate chip selects, they're
+ * sent in order, selecting each channel's D/A in turn.
+ ******************************************************************************/
+static void PrepareDtoAFrame(const DtoAFrameType *ptrFrame)
+{
+	unsigned int Value;
+	unsigned char ucChannel;
+	unsigned char ucByte;
+
+	DtoAFrameValue = *ptrFrame;
+
+	for (ucChannel = 0; ucChannel < DTOA_NUM_CHANNELS; ++ucChannel)
+	{
+		// Correct the value, then shift left by 2 bits to match TLC5615
+		// format
+		Value = ptrFrame->auiChannel[ucChannel];
+		Value = (ucChannel == 0) ? CorrectDtoASample(Value)
+								 : (Value & DTOA_MAX_CODE);
+		Value = Value << 2;
+
+#if DTOA_DAISY_CHAIN
+		ucByte = (DTOA_NUM_CHANNELS - 1 - ucChannel) * SPI_NUM_BYTES;
+#else
+		ucByte = ucChannel * SPI_NUM_BYTES;
+#endif
+		aucDtoAFrame[ucByte] = (unsigned char)(Value >> 8);
+		aucDtoAFrame[ucByte + 1] = (unsigned char)Value;
+	}
+}
+
+#if DTOA_POLLED
+/******************************************************************************
+ * Sends the prepared frame by polling, and latches it. Call with interrupts
+ * disabled; at Fosc/2 a frame takes 32 cycles per channel, plus the loop.
+ *
+ * Each byte is fetched before waiting for the last one to go, so all that's
+ * left once the port is ready is the write, whatever the optimization level.
+ ******************************************************************************/
+static void SendDtoAFrame(void)
+{
+	unsigned char ucByte;
+	unsigned char ucNext;
+
+	// Enable the (first) D/A, and send the first MSB
+	DTOA_CLEAR_DONE();
+	SELECT_FIRST_CS();
+	DTOA_DATA = aucDtoAFrame[0];
+
+	for (ucByte = 1; ucByte < DTOA_FRAME_BYTES; ++ucByte)
+	{
+		ucNext = aucDtoAFrame[ucByte];
+#if !DTOA_DAISY_CHAIN
+		if ((ucByte % SPI_NUM_BYTES) == 0)
+		{	// Last channel's word has to be all in before it's latched
+			DTOA_WAIT_DONE();
+			DTOA_CLEAR_DONE();
+			SELECT_NEXT_CS(ucByte / SPI_NUM_BYTES);
+			DTOA_DATA = ucNext;
+			continue;
+		}
+#endif
+		DTOA_WAIT_ROOM();
+		DTOA_DATA = ucNext;
+	}
+
+	// Deselect D/A(s) once the last bit is out, which latches the samples
+	DTOA_WAIT_DONE();
+#if !DTOA_USART_SPI
+	/* Check for write collision. Reading SPSR then accessing SPDR clears it. */
+	if ((SPSR & _BV(WCOL)) != 0)
+	{
+		ReportError(SPI_WRITE_COLLISION);
+	}
+#endif
+	DESELECT_LAST_CS();
+	DtoAValue = DtoAFrameValue;
+}
+
+#else
+/******************************************************************************
+ * Converts a frame to D/A format, selects the D/A(s), and sends the first
+ * byte. ContinueDtoAFrame sends the rest.
+ ******************************************************************************/
+static void StartDtoAFrame(const DtoAFrameType *ptrFrame)
+{
+	PrepareDtoAFrame(ptrFrame);
+
+	// Enable the (first) D/A, and send the first MSB
+	SELECT_FIRST_CS();
+	ucDtoANextByte = 1;
+	SPDR = aucDtoAFrame[0];
+}
+
+/******************************************************************************
+ * Called each time SPIF sets. Sends the next byte of the frame, and returns
+ * TRUE. Once the whole frame is out, deselects the D/A(s), which latches
+ * the samples, and returns FALSE.
+ ******************************************************************************/
+static inline eBooleanType ContinueDtoAFrame(void)
+{
+	unsigned char ucByte = ucDtoANextByte;
+
+	/* Check for write collision. Reading SPSR then accessing SPDR clears it. */
+	if ((SPSR & _BV(WCOL)) != 0)
+	{
+		ReportError(SPI_WRITE_COLLISION);
+	}
+
+	if (ucByte < DTOA_FRAME_BYTES)
+	{
+#if !DTOA_DAISY_CHAIN
+		if ((ucByte % SPI_NUM_BYTES) == 0)
+		{	// Last channel's word is in. Latch it, and select the next.
+			SELECT_NEXT_CS(ucByte / SPI_NUM_BYTES);
+		}
+#endif
+		ucDtoANextByte = ucByte + 1;
+		SPDR = aucDtoAFrame[ucByte];
+		return TRUE;
+	}
+
+	// Whole frame is out. Deselect D/A(s), which latches the samples.
+	DESELECT_LAST_CS();
+	DtoAValue = DtoAFrameValue;
+	return FALSE;
+}
+
+/******************************************************************************
+ * Starts the next queued frame, if there is one, and returns TRUE. Returns
+ * FALSE if the queue is empty. Call with interrupts disabled, once the last
+ * frame is out.
+ ******************************************************************************/
+static eBooleanType StartQueuedDtoAFrame(void)
+{
+	if (ptrDtoAQueueTail == ptrDtoAQueueHead)
+	{
+		return FALSE;
+	}
+
+	StartDtoAFrame(ptrDtoAQueueTail);
+	ptrDtoAQueueTail = INC_CIRC_BUFFER_PTR(ptrDtoAQueueTail, aDtoAQueue,
+										   DTOA_QUEUE_SIZE);
+	return TRUE;
+}
+#endif /* DTOA_POLLED */
+
+/******************************************************************************
+ * Puts a frame on the queue, or starts it if the SPI port is idle. Call
+ * with interrupts disabled. Returns 0 on success, or -1 if the queue is
+ * full. Polled frames are sent right away, and never queued.
+ ******************************************************************************/
+static int QueueDtoAFrame(const DtoAFrameType *ptrFrame)
+{
+#if DTOA_POLLED
+	void (*pfnCallback)(void);
+
+	PrepareDtoAFrame(ptrFrame);
+	SendDtoAFrame();
+
+	pfnCallback = pfnDtoAComplete;
+	if (pfnCallback != 0)
+	{
+		pfnCallback();
+	}
+	return 0;
+#else
+	DtoAFrameType *ptrNext;
+
+	if (bDtoABusy == FALSE)
+	{	// SPI port is idle. Start the frame now.
+		bDtoABusy = TRUE;
+		StartDtoAFrame(ptrFrame);
+		SET_BIT(SPCR, SPIE);
+		return 0;
+	}
+
+	// Queue the frame, if there's room
+	ptrNext = INC_CIRC_BUFFER_PTR(ptrDtoAQueueHead, aDtoAQueue,
+								  DTOA_QUEUE_SIZE);
+	if (ptrNext == ptrDtoAQueueTail)
+	{	// Queue is full
+		return -1;
+	}
+
+	*ptrDtoAQueueHead = *ptrFrame;
+	ptrDtoAQueueHead = ptrNext;
+	return 0;
+#endif
+}
+
 /******************************************************************************
  * This function writes data to the D/A.
  *
@@ -95,67 +421,235 @@ typedef union
 
 void WriteDtoASample ( unsigned int Value )
 {
+#if !DTOA_POLLED
+	DtoAFrameType Frame;
+#endif
+	unsigned char ucSREG;
 
-	/* Assignment
-	 * In this function, we write 2 bytes to the D/A, MSB first.
-	 * Follow these steps:
-	 * 1. Shift the input value left by 2 to match TLC5615 format
-	 * 2. Enable the D/A.
-	 * 3. Read the status register, and check for any errors. Report an error
-	 *    if one exists. A write collision is the only detectable error.
-	 *    Some chips require you to clear any existing error by reading the
-	 *    status register, or it won't transmit. the Atmega169 doesn't seem to
-	 *    have this restriction.
-	 * 4. Write the MSB to the D/A.
-	 * 5. Wait for the Tx to be complete. Alternatively, you could implement an
-	 *    ISR to do this.
-	 * 6. Check the status register for errors again.
-	 * 7. Write the LSB.
-	 * 8. Wait for this Tx to complete.
-	 * 9. Deselect the D/A
-	 */	
+#if DTOA_POLLED
+	/* A sample ISR could write a frame too, so send it with interrupts
+	 * disabled. It's over in well under a microsecond per channel. */
+	ucSREG = SREG;
+	cli();
+	DtoARequested.auiChannel[0] = Value;
+	PrepareDtoAFrame(&DtoARequested);
+	SendDtoAFrame();
+	SREG = ucSREG;
+#else
+	/* Let any interrupt-driven frames finish first, so we don't clobber the
+	 * frame in progress, then claim the port in the same cli() section as
+	 * the test. An ISR writing a sample meanwhile only queues its frame.
+	 * If our caller has interrupts disabled, the frames in progress can't
+	 * finish, so the sample is queued behind them instead. */
+	for (;;)
+	{
+		ucSREG = SREG;
+		cli();
+		if (bDtoABusy == FALSE)
+		{
+			break;
+		}
+		if ((ucSREG & _BV(SREG_I)) == 0)
+		{
+			DtoARequested.auiChannel[0] = Value;
+			if (QueueDtoAFrame(&DtoARequested) != 0)
+			{
+				ReportError(SPI_PREV_TX_INCOMPLETE);
+			}
+			SREG = ucSREG;
+			TRACE(DTOA, TRACE_DEBUG, TRACE_ID_DTOA_WRITE, Value);
+			return;
+		}
+		SREG = ucSREG;
+	}
+	bDtoABusy = TRUE;
 
-	// 1. Shift input value left by 2 bits to match TLC5615 format
-	Value = Value << 2;
+	// Other channels keep their values
+	DtoARequested.auiChannel[0] = Value;
+	Frame = DtoARequested;
+	SREG = ucSREG;
 
-	// 2. Enable the D/A
-	CLEAR_BIT(PORTB, D2A_CS_BIT);
+	/* Select the D/A and send the first byte. Then wait for each byte to
+	 * go, and send the next, until the D/A is deselected. Reading SPSR
+	 * with SPIF set, then writing SPDR, clears SPIF. With the SPI interrupt
+	 * disabled, SPIF is ours. */
+	StartDtoAFrame(&Frame);
+	do
+	{
+		while (!(SPSR & (1 << SPIF)));
+	} while (ContinueDtoAFrame() == TRUE);
 
-	// 3. Read status register and check for any errors.
-	if(SPSR & (1 << 6)){
-		SCIWriteString_P(PSTR("Collision detected\n\r"));
+	// Hand the port back, and start anything queued while we had it
+	ucSREG = SREG;
+	cli();
+	if (StartQueuedDtoAFrame() == TRUE)
+	{
+		SET_BIT(SPCR, SPIE);
+	}
+	else
+	{
+		bDtoABusy = FALSE;
 	}
+	SREG = ucSREG;
+#endif
 
-	// 4. Write the MSB to the D/A
-	SPDR = (unsigned char)(Value >> 8);
+	TRACE(DTOA, TRACE_DEBUG, TRACE_ID_DTOA_WRITE, Value);
+}  /* End of WriteDtoASample */
+
+/******************************************************************************
+ * Interrupt-driven version of WriteDtoASample.
+ *
+ * If the SPI port is idle, the frame is started immediately; otherwise it
+ * waits in the queue. Either way we return as soon as the first byte is in
+ * SPDR. The SPI interrupt then sends the rest, deselects the D/A(s) to
+ * latch the samples, and starts the next queued frame. When the queue
+ * empties, the SPI interrupt is disabled, DtoABusy() returns FALSE, and the
+ * completion callback (if any) is called.
+ *
+ * WriteDtoAFrame sets every channel. The others set one channel, and send
+ * the latest values asked for on the rest.
+ *
+ * Returns 0 on success, or -1 if the queue is full. In that case the frame
+ * is dropped and SPI_PREV_TX_INCOMPLETE is reported.
+ ******************************************************************************/
+int WriteDtoAFrame(const DtoAFrameType *ptrFrame)
+{
+	int iReturnCode;
+	unsigned char ucSREG;
 
-	// 5. Wait for transmission to be complete
-	while(!(SPSR & (1 << SPIF)));
+	/* The ISR can go idle between our test and our update, so this must
+	 * be done with interrupts disabled. It's only a few instructions per
+	 * channel. */
+	ucSREG = SREG;
+	cli();
+	DtoARequested = *ptrFrame;
+	iReturnCode = QueueDtoAFrame(&DtoARequested);
+	SREG = ucSREG;
 
-	// 6. Read status register for errors again
-	if(SPSR & (1 << 6)){
-		SCIWriteString_P(PSTR("Collision detected\n\r"));
+	if (iReturnCode != 0)
+	{
+		ReportError(SPI_PREV_TX_INCOMPLETE);
 	}
 
-	// 7. Write the LSB to the D/A
-	SPDR = (unsigned char)Value;
+	return iReturnCode;
+}
 
-	// 8. Wait for transmission to be complete
-	while(!(SPSR & (1 << SPIF)));
+int WriteDtoAChannelAsync(unsigned char ucChannel, unsigned int Value)
+{
+	int iReturnCode;
+	unsigned char ucSREG;
 
-	// 9. Deselect D/A
-	SET_BIT(PORTB, D2A_CS_BIT);
+	if (ucChannel >= DTOA_NUM_CHANNELS)
+	{
+		ReportError(PARAMETER_OUT_OF_RANGE);
+		return -1;
+	}
 
-#ifdef DEBUG
-	char *ptrValueStr;
-	char ValueStr[20];
-	
-	// Prints int value to serial
-	SCIWriteString_P(PSTR("Value = "));
-    ptrValueStr = ValueStr;
-    _itoa(&ptrValueStr, Value, 10);
-    SCIWriteString(ValueStr);
-    SCIWriteString_P(PSTR("\n\r"));
-#endif /* DEBUG */
+	ucSREG = SREG;
+	cli();
+	DtoARequested.auiChannel[ucChannel] = Value;
+	iReturnCode = QueueDtoAFrame(&DtoARequested);
+	SREG = ucSREG;
 
-}  /* End of WriteDtoASample */
+	if (iReturnCode != 0)
+	{
+		ReportError(SPI_PREV_TX_INCOMPLETE);
+	}
+
+	return iReturnCode;
+}
+
+int WriteDtoASampleAsync(unsigned int Value)
+{
+	return WriteDtoAChannelAsync(0, Value);
+}
+
+/******************************************************************************
+ * Returns TRUE while interrupt-driven frames are still being sent.
+ ******************************************************************************/
+eBooleanType DtoABusy(void)
+{
+	return bDtoABusy;
+}
+
+/******************************************************************************
+ * Returns the last value latched into a D/A, i.e. what it's putting out
+ * now. Returns 0 for a channel that doesn't exist.
+ ******************************************************************************/
+unsigned int GetDtoAChannelValue(unsigned char ucChannel)
+{
+	unsigned int uiValue;
+	unsigned char ucSREG;
+
+	if (ucChannel >= DTOA_NUM_CHANNELS)
+	{
+		return 0;
+	}
+
+	// 16-bit read; don't let the SPI ISR change it halfway through.
+	ucSREG = SREG;
+	cli();
+	uiValue = DtoAValue.auiChannel[ucChannel];
+	SREG = ucSREG;
+	return uiValue;
+}
+
+unsigned int GetDtoAValue(void)
+{
+	return GetDtoAChannelValue(0);
+}
+
+/******************************************************************************
+ * Sets the correction table, DTOA_NUM_CODES entries indexed by sample, or 0
+ * for none. The table is read from the SPI ISR, so it mustn't be changed
+ * while it's in use.
+ ******************************************************************************/
+void SetDtoACorrection(const signed char *ptrTable)
+{
+	// A pointer is two bytes, and the ISR reads it
+	unsigned char ucSREG;
+
+	ucSREG = SREG;
+	cli();
+	ptrDtoACorrection = ptrTable;
+	SREG = ucSREG;
+}
+
+/******************************************************************************
+ * Sets the function to call when the last queued frame has been sent. It's
+ * called from the SPI ISR, or for polled frames from whatever wrote the
+ * frame, so it must be short. Pass 0 to remove it.
+ ******************************************************************************/
+void SetDtoACallback(void (*pfnCallback)(void))
+{
+	pfnDtoAComplete = pfnCallback;
+}
+
+#if !DTOA_POLLED
+/*****************************************************************************
+ * Interrupt Handler for SPI Serial Transfer Complete.
+ * Entering the ISR clears SPIF.
+ *****************************************************************************/
+ISR(SPI_STC_vect)
+{
+	void (*pfnCallback)(void);
+	PROFILE_START(PROFILE_SPI);
+
+	if (ContinueDtoAFrame() == FALSE)
+	{	// Frame is out and latched. Start the next queued one, if any.
+		if (StartQueuedDtoAFrame() == FALSE)
+		{	// Nothing left to send
+			CLEAR_BIT(SPCR, SPIE);
+			bDtoABusy = FALSE;
+
+			pfnCallback = pfnDtoAComplete;
+			if (pfnCallback != 0)
+			{
+				pfnCallback();
+			}
+		}
+	}
+
+	PROFILE_END(PROFILE_SPI);
+}
+#endif /* !DTOA_POLLED */
@@ -13,8 +13,79 @@
 #if !defined(DTOA_H)	/* Prevents including this file multiple times */
 #define DTOA_H
 
+#include "lib.h"
+
+/* Number of frames that can wait for the SPI interrupt to send them */
+#define DTOA_QUEUE_SIZE                 8
+
+/*
+ * Number of D/A converters. Every write sends a frame with a sample for
+ * each of them, in one SPI burst, so a frame takes DTOA_NUM_CHANNELS times
+ * as long to send as a single sample. Writes of one channel leave the
+ * others at their last values.
+ *
+ * With DTOA_DAISY_CHAIN set to 1, each TLC5615's DOUT feeds the next one's
+ * DIN, and they share the D2A_CS_BIT chip select. Raising it latches every
+ * channel at once. Channel 0 is the one wired to the AVR.
+ *
+ * With it set to 0, each converter has its own chip select, and each
+ * latches as soon as its sample is in. DTOA_CS_MASKS gives the Port B
+ * mask for each channel, in channel order.
+ */
+#define DTOA_NUM_CHANNELS               1
+#define DTOA_DAISY_CHAIN                1
+#define DTOA_CS_MASKS                   { _BV(D2A_CS_BIT) }
+
+/*
+ * How the D/A is driven.
+ *
+ * With DTOA_USART_SPI set to 0, it's on the SPI port. By default,
+ * DTOA_SPI_FAST is 0: SCK is Fosc/8, and the SPI interrupt sends each
+ * frame's bytes from a queue. Set to 1, SCK is Fosc/2, so a byte takes only
+ * 16 cycles: less than an interrupt costs. Each frame is then sent by
+ * polling, with interrupts disabled, as soon as it's written. That's the
+ * fastest the D/A can be written, but the writer waits out every frame,
+ * including a waveform's sample ISR, and the Async writes never queue.
+ *
+ * With DTOA_USART_SPI set to 1, it's on USART 1 in SPI master mode instead:
+ * XCK1 (PD5) to SCLK, TXD1 (PD3) to DIN. Clock is Fosc/2 as well, and the
+ * transmitter is double-buffered, so the bytes of a frame go back to back.
+ * Frames are always polled. This needs the D/A wired to those pins.
+ */
+#define DTOA_USART_SPI                  0
+#define DTOA_SPI_FAST                   0
+
+#if DTOA_USART_SPI || DTOA_SPI_FAST
+#define DTOA_POLLED                     1
+#define DTOA_SCK_DIVIDER                2
+#else
+#define DTOA_POLLED                     0
+#define DTOA_SCK_DIVIDER                8
+#endif
+
+/* CPU cycles to shift out one frame, not counting the code around it */
+#define DTOA_FRAME_CYCLES               (16UL * DTOA_SCK_DIVIDER * DTOA_NUM_CHANNELS)
+
+/* The D/A takes 10-bit codes */
+#define DTOA_NUM_CODES                  1024
+#define DTOA_MAX_CODE                   (DTOA_NUM_CODES - 1)
+
+/* One sample for every channel */
+typedef struct
+{
+	unsigned int auiChannel[DTOA_NUM_CHANNELS];
+} DtoAFrameType;
+
 /* Function Prototypes */
 void InitDtoA(void);
-void WriteDtoASample(unsigned int);
+void WriteDtoASample(unsigned int);				// Channel 0
+int  WriteDtoASampleAsync(unsigned int);		// Channel 0
+int  WriteDtoAChannelAsync(unsigned char, unsigned int);	// Channel, value
+int  WriteDtoAFrame(const DtoAFrameType *);		// All channels
+eBooleanType DtoABusy(void);
+unsigned int GetDtoAValue(void);		// Last value latched into channel 0
+unsigned int GetDtoAChannelValue(unsigned char);
+void SetDtoACallback(void (*)(void));	// Called when queue empties
+void SetDtoACorrection(const signed char *);	// Channel 0 calibration table, or 0
 
 #endif /* DTOA_H */
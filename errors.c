@@ -10,22 +10,85 @@
  * 18 Feb 04 T Lill		modified for Winter 04 session
  * 09 May 05 T Lill		Removed deprecated functions.
  ******************************************************************************/
+#include <avr/interrupt.h>
+#include <util/crc16.h>
+
 #include "lib.h"
 #include "errors.h"
+#include "sched.h"
+#include "trace.h"
+
+/* Macro for moving the log index */
+#define LOG_INDEX(index)	((index) & (ERROR_LOG_SIZE - 1))
+
+#if (ERROR_LOG_SIZE & (ERROR_LOG_SIZE - 1)) != 0
+#error "ERROR_LOG_SIZE must be a power of 2"
+#endif
 
 eErrorType SystemError = NO_ERROR;
 
+/*
+ * Every error reported is also added to the log, and counted by type. An
+ * event is written to the slot after the newest, with interrupts disabled
+ * for just the few stores it takes, so ReportError can be called from
+ * anywhere. uiLogNext is the number of the next event, and counts up from
+ * 0; ucLogCount is how many of the latest events are still in the log.
+ */
+static ErrorEventType aErrorLog[ERROR_LOG_SIZE];
+static volatile unsigned int uiLogNext = 0;
+static volatile unsigned char ucLogCount = 0;
+static volatile unsigned int auiErrorCounts[NUM_ERROR_TYPES];
+
 /*****************************************************************************
  * Error handler
  *****************************************************************************/
 void ReportError(eErrorType iError)
 {
+	ReportErrorContext(iError, 0);
+}
+
+/*****************************************************************************
+ * Error handler, with a byte that says more about the error, e.g. which
+ * task overran. It's stored in the log with the error.
+ *****************************************************************************/
+void ReportErrorContext(eErrorType iError, unsigned char ucContext)
+{
+	ErrorEventType *ptrEvent;
+	unsigned int uiTick;
+	unsigned char ucSREG;
+
+	if ((unsigned char)iError >= NUM_ERROR_TYPES)
+	{
+		return;
+	}
+
+	uiTick = GetTickCount();
+	TRACE(ERRORS, TRACE_ERROR, TRACE_ID_ERROR,
+		  ((unsigned int)ucContext << 8) | (unsigned char)iError);
+
+	ucSREG = SREG;
+	cli();
+	ptrEvent = &aErrorLog[LOG_INDEX(uiLogNext)];
+	ptrEvent->uiTick = uiTick;
+	ptrEvent->ucError = (unsigned char)iError;
+	ptrEvent->ucContext = ucContext;
+	++uiLogNext;
+	if (ucLogCount < ERROR_LOG_SIZE)
+	{
+		++ucLogCount;
+	}
+	if (auiErrorCounts[iError] != 0xFFFF)
+	{
+		++auiErrorCounts[iError];
+	}
+
 	// Only allow 1 error to be logged at one time
 	if (SystemError == NO_ERROR)
 	{    /* Record error and set error LED */
 		SystemError = iError;
 		CLEAR_BIT(PORTB, ERROR_LED_BIT);
 	}
+	SREG = ucSREG;
 }
 
 void ClearError(void)
@@ -40,3 +103,148 @@ eErrorType GetError(void)
 	/* Record error and set error LED */
 	return SystemError;
 }
+
+/*****************************************************************************
+ * Returns the number of the oldest event still in the log, and puts the
+ * number of events in it in *pucCount. Events are numbered in the order
+ * they were reported; read them with GetErrorEvent.
+ *****************************************************************************/
+unsigned int GetErrorLogStart(unsigned char *pucCount)
+{
+	unsigned int uiStart;
+	unsigned char ucSREG;
+
+	ucSREG = SREG;
+	cli();
+	*pucCount = ucLogCount;
+	uiStart = uiLogNext - ucLogCount;
+	SREG = ucSREG;
+	return uiStart;
+}
+
+/*****************************************************************************
+ * Copies event number uiEvent. Returns FALSE if it hasn't happened yet, or
+ * has been replaced by a newer one.
+ *****************************************************************************/
+eBooleanType GetErrorEvent(unsigned int uiEvent, ErrorEventType *ptrEvent)
+{
+	eBooleanType bFound = FALSE;
+	unsigned char ucSREG;
+
+	ucSREG = SREG;
+	cli();
+	if ((unsigned int)(uiLogNext - uiEvent - 1) < ucLogCount)
+	{
+		*ptrEvent = aErrorLog[LOG_INDEX(uiEvent)];
+		bFound = TRUE;
+	}
+	SREG = ucSREG;
+	return bFound;
+}
+
+/*****************************************************************************
+ * Returns how many times an error has been reported since the log was last
+ * cleared. Stops at 0xFFFF.
+ *****************************************************************************/
+unsigned int GetErrorCount(eErrorType iError)
+{
+	unsigned int uiCount;
+	unsigned char ucSREG;
+
+	if ((unsigned char)iError >= NUM_ERROR_TYPES)
+	{
+		return 0;
+	}
+
+	// 16-bit read; don't let an ISR change it halfway through.
+	ucSREG = SREG;
+	cli();
+	uiCount = auiErrorCounts[iError];
+	SREG = ucSREG;
+	return uiCount;
+}
+
+/*****************************************************************************
+ * Empties the log and clears the counts. Event numbers carry on from where
+ * they were.
+ *****************************************************************************/
+void ClearErrorLog(void)
+{
+	unsigned char i;
+	unsigned char ucSREG;
+
+	ucLogCount = 0;
+	for (i = 0; i < NUM_ERROR_TYPES; ++i)
+	{
+		ucSREG = SREG;
+		cli();
+		auiErrorCounts[i] = 0;
+		SREG = ucSREG;
+	}
+}
+
+/*****************************************************************************
+ * Builds the binary log frame described in errors.h, and returns its
+ * length. pucFrame must have room for ERROR_LOG_FRAME_SIZE bytes. Events
+ * reported while it's built are left for the next frame.
+ *****************************************************************************/
+unsigned int BuildErrorLogFrame(unsigned char *pucFrame)
+{
+	ErrorEventType Event;
+	unsigned int uiEvent;
+	unsigned int uiCount;
+	unsigned int uiCRC = 0;
+	unsigned int uiLength;
+	unsigned int i;
+	unsigned char ucEntries;
+	unsigned char *ptrOut;
+
+	uiEvent = GetErrorLogStart(&ucEntries);
+
+	pucFrame[0] = ERROR_LOG_SYNC1;
+	pucFrame[1] = ERROR_LOG_SYNC2;
+	pucFrame[2] = (unsigned char)uiEvent;
+	pucFrame[3] = (unsigned char)(uiEvent >> 8);
+	pucFrame[5] = NUM_ERROR_TYPES;
+	ptrOut = &pucFrame[6];
+
+	/* Entries replaced before we get to them are left out. Replacing starts
+	 * with the oldest, so if the first entries go, the start moves past
+	 * them; if any later one goes, the frame stops there, so the entries
+	 * it has are still in a row. */
+	for (i = 0; i < ucEntries; ++i, ++uiEvent)
+	{
+		if (GetErrorEvent(uiEvent, &Event) == FALSE)
+		{
+			if (ptrOut != &pucFrame[6])
+			{
+				break;
+			}
+			pucFrame[2] = (unsigned char)(uiEvent + 1);
+			pucFrame[3] = (unsigned char)((uiEvent + 1) >> 8);
+			continue;
+		}
+		*ptrOut++ = (unsigned char)Event.uiTick;
+		*ptrOut++ = (unsigned char)(Event.uiTick >> 8);
+		*ptrOut++ = Event.ucError;
+		*ptrOut++ = Event.ucContext;
+	}
+	pucFrame[4] = (unsigned char)((ptrOut - &pucFrame[6]) / 4);
+
+	for (i = 0; i < NUM_ERROR_TYPES; ++i)
+	{
+		uiCount = GetErrorCount((eErrorType)i);
+		*ptrOut++ = (unsigned char)uiCount;
+		*ptrOut++ = (unsigned char)(uiCount >> 8);
+	}
+
+	uiLength = ptrOut - pucFrame;
+	for (i = 2; i < uiLength; ++i)
+	{
+		uiCRC = _crc_xmodem_update(uiCRC, pucFrame[i]);
+	}
+	*ptrOut++ = (unsigned char)uiCRC;
+	*ptrOut++ = (unsigned char)(uiCRC >> 8);
+
+	return uiLength + 2;
+}
@@ -13,6 +13,8 @@
 #if !defined(ERRORS_H)		/* Prevents including this file multiple times */
 #define ERRORS_H
 
+#include "lib.h"
+
 typedef enum
 {
     NO_ERROR = 0,
@@ -43,12 +45,61 @@ typedef enum
 
 	// Parameter errors
     INVALID_PARAMETER,
-    PARAMETER_OUT_OF_RANGE
+    PARAMETER_OUT_OF_RANGE,
+
+    // D/A faults
+    DTOA_SAMPLE_UNDERRUN,   // 17
+
+    // Calibration faults
+    CALIBRATION_FAILED,
+
+    // Waveform upload faults
+    ARB_UPLOAD_TIMEOUT,
+    ARB_BUFFER_FULL,
+
+    // Number of error codes. Keep this last.
+    NUM_ERROR_TYPES
 } eErrorType;
 
+/* Number of events kept in the error log. Must be a power of 2, no more
+ * than 256. Once it's full, each new event replaces the oldest. */
+#define ERROR_LOG_SIZE                  32
+
+/* One error log entry */
+typedef struct
+{
+	unsigned int uiTick;		// GetTickCount() when it was reported
+	unsigned char ucError;		// eErrorType
+	unsigned char ucContext;	// Meaning depends on the error; 0 if none
+} ErrorEventType;
+
+/*
+ * A binary error log is sent as one frame:
+ *
+ *   Byte 0-1:  Sync, ERROR_LOG_SYNC1 then ERROR_LOG_SYNC2
+ *        2-3:  Event number of the first entry, LSB first. Events are
+ *              numbered from 0 at reset, and the number wraps.
+ *        4:    Number of entries, N
+ *        5:    Number of counts, NUM_ERROR_TYPES
+ *        6- :  N entries of 4 bytes: tick (LSB first), error, context
+ *        then: One count per error code, 2 bytes each, LSB first
+ *   Last 2:    CRC of bytes 2 up to the end of the counts, LSB first.
+ *              XMODEM CRC, as for the memory dump.
+ */
+#define ERROR_LOG_SYNC1                 0xA5
+#define ERROR_LOG_SYNC2                 0xE7
+#define ERROR_LOG_FRAME_SIZE            (6 + (ERROR_LOG_SIZE * 4) + \
+										 (NUM_ERROR_TYPES * 2) + 2)
+
 /* Function Prototypes */
 void ReportError(eErrorType);
+void ReportErrorContext(eErrorType, unsigned char);
 void ClearError(void);
 eErrorType GetError(void);
+unsigned int GetErrorLogStart(unsigned char *);	// Returns first event number
+eBooleanType GetErrorEvent(unsigned int, ErrorEventType *);
+unsigned int GetErrorCount(eErrorType);
+void ClearErrorLog(void);
+unsigned int BuildErrorLogFrame(unsigned char *);	// ERROR_LOG_FRAME_SIZE bytes
 
 #endif /* ERRORS_H */
@@ -0,0 +1,318 @@
+/******************************************************************************
+ * File Name:	format.c
+ * Program:		Project for Real-Time Embedded Systems Programming class
+ * Purpose:		Integer to string conversions, and back, without division.
+ *				These replace _itoa and _atoi.
+ *
+ *				The AVR has no divide instruction, so '%' and '/' are
+ *				library calls that loop over every bit. Instead:
+ *				- Hex digits come straight from the nibbles of each byte.
+ *				- Decimal digits are found by counting how many times each
+ *				  power of ten can be subtracted. That's at most 9
+ *				  subtractions per digit.
+ *				- Parsing is one pass, multiplying the running value by the
+ *				  radix (a shift for 16) as each digit arrives.
+ ******************************************************************************/
+#include <avr/pgmspace.h>
+
+#include "lib.h"
+#include "errors.h"
+#include "format.h"
+
+static const char HexDigits[16] PROGMEM = "0123456789abcdef";
+
+static const unsigned int Powers16[] PROGMEM =
+{
+	10000, 1000, 100, 10
+};
+
+static const unsigned long Powers32[] PROGMEM =
+{
+	1000000000UL, 100000000UL, 10000000UL, 1000000UL, 100000UL,
+	10000UL, 1000UL, 100UL, 10UL
+};
+
+#define NUM_POWERS16	(sizeof(Powers16)/sizeof(Powers16[0]))
+#define NUM_POWERS32	(sizeof(Powers32)/sizeof(Powers32[0]))
+
+/******************************************************************************
+ * Writes the two hex digits of a byte.
+ ******************************************************************************/
+static char *PutHexByte(char *Buf, unsigned char Byte)
+{
+	*Buf++ = pgm_read_byte(&HexDigits[Byte >> 4]);
+	*Buf++ = pgm_read_byte(&HexDigits[Byte & 0x0F]);
+	return Buf;
+}
+
+/******************************************************************************
+ * Copies a string of NumDigits digits,
+ * dropping leading zeros that aren't needed to fill Width, and appends a
+ * NULL. Returns a pointer to the NULL.
+ ******************************************************************************/
+static char *TrimDigits(char *Buf, const char *Digits, unsigned char NumDigits,
+						unsigned char Width)
+{
+	unsigned char Skip = 0;
+
+	// Always keep at least one digit
+	while ((Skip < (NumDigits - 1)) && (Digits[Skip] == '0') &&
+		   ((NumDigits - Skip) > Width))
+	{
+		++Skip;
+	}
+
+	while (Skip < NumDigits)
+	{
+		*Buf++ = Digits[Skip++];
+	}
+	*Buf = '\0';
+	return Buf;
+}
+
+/******************************************************************************
+ * Converts a 16-bit value to lower-case hex.
+ ******************************************************************************/
+char *FormatHex(char *Buf, unsigned int Value, unsigned char Width)
+{
+	char Digits[4];
+
+	PutHexByte(PutHexByte(Digits, (unsigned char)(Value >> 8)),
+			   (unsigned char)Value);
+	return TrimDigits(Buf, Digits, sizeof(Digits), Width);
+}
+
+/******************************************************************************
+ * Converts a 32-bit value to lower-case hex.
+ ******************************************************************************/
+char *FormatHex32(char *Buf, unsigned long Value, unsigned char Width)
+{
+	char Digits[8];
+	char *ptrDigit = Digits;
+
+	ptrDigit = PutHexByte(ptrDigit, (unsigned char)(Value >> 24));
+	ptrDigit = PutHexByte(ptrDigit, (unsigned char)(Value >> 16));
+	ptrDigit = PutHexByte(ptrDigit, (unsigned char)(Value >> 8));
+	PutHexByte(ptrDigit, (unsigned char)Value);
+	return TrimDigits(Buf, Digits, sizeof(Digits), Width);
+}
+
+/******************************************************************************
+ * Converts an unsigned 16-bit value to decimal.
+ ******************************************************************************/
+char *FormatDec(char *Buf, unsigned int Value, unsigned char Width)
+{
+	char Digits[NUM_POWERS16 + 1];
+	unsigned int Power;
+	unsigned char i;
+
+	for (i = 0; i < NUM_POWERS16; ++i)
+	{
+		Power = pgm_read_word(&Powers16[i]);
+		Digits[i] = '0';
+		while (Value >= Power)
+		{
+			Value -= Power;
+			++Digits[i];
+		}
+	}
+	// What's left is the units digit
+	Digits[NUM_POWERS16] = '0' + (char)Value;
+
+	return TrimDigits(Buf, Digits, sizeof(Digits), Width);
+}
+
+/******************************************************************************
+ * Converts an unsigned 32-bit value to decimal.
+ ******************************************************************************/
+char *FormatDec32(char *Buf, unsigned long Value, unsigned char Width)
+{
+	char Digits[NUM_POWERS32 + 1];
+	unsigned long Power;
+	unsigned char i;
+
+	if (Value <= 0xFFFF)
+	{	// Use the faster 16-bit version
+		return FormatDec(Buf, (unsigned int)Value, Width);
+	}
+
+	for (i = 0; i < NUM_POWERS32; ++i)
+	{
+		Power = pgm_read_dword(&Powers32[i]);
+		Digits[i] = '0';
+		while (Value >= Power)
+		{
+			Value -= Power;
+			++Digits[i];
+		}
+	}
+	Digits[NUM_POWERS32] = '0' + (char)Value;
+
+	return TrimDigits(Buf, Digits, sizeof(Digits), Width);
+}
+
+/******************************************************************************
+ * Converts a signed 16-bit value to decimal, with a leading '-' if it's
+ * negative.
+ ******************************************************************************/
+char *FormatDecSigned(char *Buf, int Value)
+{
+	if (Value < 0)
+	{
+		*Buf++ = '-';
+		// Negate as unsigned, so -32768 works
+		return FormatDec(Buf, 0 - (unsigned int)Value, 0);
+	}
+	return FormatDec(Buf, (unsigned int)Value, 0);
+}
+
+/******************************************************************************
+ * Copies a string from flash, so it can be built into a line with the
+ * numbers.
+ ******************************************************************************/
+char *FormatString_P(char *Buf, PGM_P Str)
+{
+	char cChar;
+
+	while ((cChar = pgm_read_byte(Str++)) != '\0')
+	{
+		*Buf++ = cChar;
+	}
+	*Buf = '\0';
+	return Buf;
+}
+
+/******************************************************************************
+ * Returns the value of a digit character in the specified radix, or 0xFF if
+ * it isn't one.
+ ******************************************************************************/
+static unsigned char DigitValue(char Digit, unsigned char Radix)
+{
+	unsigned char Value;
+
+	if ((Digit >= '0') && (Digit <= '9'))
+	{
+		Value = Digit - '0';
+	}
+	else if ((Digit >= 'a') && (Digit <= 'f'))
+	{	// lower-case ascii
+		Value = Digit - 'a' + 10;
+	}
+	else if ((Digit >= 'A') && (Digit <= 'F'))
+	{	// upper-case ascii
+		Value = Digit - 'A' + 10;
+	}
+	else
+	{
+		return 0xFF;
+	}
+
+	return (Value < Radix) ? Value : 0xFF;
+}
+
+/******************************************************************************
+ * Converts a decimal or hex string to an unsigned 32-bit value.
+ ******************************************************************************/
+eErrorType ParseUnsigned32(const char *Str, unsigned char Radix,
+						   unsigned long *ptrValue)
+{
+	unsigned long Value = 0;
+	unsigned char Digit;
+
+	if (((Radix != 10) && (Radix != 16)) || (*Str == '\0'))
+	{
+		return INVALID_PARAMETER;
+	}
+
+	for ( ; *Str != '\0'; ++Str)
+	{
+		if ((Digit = DigitValue(*Str, Radix)) == 0xFF)
+		{
+			return INVALID_PARAMETER;
+		}
+
+		if (Radix == 16)
+		{
+			if (Value > 0x0FFFFFFFUL)
+			{
+				return PARAMETER_OUT_OF_RANGE;
+			}
+			Value = (Value << 4) | Digit;
+		}
+		else
+		{
+			if ((Value > 429496729UL) ||
+				((Value == 429496729UL) && (Digit > 5)))
+			{
+				return PARAMETER_OUT_OF_RANGE;
+			}
+			// Value * 10, as shifts and an add
+			Value = (Value << 3) + (Value << 1) + Digit;
+		}
+	}
+
+	*ptrValue = Value;
+	return NO_ERROR;
+}
+
+/******************************************************************************
+ * Converts a decimal or hex string to an unsigned 16-bit value.
+ ******************************************************************************/
+eErrorType ParseUnsigned(const char *Str, unsigned char Radix,
+						 unsigned int *ptrValue)
+{
+	unsigned long Value;
+	eErrorType Error;
+
+	if ((Error = ParseUnsigned32(Str, Radix, &Value)) != NO_ERROR)
+	{
+		return Error;
+	}
+	if (Value > 0xFFFF)
+	{
+		return PARAMETER_OUT_OF_RANGE;
+	}
+
+	*ptrValue = (unsigned int)Value;
+	return NO_ERROR;
+}
+
+/******************************************************************************
+ * Converts a decimal or hex string, with an optional leading '-', to a
+ * signed 16-bit value.
+ ******************************************************************************/
+eErrorType ParseSigned(const char *Str, unsigned char Radix, int *ptrValue)
+{
+	eBooleanType bNegative = FALSE;
+	unsigned int Value;
+	eErrorType Error;
+
+	if (*Str == '-')
+	{
+		bNegative = TRUE;
+		++Str;
+	}
+
+	if ((Error = ParseUnsigned(Str, Radix, &Value)) != NO_ERROR)
+	{
+		return Error;
+	}
+
+	if (bNegative == TRUE)
+	{
+		if (Value > 32768U)
+		{
+			return PARAMETER_OUT_OF_RANGE;
+		}
+		*ptrValue = (int)(0 - Value);
+	}
+	else
+	{
+		if (Value > 32767U)
+		{
+			return PARAMETER_OUT_OF_RANGE;
+		}
+		*ptrValue = (int)Value;
+	}
+	return NO_ERROR;
+}
@@ -0,0 +1,41 @@
+/******************************************************************************
+ * File Name:	format.h
+ * Program:		Project for Real-Time Embedded Systems Programming class
+ * Purpose:		Header file for format.c file.
+ ******************************************************************************/
+#if !defined(FORMAT_H)		/* Prevents including this file multiple times */
+#define FORMAT_H
+
+#include <avr/pgmspace.h>
+
+#include "errors.h"
+
+/* Buffer sizes needed for the longest results, including the NULL */
+#define FORMAT_DEC16_SIZE               7     /* "-32768" */
+#define FORMAT_DEC32_SIZE               11    /* "4294967295" */
+#define FORMAT_HEX32_SIZE               9     /* "ffffffff" */
+
+/*
+ * Function Prototypes
+ *
+ * The Format functions write a NULL-terminated string and return a pointer
+ * to the NULL, so calls can be chained. Width is the minimum number of
+ * digits; shorter results are padded with leading zeros. A Width of 0 gives
+ * no padding.
+ */
+char *FormatHex(char *, unsigned int, unsigned char);		// Buffer, value, width
+char *FormatHex32(char *, unsigned long, unsigned char);
+char *FormatDec(char *, unsigned int, unsigned char);
+char *FormatDec32(char *, unsigned long, unsigned char);
+char *FormatDecSigned(char *, int);
+char *FormatString_P(char *, PGM_P);
+
+/* The Parse functions accept radix 10 or 16. They return INVALID_PARAMETER
+ * for an empty string or a character that isn't a digit in the radix, and
+ * PARAMETER_OUT_OF_RANGE if the value doesn't fit. The result is only
+ * written on success. */
+eErrorType ParseUnsigned(const char *, unsigned char, unsigned int *);
+eErrorType ParseUnsigned32(const char *, unsigned char, unsigned long *);
+eErrorType ParseSigned(const char *, unsigned char, int *);
+
+#endif /* FORMAT_H */
@@ -0,0 +1,21 @@
+/******************************************************************************
+ * File Name:	avr/eeprom.h
+ * Program:		Project for Real-Time Embedded Systems Programming class
+ * Purpose:		Host build stand-in for avr-libc's <avr/eeprom.h>. EEMEM
+ *				variables are ordinary variables, read and written
+ *				through hal.c. They start out as 0 rather than erased.
+ ******************************************************************************/
+#if !defined(HOST_AVR_EEPROM_H)	/* Prevents including this file multiple times */
+#define HOST_AVR_EEPROM_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define EEMEM
+#define eeprom_is_ready()		1
+
+uint8_t eeprom_read_byte(const uint8_t *);
+void eeprom_update_byte(uint8_t *, uint8_t);
+void eeprom_read_block(void *, const void *, size_t);
+
+#endif /* HOST_AVR_EEPROM_H */
@@ -0,0 +1,18 @@
+/******************************************************************************
+ * File Name:	avr/interrupt.h
+ * Program:		Project for Real-Time Embedded Systems Programming class
+ * Purpose:		Host build stand-in for avr-libc's <avr/interrupt.h>. An ISR
+ *				is an ordinary function that hal.c, or a test, calls. cli and
+ *				sei only change the I bit in SREG, so code that checks it
+ *				behaves as it would on the target.
+ ******************************************************************************/
+#if !defined(HOST_AVR_INTERRUPT_H)	/* Prevents including this file multiple times */
+#define HOST_AVR_INTERRUPT_H
+
+#include <avr/io.h>
+
+#define ISR(vector)		void vector(void); void vector(void)
+#define cli()			(SREG &= (uint8_t)~_BV(SREG_I))
+#define sei()			(SREG |= _BV(SREG_I))
+
+#endif /* HOST_AVR_INTERRUPT_H */
@@ -0,0 +1,227 @@
+/******************************************************************************
+ * File Name:	avr/io.h
+ * Program:		Project for Real-Time Embedded Systems Programming class
+ * Purpose:		Host build stand-in for avr-libc's <avr/io.h>. Registers are
+ *				the variables in hal.c; bit numbers are the ATmega2560's.
+ ******************************************************************************/
+#if !defined(HOST_AVR_IO_H)	/* Prevents including this file multiple times */
+#define HOST_AVR_IO_H
+
+#include "hal.h"
+
+#define HAL_REG8(name)		extern volatile uint8_t name;
+#define HAL_REG16(name)		extern volatile uint16_t name;
+HAL_REGISTERS
+#undef HAL_REG8
+#undef HAL_REG16
+
+#define HAL_STATUS8(name, ready) \
+	extern volatile uint8_t Hal##name; \
+	static inline volatile uint8_t *HalAccess##name(void) \
+	{ \
+		Hal##name |= (ready); \
+		return &Hal##name; \
+	}
+HAL_STATUS_REGISTERS
+#undef HAL_STATUS8
+
+#define SPSR						(*HalAccessSPSR())
+#define UCSR0A						(*HalAccessUCSR0A())
+#define UCSR1A						(*HalAccessUCSR1A())
+
+#define ADCW						ADC
+
+#define _BV(bit)					(1 << (bit))
+#define _SFR_BYTE(reg)				(reg)
+#define _SFR_IO_ADDR(reg)			(&(reg))
+#define bit_is_set(reg, bit)		((reg) & _BV(bit))
+#define bit_is_clear(reg, bit)		(!((reg) & _BV(bit)))
+
+/* Memory sizes, for the range checks on memory commands */
+#define RAMSTART					0x200
+#define RAMEND						0x21FF
+#define E2END						0xFFF
+
+/* SREG */
+#define SREG_I		7
+
+/* ADC */
+#define ADEN		7
+#define ADSC		6
+#define ADATE		5
+#define ADIF		4
+#define ADIE		3
+#define ADPS2		2
+#define ADPS1		1
+#define ADPS0		0
+#define REFS1		7
+#define REFS0		6
+#define ADLAR		5
+#define MUX4		4
+#define MUX3		3
+#define MUX2		2
+#define MUX1		1
+#define MUX0		0
+#define ACME		6
+#define MUX5		3
+#define ADTS2		2
+#define ADTS1		1
+#define ADTS0		0
+#define ACD			7
+
+/* SPI */
+#define SPIE		7
+#define SPE			6
+#define DORD		5
+#define MSTR		4
+#define CPOL		3
+#define CPHA		2
+#define SPR1		1
+#define SPR0		0
+#define SPIF		7
+#define WCOL		6
+#define SPI2X		0
+
+/* USART 0 and 1 */
+#define RXC0		7
+#define TXC0		6
+#define UDRE0		5
+#define FE0			4
+#define DOR0		3
+#define UPE0		2
+#define U2X0		1
+#define MPCM0		0
+#define RXCIE0		7
+#define TXCIE0		6
+#define UDRIE0		5
+#define RXEN0		4
+#define TXEN0		3
+#define UCSZ02		2
+#define RXB80		1
+#define TXB80		0
+#define UMSEL01		7
+#define UMSEL00		6
+#define UPM01		5
+#define UPM00		4
+#define USBS0		3
+#define UCSZ01		2
+#define UCSZ00		1
+#define UCPOL0		0
+#define RXC1		7
+#define TXC1		6
+#define UDRE1		5
+#define RXCIE1		7
+#define TXCIE1		6
+#define UDRIE1		5
+#define RXEN1		4
+#define TXEN1		3
+#define UMSEL11		7
+#define UMSEL10		6
+#define UDORD1		2
+#define UCPHA1		1
+#define UCPOL1		0
+
+/* Timers 0, 1 and 3 */
+#define COM0A1		7
+#define COM0A0		6
+#define COM0B1		5
+#define COM0B0		4
+#define WGM01		1
+#define WGM00		0
+#define WGM02		3
+#define CS02		2
+#define CS01		1
+#define CS00		0
+#define OCIE0B		2
+#define OCIE0A		1
+#define TOIE0		0
+#define OCF0B		2
+#define OCF0A		1
+#define TOV0		0
+#define WGM11		1
+#define WGM10		0
+#define ICNC1		7
+#define ICES1		6
+#define WGM13		4
+#define WGM12		3
+#define CS12		2
+#define CS11		1
+#define CS10		0
+#define OCIE1A		1
+#define TOIE1		0
+#define WGM31		1
+#define WGM30		0
+#define ICNC3		7
+#define ICES3		6
+#define WGM33		4
+#define WGM32		3
+#define CS32		2
+#define CS31		1
+#define CS30		0
+#define OCIE3A		1
+#define TOIE3		0
+
+/* Power reduction */
+#define PRTWI		7
+#define PRTIM2		6
+#define PRTIM0		5
+#define PRTIM1		3
+#define PRSPI		2
+#define PRUSART0	1
+#define PRADC		0
+#define PRTIM5		5
+#define PRTIM4		4
+#define PRTIM3		3
+#define PRUSART3	2
+#define PRUSART2	1
+#define PRUSART1	0
+
+/* Sleep mode control */
+#define SM2			3
+#define SM1			2
+#define SM0			1
+#define SE			0
+
+/* EEPROM */
+#define EEMPE		2
+#define EEPE		1
+#define EERE		0
+
+/* LCD controller */
+#define LCDEN		7
+#define LCDAB		6
+#define LCDIF		4
+#define LCDIE		3
+#define LCDBL		0
+#define LCDCS		7
+#define LCD2B		6
+#define LCDMUX1		5
+#define LCDMUX0		4
+#define LCDPM2		2
+#define LCDPM1		1
+#define LCDPM0		0
+#define LCDPS2		6
+#define LCDPS1		5
+#define LCDPS0		4
+#define LCDCD2		2
+#define LCDCD1		1
+#define LCDCD0		0
+#define LCDCC3		3
+#define LCDCC2		2
+#define LCDCC1		1
+#define LCDCC0		0
+
+/* Port pins */
+#define PB0			0
+#define PB1			1
+#define PB2			2
+#define PB3			3
+#define PB4			4
+#define PB5			5
+#define PB6			6
+#define PB7			7
+#define PD3			3
+#define PD5			5
+#define PE2			2
+
+#endif /* HOST_AVR_IO_H */
@@ -0,0 +1,30 @@
+/******************************************************************************
+ * File Name:	avr/pgmspace.h
+ * Program:		Project for Real-Time Embedded Systems Programming class
+ * Purpose:		Host build stand-in for avr-libc's <avr/pgmspace.h>. The host
+ *				has one address space, so flash data is ordinary constant
+ *				data. Words and double words are read as the type pointed
+ *				to, since pointers, ints and longs are all wider here than
+ *				on the AVR.
+ ******************************************************************************/
+#if !defined(HOST_AVR_PGMSPACE_H)	/* Prevents including this file multiple times */
+#define HOST_AVR_PGMSPACE_H
+
+#include <stdint.h>
+#include <string.h>
+
+#define PROGMEM
+#define PSTR(s)					(s)
+typedef const char *PGM_P;
+
+#define pgm_read_byte(addr)		(*(const uint8_t *)(addr))
+#define pgm_read_word(addr)		(*(addr))
+#define pgm_read_dword(addr)	(*(addr))
+
+#define memcpy_P				memcpy
+#define strcmp_P				strcmp
+#define strcpy_P				strcpy
+#define strlen_P				strlen
+#define strncmp_P				strncmp
+
+#endif /* HOST_AVR_PGMSPACE_H */
@@ -0,0 +1,18 @@
+/******************************************************************************
+ * File Name:	avr/sleep.h
+ * Program:		Project for Real-Time Embedded Systems Programming class
+ * Purpose:		Host build stand-in for avr-libc's <avr/sleep.h>. Sleeping
+ *				returns at once, as if an interrupt had woken the CPU.
+ ******************************************************************************/
+#if !defined(HOST_AVR_SLEEP_H)	/* Prevents including this file multiple times */
+#define HOST_AVR_SLEEP_H
+
+#include <avr/io.h>
+
+#define SLEEP_MODE_IDLE			0
+#define set_sleep_mode(mode)	(SMCR = (uint8_t)((SMCR & ~(_BV(SM2) | _BV(SM1) | _BV(SM0))) | (mode)))
+#define sleep_enable()			(SMCR |= _BV(SE))
+#define sleep_disable()			(SMCR &= (uint8_t)~_BV(SE))
+#define sleep_cpu()				((void)0)
+
+#endif /* HOST_AVR_SLEEP_H */
@@ -0,0 +1,58 @@
+/******************************************************************************
+ * File Name:	bench_avr.c
+ * Program:		Project for Real-Time Embedded Systems Programming class
+ * Purpose:		Target build main for simavr. Runs the "bm" command through
+ *				the menu, as if it had been typed, then stops. Timer 3 is
+ *				simulated exactly, so the table it prints is in real CPU
+ *				cycles, the same as on a board, and the same from run to run.
+ *				simavr ends the run when the CPU sleeps with interrupts
+ *				disabled.
+ ******************************************************************************/
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+
+#include "lib.h"
+#include "profile.h"
+#include "power.h"
+#include "serial.h"
+#include "dtoa.h"
+#include "waveform.h"
+#include "adc.h"
+#include "lcd.h"
+#include "menu.h"
+#include "bench.h"
+
+int main(void)
+{
+	unsigned char i;
+
+	cli();
+
+	// Same order as main.c, less the things the benchmarks don't use
+	InitProfile();
+	InitPower();
+	SCIInitialize();
+	InitDtoA();
+	InitWaveform();
+	InitAtoD();
+	InitLCD();
+
+	sei();
+
+	// "bm" runs one benchmark per menu pass, then shows the D/A rate
+	RunMenuLine("bm");
+	for (i = 0; i <= GetNumBenchmarks(); ++i)
+	{
+		RunMenu();
+	}
+
+	// Let the last character go out. TXC0 is cleared with each one sent.
+	while (SCITxIdle() == FALSE);
+	while ((UCSR0A & _BV(TXC0)) == 0);
+
+	cli();
+	sleep_enable();
+	sleep_cpu();
+	return 0;
+}
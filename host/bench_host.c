@@ -0,0 +1,383 @@
+/******************************************************************************
+ * File Name:	bench_host.c
+ * Program:		Project for Real-Time Embedded Systems Programming class
+ * Purpose:		Host build main. With no arguments, times the routines in
+ *				bench.c's table by the host's clock, in nanoseconds per
+ *				call. That's only good for comparing one host build with
+ *				the last; cycle counts come from the simavr build (see the
+ *				Makefile). Then times the conversions that replaced older
+ *				code against that code, kept here only for the comparison.
+ *				With arguments, runs each one as a menu command line and
+ *				prints the reply, e.g. "bench_host ge ps".
+ *
+ *				Interrupts stay disabled, so a write that doesn't fit the
+ *				transmit queue fails rather than waiting for an ISR that
+ *				only runs when HalDrainSerial runs it.
+ ******************************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "hal.h"
+#include "lib.h"
+#include "profile.h"
+#include "power.h"
+#include "serial.h"
+#include "dtoa.h"
+#include "waveform.h"
+#include "adc.h"
+#include "calib.h"
+#include "lcd.h"
+#include "menu.h"
+#include "format.h"
+#include "tempsensor.h"
+#include "bench.h"
+
+/* Calls timed between drains of the transmit queue, and how many times.
+ * The menu benchmark queues a reply each call, so a batch has to fit. */
+#define HOST_BATCH              8
+#define HOST_BATCHES            20000
+
+/* Menu passes allowed for one command's output */
+#define HOST_MENU_PASSES        64
+
+/******************************************************************************
+ * Returns the host's monotonic clock, in nanoseconds.
+ ******************************************************************************/
+static unsigned long long Now(void)
+{
+	struct timespec Time;
+
+	clock_gettime(CLOCK_MONOTONIC, &Time);
+	return (unsigned long long)Time.tv_sec * 1000000000ULL + Time.tv_nsec;
+}
+
+/* Results go here, so the compiler can't leave the calls out */
+static volatile int iHostSink;
+
+/* Longest string the old conversions were written for */
+#define OLD_STRLEN              20
+
+/******************************************************************************
+ * _itoa, as lib.c had it before format.c replaced it. Only here to time the
+ * new conversions against.
+ ******************************************************************************/
+static void OldItoa(char **buf, int i, int base)
+{
+	char *s;
+	int rem;
+	char rev[OLD_STRLEN+1];
+
+	if (i == 0)
+	{
+		(*buf)[0] = '0';
+		(*buf)[1] = '\0';
+		return;
+	}
+	if (i < 0)
+	{
+		i = -i;
+		(*buf)[0] = '-';
+		++(*buf);
+	}
+
+	memset(rev, 0, OLD_STRLEN+1);
+	rev[OLD_STRLEN] = 0;
+	s = &rev[OLD_STRLEN];
+
+	while (i)
+	{
+		rem = i % base;
+		if (rem < 10)
+		{
+			*--s = rem + '0';
+		}
+		else if (base == 16)
+		{
+			*--s = "abcdef"[rem - 10];
+		}
+		i /= base;
+	}
+
+	while (*s)
+	{
+		(*buf)[0] = *s++;
+		++(*buf);
+	}
+	(*buf)[0] = '\0';
+}
+
+/******************************************************************************
+ * _atoi, as lib.c had it. Only here for the comparison.
+ ******************************************************************************/
+static int OldAtoi(const char *buf, int base)
+{
+	int StrVal = 0;
+	int StrLength;
+	int i;
+	int power = 1;
+	eBooleanType negNum = FALSE;
+
+	StrLength = strlen(buf);
+	if (*buf == '-')
+	{
+		++buf;
+		negNum = TRUE;
+		StrLength--;
+	}
+
+	for (i = 0; i < StrLength - 1; ++i)
+	{
+		if (base == 10)
+		{
+			power *= 10;
+		}
+		if (base == 16)
+		{
+			power *= 16;
+		}
+	}
+
+	for (i = 0; i < StrLength; ++i)
+	{
+		if ((*buf >= 'a') && (*buf <= 'f'))
+		{
+			StrVal += ((*buf - 'a') + 10) * power;
+		}
+		else if ((*buf >= 'A') && (*buf <= 'F'))
+		{
+			StrVal += ((*buf - 'A') + 10) * power;
+		}
+		else
+		{
+			StrVal += (*buf - '0') * power;
+		}
+		++buf;
+		power /= base;
+	}
+
+	return negNum ? -StrVal : StrVal;
+}
+
+/******************************************************************************
+ * ReadTemperature's formula, as tempsensor.c had it before the table
+ * replaced it, in whole degrees for a 10-bit reading. Only here for the
+ * comparison.
+ ******************************************************************************/
+#define OLD_T_AMB               ((int long)298)
+#define OLD_BETA                ((int long)3380)
+#define OLD_T_ZERO              ((int long)273)
+#define OLD_TEMP1               ((OLD_BETA<<8)/OLD_T_AMB)
+#define OLD_TEMP2               (OLD_TEMP1 - (1<<9))
+
+static volatile unsigned int uiOldReading = 512;
+
+static int OldReadTemperature(void)
+{
+	int long Temperature;
+
+	Temperature = ((OLD_BETA << 2) / ((uiOldReading + OLD_TEMP2) >> 6)) - OLD_T_ZERO;
+	return (int)Temperature;
+}
+
+/*
+ * The pairs compared. 32767 is the largest value the old code took on the
+ * AVR, where int is 16 bits.
+ */
+static void OldDecimal(void)
+{
+	char zBuf[OLD_STRLEN+1];
+	char *ptrBuf = zBuf;
+
+	OldItoa(&ptrBuf, 32767, 10);
+	iHostSink = zBuf[0];
+}
+
+static void NewDecimal(void)
+{
+	char zBuf[FORMAT_DEC16_SIZE];
+
+	FormatDec(zBuf, 32767, 0);
+	iHostSink = zBuf[0];
+}
+
+static void OldHex(void)
+{
+	char zBuf[OLD_STRLEN+1];
+	char *ptrBuf = zBuf;
+
+	OldItoa(&ptrBuf, 0x7fff, 16);
+	iHostSink = zBuf[0];
+}
+
+static void NewHex(void)
+{
+	char zBuf[FORMAT_HEX32_SIZE];
+
+	FormatHex(zBuf, 0x7fff, 0);
+	iHostSink = zBuf[0];
+}
+
+static void OldParseDecimal(void)
+{
+	iHostSink = OldAtoi("32767", 10);
+}
+
+static void NewParseDecimal(void)
+{
+	unsigned int uiValue;
+
+	ParseUnsigned("32767", 10, &uiValue);
+	iHostSink = uiValue;
+}
+
+static void OldParseHex(void)
+{
+	iHostSink = OldAtoi("7fff", 16);
+}
+
+static void NewParseHex(void)
+{
+	unsigned int uiValue;
+
+	ParseUnsigned("7fff", 16, &uiValue);
+	iHostSink = uiValue;
+}
+
+static void OldTemperature(void)
+{
+	iHostSink = OldReadTemperature();
+}
+
+static void NewTemperature(void)
+{
+	iHostSink = ReadTemperature();
+}
+
+typedef struct
+{
+	const char *Name;
+	void (*pfnOld)(void);
+	void (*pfnNew)(void);
+} ComparisonType;
+
+static const ComparisonType Comparisons[] =
+{
+	{ "  decimal 32767  ", OldDecimal,      NewDecimal },
+	{ "  hex 7fff       ", OldHex,          NewHex },
+	{ "  parse \"32767\"  ", OldParseDecimal, NewParseDecimal },
+	{ "  parse \"7fff\"   ", OldParseHex,     NewParseHex },
+	{ "  temperature    ", OldTemperature,  NewTemperature }
+};
+
+#define NUM_COMPARISONS	(sizeof(Comparisons) / sizeof(Comparisons[0]))
+
+/******************************************************************************
+ * Returns the nanoseconds per call of pfnCall.
+ ******************************************************************************/
+static double TimeHostCalls(void (*pfnCall)(void))
+{
+	unsigned long long ullStart;
+	unsigned long i;
+
+	ullStart = Now();
+	for (i = 0; i < (unsigned long)HOST_BATCH * HOST_BATCHES; ++i)
+	{
+		pfnCall();
+	}
+	return (double)(Now() - ullStart) / ((unsigned long)HOST_BATCH * HOST_BATCHES);
+}
+
+/******************************************************************************
+ * Times each conversion against the code it replaced, and prints both.
+ ******************************************************************************/
+static void RunHostComparisons(void)
+{
+	unsigned int i;
+
+	printf("\n  Conversion       old ns   new ns (host)\n");
+	for (i = 0; i < NUM_COMPARISONS; ++i)
+	{
+		printf("%s %6.1f   %6.1f\n", Comparisons[i].Name,
+			   TimeHostCalls(Comparisons[i].pfnOld),
+			   TimeHostCalls(Comparisons[i].pfnNew));
+	}
+}
+
+/******************************************************************************
+ * Times each benchmark, and prints its name and nanoseconds per call.
+ ******************************************************************************/
+static void RunHostBenchmarks(void)
+{
+	unsigned long long ullStart, ullTotal;
+	unsigned char ucIndex;
+	unsigned int i, j;
+
+	printf("  Routine          ns/call (host)\n");
+	for (ucIndex = 0; ucIndex < GetNumBenchmarks(); ++ucIndex)
+	{
+		ullTotal = 0;
+		for (i = 0; i < HOST_BATCHES; ++i)
+		{
+			ullStart = Now();
+			for (j = 0; j < HOST_BATCH; ++j)
+			{
+				CallBenchmark(ucIndex);
+			}
+			ullTotal += Now() - ullStart;
+			HalDrainSerial(NULL);
+		}
+		printf("%s %8.1f\n", GetBenchmarkName(ucIndex),
+			   (double)ullTotal / (HOST_BATCH * HOST_BATCHES));
+	}
+}
+
+/******************************************************************************
+ * Types a command line at the menu, and prints the reply.
+ ******************************************************************************/
+static void RunHostCommand(const char *Line)
+{
+	unsigned int i;
+
+	HalSendSerial(Line);
+	HalSendSerial("\r");
+	for (i = 0; i < HOST_MENU_PASSES; ++i)
+	{
+		RunMenu();
+		HalDrainSerial(stdout);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	int i;
+
+	HalInit();
+
+	// Same order as main.c
+	InitProfile();
+	InitPower();
+	SCIInitialize();
+	InitDtoA();
+	InitWaveform();
+	InitAtoD();
+	InitCalibration();
+	InitLCD();
+
+	if (argc < 2)
+	{
+		HalDrainSerial(NULL);
+		RunHostBenchmarks();
+		RunHostComparisons();
+	}
+	else
+	{
+		HalDrainSerial(stdout);
+		for (i = 1; i < argc; ++i)
+		{
+			RunHostCommand(argv[i]);
+		}
+		printf("\n");
+	}
+	return 0;
+}
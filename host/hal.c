@@ -0,0 +1,118 @@
+/******************************************************************************
+ * File Name:	hal.c
+ * Program:		Project for Real-Time Embedded Systems Programming class
+ * Purpose:		Hardware shim for the host build. Defines the registers in
+ *				hal.h, and plays the part of the USART and EEPROM well
+ *				enough for the menu and the benchmarks to run.
+ *
+ *				The status flags that polling loops wait on (SPIF, UDRE,
+ *				TXC) are set on every access (see hal.h), so every transfer
+ *				finishes at once. The ISRs only run when a Hal call runs
+ *				them. They're called the way the hardware would, with the
+ *				I bit cleared, and it's put back after, as reti would.
+ ******************************************************************************/
+#include <string.h>
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/eeprom.h>
+
+#include "hal.h"
+
+#define HAL_REG8(name)		volatile uint8_t name;
+#define HAL_REG16(name)		volatile uint16_t name;
+HAL_REGISTERS
+#undef HAL_REG8
+#undef HAL_REG16
+
+#define HAL_STATUS8(name, ready)	volatile uint8_t Hal##name;
+HAL_STATUS_REGISTERS
+#undef HAL_STATUS8
+
+/* The serial ISRs, from serial.c */
+void USART0_UDRE_vect(void);
+void USART0_RX_vect(void);
+
+/******************************************************************************
+ * Calls an ISR as the hardware would.
+ ******************************************************************************/
+static void RunISR(void (*pfnVector)(void))
+{
+	unsigned char ucSREG = SREG;
+
+	cli();
+	pfnVector();
+	SREG = ucSREG;
+}
+
+/******************************************************************************
+ * Sets the registers to their reset values. Interrupts start disabled.
+ ******************************************************************************/
+void HalInit(void)
+{
+#define HAL_REG8(name)		name = 0;
+#define HAL_REG16(name)		name = 0;
+	HAL_REGISTERS
+#undef HAL_REG8
+#undef HAL_REG16
+#define HAL_STATUS8(name, ready)	Hal##name = 0;
+	HAL_STATUS_REGISTERS
+#undef HAL_STATUS8
+}
+
+/******************************************************************************
+ * Sends everything queued for USART 0, by running its UDRE ISR for as long
+ * as it's enabled. Each byte goes to ptrFile, unless it's NULL. Returns the
+ * number of bytes sent.
+ ******************************************************************************/
+unsigned int HalDrainSerial(FILE *ptrFile)
+{
+	unsigned int uiCount = 0;
+
+	while ((UCSR0B & _BV(UDRIE0)) != 0)
+	{
+		RunISR(USART0_UDRE_vect);
+		if (ptrFile != NULL)
+		{
+			fputc(UDR0, ptrFile);
+		}
+		++uiCount;
+	}
+	if (ptrFile != NULL)
+	{
+		fflush(ptrFile);
+	}
+	return uiCount;
+}
+
+/******************************************************************************
+ * Receives a string on USART 0, a byte at a time, as if it had been typed.
+ ******************************************************************************/
+void HalSendSerial(const char *Str)
+{
+	while (*Str != '\0')
+	{
+		UDR0 = (uint8_t)*Str++;
+		UCSR0A |= _BV(RXC0);
+		RunISR(USART0_RX_vect);
+		UCSR0A &= (uint8_t)~_BV(RXC0);
+	}
+}
+
+/******************************************************************************
+ * EEPROM access. EEMEM variables are in RAM here, so these are copies.
+ ******************************************************************************/
+uint8_t eeprom_read_byte(const uint8_t *pucAddr)
+{
+	return *pucAddr;
+}
+
+void eeprom_update_byte(uint8_t *pucAddr, uint8_t ucValue)
+{
+	*pucAddr = ucValue;
+}
+
+void eeprom_read_block(void *ptrDest, const void *ptrSource, size_t Length)
+{
+	memcpy(ptrDest, ptrSource, Length);
+}
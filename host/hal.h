@@ -0,0 +1,52 @@
+/******************************************************************************
+ * File Name:	hal.h
+ * Program:		Project for Real-Time Embedded Systems Programming class
+ * Purpose:		Hardware shim for the host build. The AVR registers the
+ *				modules use are plain variables here, declared from the
+ *				list below, so the modules compile unchanged against the
+ *				headers in this directory. Nothing sets a register the way
+ *				the hardware would, except the status registers below, and
+ *				the Hal calls.
+ ******************************************************************************/
+#if !defined(HAL_H)		/* Prevents including this file multiple times */
+#define HAL_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+/* Every register a module uses. HAL_REG8 and HAL_REG16 are defined by the
+ * includer, to declare or define them. */
+#define HAL_REGISTERS \
+	HAL_REG8(ACSR) HAL_REG8(ADCSRA) HAL_REG8(ADCSRB) HAL_REG8(ADMUX) \
+	HAL_REG8(DDRB) HAL_REG8(DDRD) HAL_REG8(DDRE) HAL_REG8(DIDR0) HAL_REG8(DIDR2) \
+	HAL_REG8(EECR) HAL_REG8(LCDCCR) HAL_REG8(LCDCRA) HAL_REG8(LCDCRB) HAL_REG8(LCDFRR) \
+	HAL_REG8(LCDDR0) HAL_REG8(LCDDR1) HAL_REG8(LCDDR2) HAL_REG8(LCDDR3) \
+	HAL_REG8(LCDDR4) HAL_REG8(LCDDR5) HAL_REG8(LCDDR6) HAL_REG8(LCDDR7) \
+	HAL_REG8(LCDDR8) HAL_REG8(LCDDR9) HAL_REG8(LCDDR10) HAL_REG8(LCDDR11) \
+	HAL_REG8(LCDDR12) HAL_REG8(LCDDR13) HAL_REG8(LCDDR14) HAL_REG8(LCDDR15) \
+	HAL_REG8(LCDDR16) HAL_REG8(LCDDR17) HAL_REG8(LCDDR18) \
+	HAL_REG8(OCR0A) HAL_REG8(OCR0B) HAL_REG8(PINB) HAL_REG8(PORTB) HAL_REG8(PORTD) \
+	HAL_REG8(PORTE) HAL_REG8(PRR0) HAL_REG8(PRR1) HAL_REG8(SMCR) \
+	HAL_REG8(SPCR) HAL_REG8(SPDR) HAL_REG8(SREG) \
+	HAL_REG8(TCCR0A) HAL_REG8(TCCR0B) HAL_REG8(TCCR1A) HAL_REG8(TCCR1B) \
+	HAL_REG8(TCCR3A) HAL_REG8(TCCR3B) HAL_REG8(TCNT0) HAL_REG8(TIFR0) \
+	HAL_REG8(TIMSK0) HAL_REG8(TIMSK1) HAL_REG8(TIMSK3) \
+	HAL_REG8(UCSR0B) HAL_REG8(UCSR0C) HAL_REG8(UDR0) \
+	HAL_REG8(UCSR1B) HAL_REG8(UCSR1C) HAL_REG8(UDR1) \
+	HAL_REG16(ADC) HAL_REG16(OCR1A) HAL_REG16(TCNT1) HAL_REG16(TCNT3) \
+	HAL_REG16(UBRR0) HAL_REG16(UBRR1)
+
+/* Status registers whose ready flags polling loops wait on. Each access
+ * sets the flags first, so every transfer is finished by the time it's
+ * checked, whatever was written to the register before. */
+#define HAL_STATUS_REGISTERS \
+	HAL_STATUS8(SPSR, 1 << 7)					/* SPIF */ \
+	HAL_STATUS8(UCSR0A, (1 << 6) | (1 << 5))	/* TXC0, UDRE0 */ \
+	HAL_STATUS8(UCSR1A, (1 << 6) | (1 << 5))	/* TXC1, UDRE1 */
+
+/* Function Prototypes */
+void HalInit(void);
+unsigned int HalDrainSerial(FILE *);	// Returns bytes sent; NULL discards them
+void HalSendSerial(const char *);		// As if typed at the terminal
+
+#endif /* HAL_H */
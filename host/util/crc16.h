@@ -0,0 +1,26 @@
+/******************************************************************************
+ * File Name:	util/crc16.h
+ * Program:		Project for Real-Time Embedded Systems Programming class
+ * Purpose:		Host build stand-in for avr-libc's <util/crc16.h>. Same
+ *				results as the AVR versions, one bit at a time.
+ ******************************************************************************/
+#if !defined(HOST_UTIL_CRC16_H)	/* Prevents including this file multiple times */
+#define HOST_UTIL_CRC16_H
+
+#include <stdint.h>
+
+/* CRC-CCITT, polynomial 0x1021, most significant bit first */
+static inline uint16_t _crc_xmodem_update(uint16_t uiCrc, uint8_t ucData)
+{
+	unsigned char i;
+
+	uiCrc ^= (uint16_t)ucData << 8;
+	for (i = 0; i < 8; ++i)
+	{
+		uiCrc = (uiCrc & 0x8000) ? (uint16_t)((uiCrc << 1) ^ 0x1021)
+								 : (uint16_t)(uiCrc << 1);
+	}
+	return uiCrc;
+}
+
+#endif /* HOST_UTIL_CRC16_H */
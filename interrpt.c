@@ -23,30 +23,11 @@
 #include <avr/interrupt.h>
 
 #include "interrpt.h"
-#include "heartbeat.h"
 #include "errors.h"
 #include "lib.h"
-#include "menu.h"
 #include "serial.h"
-
-// Define execution times for interrupts
-/* Update rate of Main Timer in seconds */
-#define TIMER0_SCALER			1024
-
-// "Medium" thread time set to every 25 mSecs.
-#define TIMER0_TIME             0.025
-/* The following calculates how many counts are needed to achieve the desired
- * rate. There is no checking on the resulting value, which must be less than
- * 255. 
- * For F_CPU = 8 MHz, this value works out to be 195, which is OK. 
- */
-#define TIMER0_CNT				((TIMER0_TIME * F_CPU)/TIMER0_SCALER)
-
-/* Define times for the various medium-thread tasks, based on how often
- * the thread's interrupt occurs. */
-#define HEARTBEAT_TIME          0.5     /* seconds between toggling of LED */
-#define MENU_TIME               0.1     /* seconds between running menu */
-#define MAX_MEDIUM_THREAD_TIME  5       /* max # of mSecs for any task */
+#include "profile.h"
+#include "sched.h"
 
 /******************************************************************************
  * global variables
@@ -79,14 +60,14 @@ void ISR_InitTimer0()
 	 *     5: unused = 0
 	 *     4: unused = 0
 	 *     3: WGM02  = 0  Sets Waveform Generation mode to CTC
-	 *     2: CS02   = 1  Sets prescaler to 1024, I/O clock
-	 *     1: CS01   = 0
-	 *     0: CS00   = 1
+	 *     2: CS02   = x  Prescaler, TIMER0_CS from config.h. 1024 at 8 MHz.
+	 *     1: CS01   = x
+	 *     0: CS00   = x
 	 */
-	TCCR0B = _BV(CS02) | _BV(CS00);
+	TCCR0B = (TIMER0_CS << CS00);
    
-	// Load Compare values for timer 0
-	OCR0A = TIMER0_CNT;
+	// Load Compare values for timer 0. CTC counts 0 to OCR0A.
+	OCR0A = TIMER0_CNT - 1;
 	OCR0B = 0;		// not using this feature
 
 	/*----------------- Set TIMSK0 values -------------------------
@@ -105,55 +86,24 @@ void ISR_InitTimer0()
  * Interrupt handlers
  *****************************************************************************/
 /* 
- * This is the ISR that handles Timer 0 Compare interrupts.
+ * This is the ISR that handles Timer 0 Compare interrupts. It runs the
+ * medium-thread scheduler; see sched.c for the tasks.
  */
 ISR(TIMER0_COMPA_vect)
 {
-	static unsigned int uiMedThreadCount = 1;		
-	static eBooleanType bMedThreadInProgress = FALSE;
+	PROFILE_START(PROFILE_TIMER0);
+
+	// Count down the tasks, and run or ready the ones that are due
+	SchedulerTick();
 
-	// Check for overrun. 
-	if (bMedThreadInProgress == TRUE)
-	{	/* Haven't finished previous time through
-		 * Set error, and don't do any more tasks. Just return. */
+	/* Check for overrun. Entering this ISR cleared the compare flag, so if
+	 * it's set again, we took longer than a whole tick. */
+	if ((TIFR0 & _BV(OCF0A)) != 0)
+	{
 		ReportError(MEDIUM_TASK_OVERRUN);
 	}
-	else
-	{   // No overrun. Continue tasks
-		bMedThreadInProgress = TRUE;
-
-	/**************************************************************************
-	 * Update medium-thread main timer
-	 **************************************************************************/
-		if (uiMedThreadCount >= (unsigned int)
-			(MAX_MEDIUM_THREAD_TIME/TIMER0_TIME))
-		{	/* Reset the interrupt counter */
-			uiMedThreadCount = 1;
-		}
-		else
-		{
-			++uiMedThreadCount;
-		}
 
-	/**************************************************************************
-	 * Call the Medium thread tasks, when it's time
-	 **************************************************************************/    
-       if ((uiMedThreadCount % (unsigned int) 
-             (HEARTBEAT_TIME/TIMER0_TIME)) == 0)
-        {
-            // Toggle the heartbeat LED
-            heartbeat();
-        }
-        
-        if ((uiMedThreadCount % (unsigned int) 
-             (MENU_TIME/TIMER0_TIME)) == 0)
-        {
-            // Toggle the heartbeat LED
-            RunMenu();
-        }
-        // Clear in-progress flag
-        bMedThreadInProgress = FALSE;
-    }   // End of medium thread tasks
+	PROFILE_END(PROFILE_TIMER0);
 }
 /* This handler takes care of all unused interrupts
  */
@@ -15,6 +15,9 @@
 #define INTERRPT_H
 #include <avr/interrupt.h>
 
+/* The tick rate and task periods are in config.h */
+#include "config.h"
+
 /* Interrupt prototypes */
 void ISR_InitTimer0(void);
 
@@ -12,48 +12,109 @@
 /********************************* Includes ***********************************/
 #include <avr/io.h>
 #include <avr/interrupt.h>
+#include <avr/pgmspace.h>
 
 #include "interrpt.h"
 #include "errors.h"
 #include "lib.h"
 #include "lcd.h"
+#include "format.h"
+
+/* The LCD data registers, LCDDR0 to LCDDR17, are at consecutive addresses,
+ * so LCDDRn is (&LCDDR0)[n]. Each character uses one nibble in each of four
+ * registers, LCD_REG_STRIDE apart. LCDDR4, 9 and 14 hold no segments. */
+#define LCD_NUM_DATA_REGS		18
+#define LCD_REG_STRIDE			5
+#define LCD_REG_UNUSED(n)		(((n) % LCD_REG_STRIDE) == 4)
 
 /******************************************************************************
  * global variables
  *****************************************************************************/
-/* This array defines what segments need to be turned on for each character.
- * The lowest nibble gets written to the lowest LCDDR register, the highest
- * nibble to the highest LCDDR register. */
-const static unsigned int NumberSegments[10] =
+/* Segment bits for one character. The lowest nibble gets written to the
+ * lowest LCDDR register, the highest nibble to the highest LCDDR register.
+ * Segments are lettered clockwise from the top (a), with g in the middle;
+ * g is two bits. */
+#define SEG_A		0x0001
+#define SEG_B		0x0010
+#define SEG_C		0x0100
+#define SEG_D		0x1000
+#define SEG_E		0x0400
+#define SEG_F		0x0040
+#define SEG_G		0x0A00
+
+/* Marks a character the LCD can't show */
+#define SEG_INVALID	0xFFFF
+
+/* Segments for each character from ' ' to 'F', indexed by LCDChar - ' '.
+ * Lower case a-f are shown as upper case. */
+#define SEG_TABLE_FIRST		' '
+#define SEG_TABLE_LAST		'F'
+
+static const unsigned int SegmentTable[SEG_TABLE_LAST - SEG_TABLE_FIRST + 1] PROGMEM =
 {
-	0x1551,		// 0
-	0x0110,		// 1
-	0x1E11,		// 2
-	0x1B11,		// 3
-	0x0B50,		// 4
-	0x1B41,		// 5
-	0x1F40,		// 6
-	0x0111,		// 7
-	0x1F51,		// 8
-	0x0B51 		// 9
+	0x0000,										// ' '
+	SEG_INVALID, SEG_INVALID, SEG_INVALID,		// ! " #
+	SEG_INVALID, SEG_INVALID, SEG_INVALID,		// $ % &
+	SEG_INVALID, SEG_INVALID, SEG_INVALID,		// ' ( )
+	SEG_INVALID, SEG_INVALID,					// * +
+	SEG_INVALID,								// ,
+	SEG_G,										// -
+	SEG_INVALID, SEG_INVALID,					// . /
+	SEG_A | SEG_B | SEG_C | SEG_D | SEG_E | SEG_F,	// 0 = 0x1551
+	SEG_B | SEG_C,								// 1 = 0x0110
+	SEG_A | SEG_B | SEG_G | SEG_E | SEG_D,		// 2 = 0x1E11
+	SEG_A | SEG_B | SEG_G | SEG_C | SEG_D,		// 3 = 0x1B11
+	SEG_F | SEG_G | SEG_B | SEG_C,				// 4 = 0x0B50
+	SEG_A | SEG_F | SEG_G | SEG_C | SEG_D,		// 5 = 0x1B41
+	SEG_F | SEG_E | SEG_D | SEG_C | SEG_G,		// 6 = 0x1F40
+	SEG_A | SEG_B | SEG_C,						// 7 = 0x0111
+	SEG_A | SEG_B | SEG_C | SEG_D | SEG_E | SEG_F | SEG_G,	// 8 = 0x1F51
+	SEG_A | SEG_B | SEG_C | SEG_F | SEG_G,		// 9 = 0x0B51
+	SEG_INVALID, SEG_INVALID, SEG_INVALID,		// : ; <
+	SEG_INVALID, SEG_INVALID, SEG_INVALID,		// = > ?
+	SEG_INVALID,								// @
+	SEG_A | SEG_B | SEG_C | SEG_E | SEG_F | SEG_G,	// A
+	SEG_C | SEG_D | SEG_E | SEG_F | SEG_G,		// b
+	SEG_A | SEG_D | SEG_E | SEG_F,				// C
+	SEG_B | SEG_C | SEG_D | SEG_E | SEG_G,		// d
+	SEG_A | SEG_D | SEG_E | SEG_F | SEG_G,		// E
+	SEG_A | SEG_E | SEG_F | SEG_G				// F
 };
 
-// Values for controlling what's displayed on LCD
-typedef enum  
+/* Where each character position's nibbles are. ucReg is the lowest of its
+ * four LCDDR registers, and ucShift is 0 for the low nibble or 4 for the
+ * high one. Indexed by Position - LCD_FIRST_POSITION. */
+typedef struct
 {
-	VOLTAGE_ACTUAL,
-	FREQUENCY_ACTUAL,
-	VOLTAGE_DESIRED,
-	FREQUENCY_DESIRED
-} LCDValueType;
+	unsigned char ucReg;
+	unsigned char ucShift;
+} LCDPositionType;
+
+static const LCDPositionType PositionTable[LCD_LAST_POSITION - LCD_FIRST_POSITION + 1] PROGMEM =
+{
+	{ 0, 0 },		// 2
+	{ 0, 4 },		// 3
+	{ 1, 0 },		// 4
+	{ 1, 4 },		// 5
+	{ 2, 0 },		// 6
+	{ 2, 4 }		// 7
+};
+
+/* Shadow copy of the LCD data registers. Characters are written here, and
+ * the LCD interrupt copies the whole frame to the registers in one pass
+ * right after a frame starts, so the display never shows half an update.
+ * The ISR doesn't copy while ucLCDUpdateDepth is nonzero. */
+static unsigned char aucLCDShadow[LCD_NUM_DATA_REGS];
+static volatile unsigned char ucLCDUpdateDepth = 0;
+static volatile eBooleanType bLCDCommitPending = FALSE;
 
 /******************************************************************************
  * Function prototypes
  *****************************************************************************/
-eErrorType GetLCDDRValues(char LCDChar,
-			   char *LCDDRx, char *LCDDRx5, char *LCDDRx10, char *LCDDRx15);
-eErrorType GetLCDDRx(char CharPosition, char *LCDDRx, char *Nibble);
-void LCDWrite(char LCDChar, unsigned char Position);
+eErrorType GetLCDDRValues(char LCDChar, unsigned int *Segments);
+eErrorType GetLCDDRx(unsigned char CharPosition, unsigned char *LCDDRx,
+					 unsigned char *Shift);
+static eErrorType SetShadowChar(char LCDChar, unsigned char Position);
 
 /******************************************************************************
  * Initialization routines for used interrupts
@@ -134,49 +195,95 @@ void InitLCD()
 /******************************************************************************
  * Get values for LCDDR registers
  *****************************************************************************/
-eErrorType GetLCDDRValues(char LCDChar,
-			   char *LCDDRx, char *LCDDRx5, char *LCDDRx10, char *LCDDRx15)
+eErrorType GetLCDDRValues(char LCDChar, unsigned int *Segments)
 {
-	int index = LCDChar - '0';
+	unsigned int uiSegments;
 
-	if ((LCDChar >= '0') && (LCDChar <= '9'))
-	{
-		*LCDDRx   =  NumberSegments[index] & 0x000F;
-		*LCDDRx5  = (NumberSegments[index] & 0x00F0) >> 4;
-		*LCDDRx10 = (NumberSegments[index] & 0x0F00) >> 8;
-		*LCDDRx15 = (NumberSegments[index] & 0xF000) >> 12;
-		return NO_ERROR;
+	if ((LCDChar >= 'a') && (LCDChar <= 'f'))
+	{	// Show hex digits the same in either case
+		LCDChar -= 'a' - 'A';
 	}
 
-	else if (LCDChar == ' ')
+	if ((LCDChar < SEG_TABLE_FIRST) || (LCDChar > SEG_TABLE_LAST))
 	{
-		*LCDDRx   = 0x00;
-		*LCDDRx5  = 0x00;
-		*LCDDRx10 = 0x00;
-		*LCDDRx15 = 0x00;
-		return NO_ERROR;
+		return LCD_INVALID_CHAR;
 	}
 
-	else
+	uiSegments = pgm_read_word(&SegmentTable[LCDChar - SEG_TABLE_FIRST]);
+	if (uiSegments == SEG_INVALID)
 	{
 		return LCD_INVALID_CHAR;
 	}
+
+	*Segments = uiSegments;
+	return NO_ERROR;
 }
 
 /******************************************************************************
- * Get values for LCDDR registers
+ * Get the LCDDR register and nibble for a character position
  *****************************************************************************/
-eErrorType GetLCDDRx(char CharPosition, char *LCDDRx, char *Nibble)
+eErrorType GetLCDDRx(unsigned char CharPosition, unsigned char *LCDDRx,
+					 unsigned char *Shift)
 {
-	if ((CharPosition >= 2) && (CharPosition <= 7))
+	if ((CharPosition < LCD_FIRST_POSITION) || (CharPosition > LCD_LAST_POSITION))
 	{
-		*LCDDRx = (CharPosition / 2) - 1;
-		*Nibble = CharPosition % 2;
-		return NO_ERROR;
+		return LCD_INVALID_POS;
 	}
-	else
+
+	CharPosition -= LCD_FIRST_POSITION;
+	*LCDDRx = pgm_read_byte(&PositionTable[CharPosition].ucReg);
+	*Shift  = pgm_read_byte(&PositionTable[CharPosition].ucShift);
+	return NO_ERROR;
+}
+
+/******************************************************************************
+ * Puts a character's segments into the shadow registers
+ *****************************************************************************/
+static eErrorType SetShadowChar(char LCDChar, unsigned char Position)
+{
+	unsigned int uiSegments;
+	unsigned char ucReg, ucShift, ucMask, i;
+	eErrorType error;
+
+	if (((error = GetLCDDRx(Position, &ucReg, &ucShift)) == NO_ERROR) &&
+	    ((error = GetLCDDRValues(LCDChar, &uiSegments)) == NO_ERROR))
 	{
-		return LCD_INVALID_POS;
+		ucMask = (ucShift == 0) ? 0xF0 : 0x0F;
+		for (i = 0; i < 4; ++i)
+		{
+			aucLCDShadow[ucReg] = (aucLCDShadow[ucReg] & ucMask) |
+								  (((unsigned char)uiSegments & 0x0F) << ucShift);
+			uiSegments >>= 4;
+			ucReg += LCD_REG_STRIDE;
+		}
+	}
+	return error;
+}
+
+/******************************************************************************
+ * Starts a group of changes to the display. Nothing is shown until the
+ * matching LCDEndUpdate. Calls may be nested.
+ *****************************************************************************/
+void LCDBeginUpdate(void)
+{
+	++ucLCDUpdateDepth;
+}
+
+/******************************************************************************
+ * Ends a group of changes. Once the outermost group ends, the LCD interrupt
+ * is enabled, so the frame is committed at the next frame start.
+ *****************************************************************************/
+void LCDEndUpdate(void)
+{
+	if (ucLCDUpdateDepth != 0)
+	{
+		--ucLCDUpdateDepth;
+	}
+
+	if (ucLCDUpdateDepth == 0)
+	{
+		bLCDCommitPending = TRUE;
+		SET_BIT(LCDCRA, LCDIE);
 	}
 }
 
@@ -185,74 +292,83 @@ eErrorType GetLCDDRx(char CharPosition, char *LCDDRx, char *Nibble)
  *****************************************************************************/
 void LCDWrite(char LCDChar, unsigned char Position)
 {
-	char Nibble, LCDDRx;
-	char LCDDRxValue, LCDDRx5Value, LCDDRx10Value, LCDDRx15Value;
 	eErrorType error;
 
-	if (((error = GetLCDDRx(Position, &LCDDRx, &Nibble)) == NO_ERROR) &&
-	    ((error = GetLCDDRValues(LCDChar, &LCDDRxValue, &LCDDRx5Value,
-					&LCDDRx10Value, &LCDDRx15Value)) == NO_ERROR))
+	LCDBeginUpdate();
+	if ((error = SetShadowChar(LCDChar, Position)) != NO_ERROR)
+	{
+		ReportError(error);
+	}
+	LCDEndUpdate();
+}
+
+/******************************************************************************
+ * Writes a string to the LCD, starting at Position. Characters past the last
+ * position are dropped. The whole string appears in the same frame.
+ *****************************************************************************/
+void LCDWriteString(const char *Str, unsigned char Position)
+{
+	eErrorType error;
+
+	LCDBeginUpdate();
+	while ((*Str != '\0') && (Position <= LCD_LAST_POSITION))
 	{
-		switch (LCDDRx)
+		if ((error = SetShadowChar(*Str, Position)) != NO_ERROR)
 		{
-			case 0:
-				if (Nibble == 0)
-				{
-					LCDDR0  = (LCDDR0  & 0xF0) | LCDDRxValue;
-					LCDDR5  = (LCDDR5  & 0xF0) | LCDDRx5Value;
-					LCDDR10 = (LCDDR10 & 0xF0) | LCDDRx10Value;
-					LCDDR15 = (LCDDR15 & 0xF0) | LCDDRx15Value;
-				}
-				else
-				{
-					LCDDR0  = (LCDDR0  & 0x0F) | (LCDDRxValue << 4);
-					LCDDR5  = (LCDDR5  & 0x0F) | (LCDDRx5Value << 4);
-					LCDDR10 = (LCDDR10 & 0x0F) | (LCDDRx10Value << 4);
-					LCDDR15 = (LCDDR15 & 0x0F) | (LCDDRx15Value << 4);
-				}
-				break;
-
-			case 1:
-				if (Nibble == 0)
-				{
-					LCDDR1  = (LCDDR1  & 0xF0) | LCDDRxValue;
-					LCDDR6  = (LCDDR6  & 0xF0) | LCDDRx5Value;
-					LCDDR11 = (LCDDR11 & 0xF0) | LCDDRx10Value;
-					LCDDR16 = (LCDDR16 & 0xF0) | LCDDRx15Value;
-				}
-				else
-				{
-					LCDDR1  = (LCDDR1  & 0x0F) | (LCDDRxValue << 4);
-					LCDDR6  = (LCDDR6  & 0x0F) | (LCDDRx5Value << 4);
-					LCDDR11 = (LCDDR11 & 0x0F) | (LCDDRx10Value << 4);
-					LCDDR16 = (LCDDR16 & 0x0F) | (LCDDRx15Value << 4);
-				}
-				break;
-
-			case 2:
-				if (Nibble == 0)
-				{
-					LCDDR2  = (LCDDR2  & 0xF0) | LCDDRxValue;
-					LCDDR7  = (LCDDR7  & 0xF0) | LCDDRx5Value;
-					LCDDR12 = (LCDDR12 & 0xF0) | LCDDRx10Value;
-					LCDDR17 = (LCDDR17 & 0xF0) | LCDDRx15Value;
-				}
-				else
-				{
-					LCDDR2  = (LCDDR2  & 0x0F) | (LCDDRxValue << 4);
-					LCDDR7  = (LCDDR7  & 0x0F) | (LCDDRx5Value << 4);
-					LCDDR12 = (LCDDR12 & 0x0F) | (LCDDRx10Value << 4);
-					LCDDR17 = (LCDDR17 & 0x0F) | (LCDDRx15Value << 4);
-				}
-				break;
-
-			default:
-				// Should never happen
-				break;
+			ReportError(error);
 		}
+		++Str;
+		++Position;
 	}
-	else
+	LCDEndUpdate();
+}
+
+/******************************************************************************
+ * Writes a number to the LCD, right-justified in Width positions starting at
+ * Position, with leading blanks.
+ *****************************************************************************/
+void LCDWriteNumber(unsigned int Value, unsigned char Position,
+					unsigned char Width)
+{
+	char zDigits[FORMAT_DEC16_SIZE];
+	unsigned char ucLength;
+
+	ucLength = FormatDec(zDigits, Value, 0) - zDigits;
+
+	LCDBeginUpdate();
+	while (Width > ucLength)
 	{
-		ReportError(error);
+		SetShadowChar(' ', Position++);
+		--Width;
+	}
+	LCDWriteString(&zDigits[ucLength - Width], Position);
+	LCDEndUpdate();
+}
+
+/******************************************************************************
+ * LCD frame start interrupt. Copies the shadow registers to the LCD, unless
+ * they're part way through an update, in which case it tries again next
+ * frame. Disables itself once there's nothing to copy.
+ *****************************************************************************/
+ISR(LCD_vect)
+{
+	unsigned char i;
+	volatile unsigned char *ptrLCDDR = &LCDDR0;
+
+	if ((bLCDCommitPending == TRUE) && (ucLCDUpdateDepth == 0))
+	{
+		for (i = 0; i < LCD_NUM_DATA_REGS; ++i)
+		{
+			if (!LCD_REG_UNUSED(i))
+			{
+				ptrLCDDR[i] = aucLCDShadow[i];
+			}
+		}
+		bLCDCommitPending = FALSE;
+	}
+
+	if (bLCDCommitPending == FALSE)
+	{
+		CLEAR_BIT(LCDCRA, LCDIE);
 	}
 }
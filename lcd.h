@@ -7,9 +7,17 @@
 #if !defined(LCD_H)		/* Prevents including this file multiple times */
 #define LCD_H
 
+/* Character positions on the STK502 LCD */
+#define LCD_FIRST_POSITION              2
+#define LCD_LAST_POSITION               7
+
 /* Interrupt prototypes */
 void InitLCD(void);
 void LCDWrite(char,             // LCD character
-               unsigned char);  // Position (0 - 5)
+               unsigned char);  // Position (2 - 7)
+void LCDWriteString(const char *, unsigned char);
+void LCDWriteNumber(unsigned int, unsigned char, unsigned char);	// Value, position, width
+void LCDBeginUpdate(void);
+void LCDEndUpdate(void);
 
 #endif /* LCD_H */
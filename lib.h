@@ -18,8 +18,6 @@
 
 #include <avr/io.h>
 
-#define STRLEN 20			/* Maximum string length for conversions */
-
 /* Define memory mapping for commonly used registers */
 
 // Define Port B uses
@@ -50,12 +48,22 @@ typedef enum {
 // Macro to toggle bits. 
 #define tbi(sfr, bit) (_SFR_BYTE(sfr) ^= _BV(bit))
 
-/* Function Prototypes */
-void _itoa(char **,			// Buffer to store converted string into
-			int,			// Value to convert
-			int);			// Radix (only 10 or 16 allowed)
-			
-int _atoi(char *, 			// String to convert
-			int);			// Radix (only 10 or 16 allowed)
+/*
+ * Sets or clears one bit of a low I/O register (PORTx, PINx, DDRx) with a
+ * single sbi or cbi instruction, at any optimization level. Setting a PINx
+ * bit toggles that PORTx bit. The host build (see host/) has no such
+ * instructions, so there they're plain C.
+ */
+#if defined(HOST_BUILD)
+#define SBI(port, bit)	((port) |= _BV(bit))
+#define CBI(port, bit)	((port) &= (unsigned char)~_BV(bit))
+#else
+#define SBI(port, bit)	asm volatile ("sbi %0, %1" : : "I" (_SFR_IO_ADDR(port)), "I" (bit))
+#define CBI(port, bit)	asm volatile ("cbi %0, %1" : : "I" (_SFR_IO_ADDR(port)), "I" (bit))
+#endif
+
+/* Macro for moving circular buffer pointers */
+#define INC_CIRC_BUFFER_PTR(ptr, Addr, Length)	            \
+    ((ptr >= Addr + Length - 1) ? Addr : ptr+1)
 
 #endif /* LIB_H */
@@ -19,6 +19,18 @@
 #include "serial.h"
 #include "lcd.h"
 #include "dtoa.h"
+#include "waveform.h"
+#include "samplebuf.h"
+#include "profile.h"
+#include "sched.h"
+#include "memdump.h"
+#include "adc.h"
+#include "calib.h"
+#include "arb.h"
+#include "power.h"
+#include "trace.h"
+#include "sequence.h"
+#include "telemetry.h"
 
 /************************* Function Prototypes ******************************/
 int main(void);
@@ -33,7 +45,7 @@ int main(void);
  */
 void heartbeat(void)
 {
-	asm volatile (" sbi	0x03, 0 ");	// see warning in lib.h about SET_BIT
+	SBI(PINB, HEARTBEAT_LED_BIT);	// see warning in lib.h about SET_BIT
 }
 
 /*****************************************************************************
@@ -51,6 +63,12 @@ int main(void)
 	DDRB = 0xFF;
 	PORTB = 0xFF;
 
+    /* Start the execution-time profiler's free-running timer */
+    InitProfile();
+
+    /* Switch off unused peripherals */
+    InitPower();
+
     /* Initialize the Timer 0 */
     ISR_InitTimer0();
 
@@ -60,13 +78,50 @@ int main(void)
 	// Initialize SPI port
 	InitDtoA();
 
+	// Initialize waveform generator. It stays off until selected.
+	InitWaveform();
+
+	// Start background A/D sampling
+	InitAtoD();
+
+	// Load this board's D/A correction, if it's been calibrated
+	InitCalibration();
+
+	// Initialize the LCD. The display task fills it in.
+	InitLCD();
+
     /* Enable interrupts. Do as last initialization, so interrupts are
      * not initiated until all of initialization is complete. */
    sei();
 
    for ( ; ; )		/* Foreground loops forever */
    {   // Do slow tasks here
-      
+      // Run any medium-thread tasks the Timer 0 ISR has readied
+      RunScheduler();
+
+      // Keep the D/A sample buffer topped up
+      ServiceSampleBuffer();
+
+      // Send the next part of any binary memory dump
+      ServiceMemoryDump();
+
+      // Do the next step of any D/A calibration
+      ServiceCalibration();
+
+      // Answer waveform upload frames, and start or stop their playback
+      ServiceArbitrary();
+
+      // Move any sequence on to its next step
+      ServiceSequence();
+
+      // Send any trace events recorded since the last pass
+      ServiceTrace();
+
+      // Sample for telemetry, and send a frame when one is due
+      ServiceTelemetry();
+
+      // Nothing left to do. Sleep until the next interrupt.
+      IdleSleep();
    }   /* end of endless loop */
 
 	return 0;
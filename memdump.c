@@ -0,0 +1,188 @@
+/******************************************************************************
+ * File Name:	memdump.c
+ * Program:		Project for Real-Time Embedded Systems Programming class
+ * Purpose:		Sends a block of RAM out the serial port as one binary frame
+ *				(see memdump.h). The frame is copied straight from RAM into
+ *				the transmit buffer, a buffer's worth at a time, from the
+ *				foreground loop, so a dump runs at the full line rate without
+ *				holding up the menu task.
+ *
+ *				The memory is not frozen while it's sent. Variables that
+ *				interrupts change may change part way through the dump.
+ ******************************************************************************/
+#include <string.h>
+#include <stdint.h>
+#include <avr/io.h>
+#include <util/crc16.h>
+
+#include "lib.h"
+#include "errors.h"
+#include "serial.h"
+#include "memdump.h"
+
+#define MEMDUMP_HEADER_SIZE             6
+#define MEMDUMP_CRC_SIZE                2
+#define MEMDUMP_CHUNK_SIZE              16
+
+typedef enum
+{
+	DUMP_IDLE = 0,
+	DUMP_HEADER,
+	DUMP_DATA,
+	DUMP_CRC
+} DumpStateType;
+
+static DumpStateType DumpState = DUMP_IDLE;
+static unsigned char aucDumpHeader[MEMDUMP_HEADER_SIZE];
+static const unsigned char *ptrDumpAddress;
+static unsigned int uiDumpRemaining;
+static unsigned int uiDumpCRC;
+
+/******************************************************************************
+ * Adds a block of bytes to the running CRC.
+ ******************************************************************************/
+static void UpdateDumpCRC(const unsigned char *ptrData, unsigned int Length)
+{
+	while (Length-- != 0)
+	{
+		uiDumpCRC = _crc_xmodem_update(uiDumpCRC, *ptrData++);
+	}
+}
+
+/******************************************************************************
+ * Starts a dump of Length bytes from Address. The whole block must be in
+ * RAM; the register and I/O space is refused, since reading some registers
+ * changes them.
+ ******************************************************************************/
+eErrorType StartMemoryDump(unsigned int Address, unsigned int Length)
+{
+	if (DumpState != DUMP_IDLE)
+	{
+		return INVALID_PARAMETER;
+	}
+
+	if ((Length == 0) || (Address < RAMSTART) || (Address > RAMEND) ||
+		((Length - 1) > (RAMEND - Address)))
+	{
+		return PARAMETER_OUT_OF_RANGE;
+	}
+
+	aucDumpHeader[0] = MEMDUMP_SYNC1;
+	aucDumpHeader[1] = MEMDUMP_SYNC2;
+	aucDumpHeader[2] = (unsigned char)Address;
+	aucDumpHeader[3] = (unsigned char)(Address >> 8);
+	aucDumpHeader[4] = (unsigned char)Length;
+	aucDumpHeader[5] = (unsigned char)(Length >> 8);
+
+	ptrDumpAddress  = (const unsigned char *)(uintptr_t)Address;
+	uiDumpRemaining = Length;
+	uiDumpCRC       = 0;
+	UpdateDumpCRC(&aucDumpHeader[2], MEMDUMP_HEADER_SIZE - 2);
+
+	DumpState = DUMP_HEADER;
+	return NO_ERROR;
+}
+
+/******************************************************************************
+ * Copies as much of the frame as fits into the transmit buffer. Does nothing
+ * when no dump is in progress.
+ ******************************************************************************/
+void ServiceMemoryDump(void)
+{
+	unsigned int uiSpace;
+	unsigned char aucChunk[MEMDUMP_CHUNK_SIZE];
+	unsigned char ucChunk;
+
+	if (DumpState == DUMP_IDLE)
+	{
+		return;
+	}
+
+	uiSpace = SCITxSpace();
+
+	switch (DumpState)
+	{
+		case DUMP_HEADER:
+			if (uiSpace >= MEMDUMP_HEADER_SIZE)
+			{
+				SCIWriteBlock(aucDumpHeader, MEMDUMP_HEADER_SIZE);
+				DumpState = DUMP_DATA;
+			}
+			break;
+
+		case DUMP_DATA:
+			if (uiSpace > uiDumpRemaining)
+			{
+				uiSpace = uiDumpRemaining;
+			}
+
+			/* Copy through a small buffer, so the CRC covers exactly the
+			 * bytes sent even if an interrupt changes memory meanwhile. */
+			while (uiSpace != 0)
+			{
+				ucChunk = (uiSpace > MEMDUMP_CHUNK_SIZE) ?
+							MEMDUMP_CHUNK_SIZE : (unsigned char)uiSpace;
+				memcpy(aucChunk, ptrDumpAddress, ucChunk);
+				UpdateDumpCRC(aucChunk, ucChunk);
+				SCIWriteBlock(aucChunk, ucChunk);
+				ptrDumpAddress  += ucChunk;
+				uiDumpRemaining -= ucChunk;
+				uiSpace         -= ucChunk;
+			}
+
+			if (uiDumpRemaining == 0)
+			{
+				DumpState = DUMP_CRC;
+			}
+			break;
+
+		case DUMP_CRC:
+			if (uiSpace >= MEMDUMP_CRC_SIZE)
+			{
+				aucChunk[0] = (unsigned char)uiDumpCRC;
+				aucChunk[1] = (unsigned char)(uiDumpCRC >> 8);
+				SCIWriteBlock(aucChunk, MEMDUMP_CRC_SIZE);
+				DumpState = DUMP_IDLE;
+			}
+			break;
+
+		default:
+			DumpState = DUMP_IDLE;
+			break;
+	}
+}
+
+/******************************************************************************
+ * Returns TRUE if ServiceMemoryDump can send more now. Called by IdleSleep
+ * with interrupts disabled.
+ ******************************************************************************/
+eBooleanType MemoryDumpWorkPending(void)
+{
+	unsigned int uiSpace;
+
+	if (DumpState == DUMP_IDLE)
+	{
+		return FALSE;
+	}
+
+	uiSpace = SCITxSpace();
+	switch (DumpState)
+	{
+		case DUMP_HEADER:
+			return (uiSpace >= MEMDUMP_HEADER_SIZE) ? TRUE : FALSE;
+
+		case DUMP_CRC:
+			return (uiSpace >= MEMDUMP_CRC_SIZE) ? TRUE : FALSE;
+
+		default:
+			return (uiSpace != 0) ? TRUE : FALSE;
+	}
+}
+
+/******************************************************************************
+ * Returns TRUE while a dump frame is still being queued for transmission.
+ ******************************************************************************/
+eBooleanType MemoryDumpBusy(void)
+{
+	return (DumpState != DUMP_IDLE) ? TRUE : FALSE;
+}
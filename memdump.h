@@ -0,0 +1,32 @@
+/******************************************************************************
+ * File Name:	memdump.h
+ * Program:		Project for Real-Time Embedded Systems Programming class
+ * Purpose:		Header file for memdump.c file.
+ ******************************************************************************/
+#if !defined(MEMDUMP_H)		/* Prevents including this file multiple times */
+#define MEMDUMP_H
+
+#include "lib.h"
+#include "errors.h"
+
+/*
+ * A binary dump is sent as one frame:
+ *
+ *   Byte 0-1:  Sync, MEMDUMP_SYNC1 then MEMDUMP_SYNC2
+ *        2-3:  Starting address, LSB first
+ *        4-5:  Length in bytes, LSB first
+ *        6- :  Raw memory bytes
+ *   Last 2:    CRC of bytes 2 up to the end of the memory bytes, LSB first.
+ *              XMODEM CRC (polynomial 0x1021, initial value 0), which is
+ *              binascii.crc_hqx(data, 0) on a PC.
+ */
+#define MEMDUMP_SYNC1                   0xA5
+#define MEMDUMP_SYNC2                   0x5A
+
+/* Function Prototypes */
+eErrorType StartMemoryDump(unsigned int, unsigned int);	// Address, length
+void ServiceMemoryDump(void);			// Called from foreground loop
+eBooleanType MemoryDumpWorkPending(void);	// Called from IdleSleep
+eBooleanType MemoryDumpBusy(void);
+
+#endif /* MEMDUMP_H */
@@ -0,0 +1,35 @@
+#!/bin/sh
+#
+# memusage.sh - Reports flash and RAM use for each module.
+#
+# Usage: memusage.sh [object files]
+#
+# Run it on the object files from a build, e.g. "./memusage.sh *.o". For
+# each module it lists .text (flash), .data (RAM, with a copy in flash) and
+# .bss (RAM), then the totals, and the largest RAM variables. The stack
+# comes out of whatever RAM is left.
+
+RAM_SIZE=${RAM_SIZE:-8192}	# ATmega2560
+SIZE=${SIZE:-avr-size}
+NM=${NM:-avr-nm}
+
+if [ $# -eq 0 ]; then
+	set -- *.o
+fi
+
+$SIZE --format=berkeley "$@" | awk -v ram="$RAM_SIZE" '
+	NR == 1 { printf "%-16s %8s %8s %8s %8s\n", "module", "text", "data", "bss", "ram"; next }
+	{
+		printf "%-16s %8d %8d %8d %8d\n", $6, $1, $2, $3, $2 + $3
+		text += $1; data += $2; bss += $3
+	}
+	END {
+		printf "%-16s %8d %8d %8d %8d\n", "total", text, data, bss, data + bss
+		printf "RAM used %d of %d bytes (%d%%), %d left for stack\n",
+			data + bss, ram, (data + bss) * 100 / ram, ram - data - bss
+	}'
+
+echo
+echo "Largest RAM variables:"
+$NM --size-sort --radix=d "$@" 2>/dev/null |
+	awk '$2 ~ /^[bBdD]$/ { printf "  %6d  %s\n", $1, $3 }' | sort -rn | head -15
@@ -13,303 +13,291 @@
  * 05Dec07	T Lill		Replaced "debug" prompt with "cmd"
  ******************************************************************************/
 #include "string.h"
-#include "stdlib.h"
+#include <stdint.h>
 #include "lib.h"
 #include "serial.h"
 #include "errors.h"
 #include "menu.h"
 #include "lcd.h"
+#include "display.h"
+#include "format.h"
 #include "dtoa.h"
+#include "waveform.h"
+#include "samplebuf.h"
+#include "profile.h"
+#include "config.h"
+#include "sched.h"
+#include "memdump.h"
+#include "calib.h"
+#include "bench.h"
+#include "arb.h"
+#include "power.h"
+#include "trace.h"
+#include "sequence.h"
+#include "telemetry.h"
+#include "msgs.h"
 
 #define MAX_MEM_SIZE 0x40
 #define MAX_MEM_ADDR 0x4FF
 #define MIN_MEM_ADDR 0x100
 
-// Enumeration for the menuing system
+/* One line of the rm display: newline, address, and 16 bytes */
+#define MEM_LINE_SIZE                   (10 + (16 * 3) + 1)
+
+/* Longest error log line: "  event  tick err ctx", or one count */
+#define LOG_ROW_SIZE                    24
+
+/* Longest line the displays below build, including the NULL. Each line is
+ * built in RAM and queued as one block, so it takes one transmit
+ * descriptor however many pieces it's made of. */
+#define MENU_ROW_SIZE                   80
+
+/* Transmit room needed before the next typed character is taken: enough
+ * for the longest reply a command queues in one go (a usage message and its
+ * help line, or the baud rate list), with the newline and prompt. Longer
+ * output is continued a line at a time by ContinueOutput. */
+#define MENU_REPLY_SIZE                 (2 * MENU_ROW_SIZE)
+
+/* Longest command line, including the NULL, and the most words on a line,
+ * including the command name */
+#define MENU_LINE_SIZE                  32
+#define MENU_MAX_ARGS                   5
+
+// Enumeration for the menuing system. Commands are handled in one pass,
+// except for output too long to queue at once, which is continued each
+// time RunMenu runs.
 typedef enum {
     TOP_MENU,
-    DISPLAY_HELP_MENU1,
-    DISPLAY_HELP_MENU2,
-    DISPLAY_HELP_MENU3,
-    DISPLAY_HELP_MENU4,
-    DISPLAY_HELP_MENU5,
-    DISPLAY_HELP_MENU6,
-	MEMORY_GET_ADDRESS,
-	MEMORY_GET_LENGTH,
-    GET_LCD_CHARACTER,
-    GET_LCD_POSITION,
-	WRITE_D2A,
+	DISPLAY_HELP,
+	DISPLAY_PROFILE,
+	MEMORY_DUMP,
+	CALIBRATING,
+	RUN_BENCHMARKS,
+	UPLOADING,
+	DISPLAY_ERROR_LOG,
+	SEND_ERROR_LOG,
+	DISPLAY_TRACE,
+	DISPLAY_TASKS,
+	DISPLAY_MEMORY
 } DebugMenuStateType;
 
-typedef enum {
-	READ_MEMORY,
-    WRITE_MEMORY
-} DebugMenuSubType;
+/*
+ * Command table entry. The handler gets the words of the line, with the
+ * command name in argv[0], once the number of arguments (not counting the
+ * name) has been checked against ucMinArgs and ucMaxArgs.
+ */
+typedef struct
+{
+	char Name[4];
+	void (*pfnHandler)(unsigned char ucArgc, char **argv);
+	unsigned char ucMinArgs;
+	unsigned char ucMaxArgs;
+	PGM_P Help;
+} CommandType;
+
+static void CmdHelp(unsigned char ucArgc, char **argv);
+static void CmdAmplitude(unsigned char ucArgc, char **argv);
+static void CmdAmpSteps(unsigned char ucArgc, char **argv);
+static void CmdUpload(unsigned char ucArgc, char **argv);
+static void CmdBinaryDump(unsigned char ucArgc, char **argv);
+static void CmdBaudRate(unsigned char ucArgc, char **argv);
+static void CmdBenchmark(unsigned char ucArgc, char **argv);
+static void CmdBurst(unsigned char ucArgc, char **argv);
+static void CmdChirp(unsigned char ucArgc, char **argv);
+static void CmdCalibrate(unsigned char ucArgc, char **argv);
+static void CmdClearError(unsigned char ucArgc, char **argv);
+static void CmdErrorLog(unsigned char ucArgc, char **argv);
+static void CmdFrequency(unsigned char ucArgc, char **argv);
+static void CmdGetError(unsigned char ucArgc, char **argv);
+static void CmdLCD(unsigned char ucArgc, char **argv);
+static void CmdLCDDisplay(unsigned char ucArgc, char **argv);
+static void CmdWaveMode(unsigned char ucArgc, char **argv);
+static void CmdProfileClear(unsigned char ucArgc, char **argv);
+static void CmdProfile(unsigned char ucArgc, char **argv);
+static void CmdPowerStats(unsigned char ucArgc, char **argv);
+static void CmdReadMemory(unsigned char ucArgc, char **argv);
+static void CmdSampleStats(unsigned char ucArgc, char **argv);
+static void CmdSerialFaults(unsigned char ucArgc, char **argv);
+static void CmdSequence(unsigned char ucArgc, char **argv);
+static void CmdTaskStats(unsigned char ucArgc, char **argv);
+static void CmdTelemetry(unsigned char ucArgc, char **argv);
+static void CmdTrace(unsigned char ucArgc, char **argv);
+static void CmdWaveShape(unsigned char ucArgc, char **argv);
+static void CmdWriteMemory(unsigned char ucArgc, char **argv);
+static void CmdWriteVoltage(unsigned char ucArgc, char **argv);
+
+/* Help lines, shown by "?" and when a command is used wrongly */
+static const char HelpHelp[] PROGMEM      = "  ?                   Display this help menu\n\r";
+static const char HelpAmplitude[] PROGMEM = "  am  p-p             Set amplitude (0 to 1023)\n\r";
+static const char HelpSteps[] PROGMEM     = "  as  p-p p-p n ms    n amplitude steps, ms each, at set Hz\n\r";
+static const char HelpUpload[] PROGMEM    = "  au  [mode]          Upload waveform (0=once 1=loop), binary\n\r";
+static const char HelpDump[] PROGMEM      = "  bd  addr [len]      Binary dump of RAM, hex (no len = to end)\n\r";
+static const char HelpBench[] PROGMEM     = "  bm                  Benchmark routines (turns waveform off)\n\r";
+static const char HelpBaud[] PROGMEM      = "  br  [rate]          Set baud rate, or list rates\n\r";
+static const char HelpBurst[] PROGMEM     = "  bu  n ms [bursts]   Bursts of n periods, ms apart (0=forever)\n\r";
+static const char HelpCalibrate[] PROGMEM = "  ca  [mode]          Calibrate D/A (0=full 1=self-test only)\n\r";
+static const char HelpChirp[] PROGMEM     = "  ch  Hz Hz ms [log]  Chirp from first Hz to last (0=linear 1=log)\n\r";
+static const char HelpClear[] PROGMEM     = "  ce                  Clear current error\n\r";
+static const char HelpLog[] PROGMEM       = "  el  [mode]          Error log (0=text 1=binary 2=clear)\n\r";
+static const char HelpFreq[] PROGMEM      = "  fr  Hz[.fff]        Set waveform frequency\n\r";
+static const char HelpError[] PROGMEM     = "  ge                  Display error code\n\r";
+static const char HelpLCD[] PROGMEM       = "  lcd pos [char]      Display LCD character (pos 2-7)\n\r";
+static const char HelpDisplay[] PROGMEM   = "  ld  view            LCD shows (0=D/A 1=Hz 2=p-p set 3=Hz set)\n\r";
+static const char HelpMode[] PROGMEM      = "  md  mode            Generator (0=table 1=DDS 2=stream 3=upload)\n\r";
+static const char HelpProfClear[] PROGMEM = "  pc                  Clear execution times\n\r";
+static const char HelpProfile[] PROGMEM   = "  ps                  Display execution times\n\r";
+static const char HelpPower[] PROGMEM     = "  pw                  Display, then clear, idle time and latency\n\r";
+static const char HelpRead[] PROGMEM      = "  rm  addr [len]      Read memory, hex (100-4FF, max 40)\n\r";
+static const char HelpStats[] PROGMEM     = "  rs                  Display sample buffer statistics\n\r";
+static const char HelpFaults[] PROGMEM    = "  sf                  Display serial receive fault counts\n\r";
+static const char HelpSequence[] PROGMEM  = "  sq  [script]        Run a sequence script (0-1), or stop one\n\r";
+static const char HelpTelemetry[] PROGMEM = "  tm  [ms [n]]        Telemetry: sample each ms, n per frame (none=off)\n\r";
+static const char HelpTrace[] PROGMEM     = "  tr  [module level]  Set trace level (0=off 1=err 2=info 3=debug)\n\r";
+static const char HelpTasks[] PROGMEM     = "  ts                  Display task overruns\n\r";
+static const char HelpShape[] PROGMEM     = "  wf  shape           Waveform (0=off 1=sine 2=sq 3=tri 4=saw)\n\r";
+static const char HelpWrite[] PROGMEM     = "  wm  addr value      Write memory, hex\n\r";
+static const char HelpVoltage[] PROGMEM   = "  wv  value [ch]      Write voltage to D/A (0 to 1023)\n\r";
+
+/* Command table. It must be kept sorted by name, so the commands starting
+ * with each character are together, and the index below can find them. */
+static const CommandType Commands[] PROGMEM =
+{
+	{ "?",   CmdHelp,         0, 0, HelpHelp },
+	{ "am",  CmdAmplitude,    1, 1, HelpAmplitude },
+	{ "as",  CmdAmpSteps,     4, 4, HelpSteps },
+	{ "au",  CmdUpload,       0, 1, HelpUpload },
+	{ "bd",  CmdBinaryDump,   1, 2, HelpDump },
+	{ "bm",  CmdBenchmark,    0, 0, HelpBench },
+	{ "br",  CmdBaudRate,     0, 1, HelpBaud },
+	{ "bu",  CmdBurst,        2, 3, HelpBurst },
+	{ "ca",  CmdCalibrate,    0, 1, HelpCalibrate },
+	{ "ce",  CmdClearError,   0, 0, HelpClear },
+	{ "ch",  CmdChirp,        3, 4, HelpChirp },
+	{ "el",  CmdErrorLog,     0, 1, HelpLog },
+	{ "fr",  CmdFrequency,    1, 1, HelpFreq },
+	{ "ge",  CmdGetError,     0, 0, HelpError },
+	{ "lcd", CmdLCD,          1, 2, HelpLCD },
+	{ "ld",  CmdLCDDisplay,   1, 1, HelpDisplay },
+	{ "md",  CmdWaveMode,     1, 1, HelpMode },
+	{ "pc",  CmdProfileClear, 0, 0, HelpProfClear },
+	{ "ps",  CmdProfile,      0, 0, HelpProfile },
+	{ "pw",  CmdPowerStats,   0, 0, HelpPower },
+	{ "rm",  CmdReadMemory,   1, 2, HelpRead },
+	{ "rs",  CmdSampleStats,  0, 0, HelpStats },
+	{ "sf",  CmdSerialFaults, 0, 0, HelpFaults },
+	{ "sq",  CmdSequence,     0, 1, HelpSequence },
+	{ "tm",  CmdTelemetry,    0, 2, HelpTelemetry },
+	{ "tr",  CmdTrace,        0, 2, HelpTrace },
+	{ "ts",  CmdTaskStats,    0, 0, HelpTasks },
+	{ "wf",  CmdWaveShape,    1, 1, HelpShape },
+	{ "wm",  CmdWriteMemory,  2, 2, HelpWrite },
+	{ "wv",  CmdWriteVoltage, 1, 2, HelpVoltage },
+};
+
+#define NUM_COMMANDS	(sizeof(Commands) / sizeof(Commands[0]))
+
+/*
+ * First-character index into Commands. Each lower-case letter has its own
+ * bucket; anything before 'a' (such as '?') shares bucket 0, and anything
+ * after 'z' the last. aucCommandStart[b] is the first row in bucket b or
+ * later, so bucket b's rows run up to aucCommandStart[b + 1]. Built from
+ * the table the first time a line is run, so it can't get out of step.
+ */
+#define COMMAND_BUCKETS                 28
+#define COMMAND_BUCKET(c)				(((c) < 'a') ? 0 : \
+										 ((c) > 'z') ? (COMMAND_BUCKETS - 1) : \
+										 ((c) - 'a' + 1))
+
+static unsigned char aucCommandStart[COMMAND_BUCKETS + 1];
+static eBooleanType bCommandIndexBuilt = FALSE;
+
+/* Names for the profile display, in eProfileIdType order */
+static const char ProfileName0[] PROGMEM = "  timer0    ";
+static const char ProfileName1[] PROGMEM = "  usart0 rx ";
+static const char ProfileName2[] PROGMEM = "  usart0 tx ";
+static const char ProfileName3[] PROGMEM = "  timer1    ";
+static const char ProfileName4[] PROGMEM = "  spi       ";
+static const char ProfileName5[] PROGMEM = "  adc       ";
+static const char ProfileName6[] PROGMEM = "  heartbeat ";
+static const char ProfileName7[] PROGMEM = "  menu      ";
+static const char ProfileName8[] PROGMEM = "  display   ";
+static PGM_P const ProfileNames[PROFILE_NUM_IDS] PROGMEM =
+{
+	ProfileName0, ProfileName1, ProfileName2, ProfileName3,
+	ProfileName4, ProfileName5, ProfileName6, ProfileName7,
+	ProfileName8
+};
+
+static void BuildCommandIndex(void);
+static void ProcessLine(char *Line);
+static void ContinueOutput(void);
+static eBooleanType ReadNumber(const char *Str, unsigned char Radix,
+							   unsigned int *ptrValue);
+static void DisplayProfileRow(eProfileIdType Id);
+static void DisplayTaskRow(unsigned char ucTask);
+static void DisplayCalResult(void);
+static void DisplayBenchmark(unsigned char ucIndex);
+static void DisplayDtoARate(void);
+static void DisplayArbStatus(void);
+static void DisplayErrorEvent(unsigned int uiEvent);
+static void DisplayTraceRow(unsigned char ucModule);
+static void DisplayMemoryRow(void);
+static void DisplayErrorCount(eErrorType Error);
 
 
 /******************************************************************************
- * Processes keypresses received via RS-232. Implements a menuing system.
+ * Processes keypresses received via RS-232. Characters are collected into a
+ * line, and the whole line is run as one command when Enter is received,
+ * e.g. "rm 100 40".
  ******************************************************************************/
-static char zInputStr[MAX_IN_STR_SIZE];
+static char zInputStr[MENU_LINE_SIZE];
 static char *ptrInputStr = zInputStr;
 static DebugMenuStateType MenuState = TOP_MENU;
+static unsigned char ucHelpRow = 0;
+static unsigned char ucProfileRow = 0;
+static unsigned char ucBenchRow = 0;
+static unsigned int uiLogEvent = 0;
+static unsigned int uiLogEnd = 0;
+static unsigned char ucLogType = 0;
+static unsigned char ucTraceRow = 0;
+static unsigned char ucTaskRow = 0;
+static unsigned int uiMemAddress = 0;
+static unsigned int uiMemLeft = 0;
 
 void RunMenu(void)
 {
-    char cTempChar = 1;     // Set to any value other than 0
-    char zOutputStr[MAX_MEM_SIZE + 3];  // Add space for newline, return and NULL
-    char *ptrOutputStr;
-    eErrorType error = NO_ERROR;
-    static DebugMenuSubType MenuAction = READ_MEMORY;
-	static unsigned int i, Address = 0, Length = 0, Value = 0;
-	static char LCDChar, LCDPosition;
-	static unsigned int Voltage = 0;
-
-    // Read input characters until input buffer is empty
-    while ((cTempChar = SCIReadChar()) != 0)
+    char cTempChar;
+
+	if (MenuState != TOP_MENU)
+	{	// Finish the last command's output first. Typed characters are left
+		// in the receive buffer until then, so they aren't mixed into it.
+		ContinueOutput();
+	}
+
+    // Read input characters until input buffer is empty, or a command's
+    // output has to be finished first. Characters are only taken while
+    // there's room for a reply, so something else filling the transmit
+    // queue, such as telemetry, holds up typing rather than losing output.
+    while ((MenuState == TOP_MENU) && (SCITxSpace() >= MENU_REPLY_SIZE) &&
+           ((cTempChar = SCIReadChar()) != 0))
     {   // Have another character from input buffer
         if (cTempChar == '\r')
         {   // Enter character. Process input
             *ptrInputStr = '\0';        // append Null
             ptrInputStr = zInputStr;    // Reset input string
-            SCIWriteString_P(PSTR("\n\r"));     // Move cursor to next line
+            SCIWriteMsg(MSG_NEWLINE);     // Move cursor to next line
 
-            // Process entry based on debug menu state
-            switch(MenuState)
-            {
-                case TOP_MENU:
-                    if (strcmp(zInputStr, "?") == 0)
-                    {   // Help screen
-						MenuState = DISPLAY_HELP_MENU1;
-                    }
-
-                    else if (strcmp(zInputStr, "ge") == 0)
-                    {   // Display desired signal parameters
-                        // Retrieve signal parameters
-                        error = GetError();
-                        SCIWriteString_P(PSTR("  Error = "));
-                        ptrOutputStr = zOutputStr;
-                        _itoa(&ptrOutputStr, error, 10);
-                        SCIWriteString(zOutputStr);
-                        SCIWriteString_P(PSTR("\n\r"));
-                    }
-
-                    else if (strcmp(zInputStr, "ce") == 0)
-                    {
-                        ClearError();
-                    }
-
-					else if ((strcmp(zInputStr, "rm") == 0) ||
-                             (strcmp(zInputStr, "wm") == 0))
-                    {   // Memory menu
-                        if (strcmp(zInputStr, "rm") == 0)
-                        {
-                            MenuAction = READ_MEMORY;
-                        }
-                        else
-                        {
-                            MenuAction = WRITE_MEMORY;
-                        }
-
-                        // Get address
-                        SCIWriteString("  Starting address in hex (100 to 4FF) = ");
-                        MenuState = MEMORY_GET_ADDRESS;
-                    }
-
-					else if (strcmp(zInputStr, "lcd") == 0)
-                    {
-                        SCIWriteString_P(PSTR("  Enter character to display (0-9 or a space): "));
-                        MenuState = GET_LCD_CHARACTER;
-                    }
-
-                    else if (strcmp(zInputStr, "wv") == 0)
-                    {   // Change desired signal parameters
-                        SCIWriteString("  Enter desired voltage (0 to 1023): ");
-                        MenuState = WRITE_D2A;
-                    }
-
-				   else
-                    {   // No entry
-                        // Back to top menu
-                        MenuState = TOP_MENU;
-                    }
-                    break;
-
-				case MEMORY_GET_ADDRESS:
-                    if (zInputStr[0] != '\0')
-                    {   // Just skip NULL entries
-                        Address = _atoi(zInputStr, 16);
-						
-						if ((Address < MIN_MEM_ADDR) ||
-						    (Address > MAX_MEM_ADDR))
-						{	// Address out of range
-							SCIWriteString_P(PSTR("  Address out of range\n\r"));
-						}
-						else
-						{
-							if (MenuAction == READ_MEMORY)
-							{
-								// Now get length
-								SCIWriteString_P(PSTR("  Length in hex (max 40) = "));
-							}
-							else
-							{
-								SCIWriteString_P(PSTR("  Value (in hex) = "));
-							}
-							MenuState = MEMORY_GET_LENGTH;
-						}
-					}
-					else
-					{   // No entry
-						// Back to top menu
-						MenuState = TOP_MENU;
-					}
-                    break;
-
-               case MEMORY_GET_LENGTH:
-                    if (zInputStr[0] != '\0')
-                    {
-                        if (MenuAction == READ_MEMORY)
-                        {
-                            Length = _atoi(zInputStr, 16);
-							
-							// Limit memory to available RAM
-							if ((Address + Length - 1) > MAX_MEM_ADDR)
-							{
-								Length = MAX_MEM_ADDR - Address + 1;
-							}
-							
-                            if (Length == 0)
-                            {   // default to 1
-                                Length = 1;
-                            }
-
-                            if (Length > MAX_MEM_SIZE)
-                            {
-                                Length = MAX_MEM_SIZE;
-                            }
-
-                            SCIWriteString_P(PSTR("  Memory ="));
-
-                            for (i = 0; i < Length; ++i)
-                            {
-                                if ((i % 16) == 0)
-                                {
-                                    SCIWriteString_P(PSTR("\n\r  "));
-
-                                    // Display address
-                                    ptrOutputStr = zOutputStr;
-                                    _itoa(&ptrOutputStr, Address, 16);
-                                    SCIWriteString(zOutputStr);
-                                    SCIWriteString(">  ");
-                                }
-
-                                ptrOutputStr = zOutputStr;
-                                *ptrOutputStr = *(unsigned char *)Address;
-                                ++Address;
-
-                                // Convert character to an ASCII string in Hex
-                                _itoa(&ptrOutputStr, (int)zOutputStr[0], 16);
-
-                                // Force to be 2 characters long
-                                if (strlen(zOutputStr) < 2)
-                                {
-                                    zOutputStr[1] = zOutputStr[0];
-                                    zOutputStr[0]= '0';
-                                }
-                                zOutputStr[2] = ' ';
-                                zOutputStr[3] = '\0';
-                                SCIWriteString(zOutputStr);
-                            }
-
-                            SCIWriteString_P(PSTR("\n\r"));
-                        }
-                        else
-                        {   // Write memory
-                            Value = _atoi(zInputStr, 16);
-
-                            if (Value > 0xFF)
-                            {   // invalid value
-                                SCIWriteString_P(PSTR("Invalid value\n\r"));
-                                MenuState = TOP_MENU;
-                            }
-                            else
-                            {
-                                SCIWriteString_P(PSTR("Write Mem\n\r"));
-                                ptrOutputStr = (char *)Address;
-                                *ptrOutputStr = (char)Value;
-
-                                SCIWriteString_P(PSTR("\n\r"));
-                            }
-                        }
-
-                        // Back to top menu
-                        MenuState = TOP_MENU;
-                    }
-					
-                    break;
-
-                case GET_LCD_CHARACTER:
-                    if (zInputStr[0] != '\0')
-                    {   // Just skip NULL entries
-                        LCDChar = zInputStr[0];
-
-                        // Now get position
-                        SCIWriteString_P(PSTR("\n\r  Enter LCD Position(2-7): "));
-                        MenuState = GET_LCD_POSITION;
-                    }
-                    else
-                    {   // No entry
-                        // Back to top menu
-                        MenuState = TOP_MENU;
-                    }
-                    break;
-
-                case GET_LCD_POSITION:
-                    if (zInputStr[0] != '\0')
-                    {   // Just skip NULL entries
-                        LCDPosition = _atoi(zInputStr, 10);
-                        MenuState = TOP_MENU;
-                    }
-                    else
-                    {   // No entry
-                        // Back to top menu
-                        MenuState = TOP_MENU;
-                    }
-                    break;
-
-                case WRITE_D2A:
-                    if (zInputStr[0] != '\0')
-                    {   // Just skip NULL entries
-                        Voltage = _atoi(zInputStr, 10);
-
-						if ((Voltage >= 0) && (Voltage <= 1023))
-						{	// Valid voltage. Write to D/A
-							WriteDtoASample(Voltage);
-						}
-                    }
-                    // Back to top menu
-                    MenuState = TOP_MENU;
-                    break;
-
-				default:
-                    // Erroneus state. Reset to none
-                    MenuState = TOP_MENU;
-                    break;
-            }   // end switch
-
-            // Reset string pointer. May have been moved during command processing
-            ptrInputStr = zInputStr;
+            ProcessLine(zInputStr);
 
             if (MenuState == TOP_MENU)
             {
                 // Display prompt
-                SCIWriteString_P(PSTR("cmd> "));
-            }
+                SCIWriteMsg(MSG_PROMPT);
+            }   // else, rest of the input waits for the output to finish
         }
         else
         {   // Save new character to input buffer
-            if (ptrInputStr < &zInputStr[MAX_IN_STR_SIZE-2])
+            if (ptrInputStr < &zInputStr[MENU_LINE_SIZE-2])
             {   // Buffer is not full
                 *ptrInputStr = cTempChar;
                 *(ptrInputStr+1) = '\0';    // Keep null in string
@@ -321,43 +309,1197 @@ void RunMenu(void)
             }   // else, buffer is full. Ignore characters.
         }
     }   // End while. All characters processed
+}
+
+/******************************************************************************
+ * Runs one command line as if it had been typed. Used by the benchmarks.
+ ******************************************************************************/
+void RunMenuLine(const char *Line)
+{
+	char zLine[MENU_LINE_SIZE];
+
+	// The words are split in place, so work on a copy
+	strncpy(zLine, Line, sizeof(zLine) - 1);
+	zLine[sizeof(zLine) - 1] = '\0';
+	ProcessLine(zLine);
+}
+
+/******************************************************************************
+ * Fills in aucCommandStart from the sorted command table.
+ ******************************************************************************/
+static void BuildCommandIndex(void)
+{
+	unsigned char ucRow = 0;
+	unsigned char ucBucket;
+	char cFirst;
+
+	for (ucBucket = 0; ucBucket <= COMMAND_BUCKETS; ++ucBucket)
+	{
+		while (ucRow < NUM_COMMANDS)
+		{
+			cFirst = pgm_read_byte(&Commands[ucRow].Name[0]);
+			if (COMMAND_BUCKET(cFirst) >= ucBucket)
+			{
+				break;
+			}
+			++ucRow;
+		}
+		aucCommandStart[ucBucket] = ucRow;
+	}
+	bCommandIndexBuilt = TRUE;
+}
+
+/******************************************************************************
+ * Splits a command line into words, separated by spaces, and runs the
+ * command named by the first word.
+ ******************************************************************************/
+static void ProcessLine(char *Line)
+{
+	char *argv[MENU_MAX_ARGS];
+	unsigned char ucArgc = 0;
+	unsigned char i, ucEnd;
+	char cFirst;
+	const CommandType *ptrCommand = 0;
+
+	/* Split the line in place. Words past MENU_MAX_ARGS are counted, so
+	 * the argument check below rejects the line. */
+	while (*Line != '\0')
+	{
+		if (*Line == ' ')
+		{
+			++Line;
+			continue;
+		}
+
+		if (ucArgc < MENU_MAX_ARGS)
+		{
+			argv[ucArgc] = Line;
+		}
+		++ucArgc;
+
+		while ((*Line != ' ') && (*Line != '\0'))
+		{
+			++Line;
+		}
+		if (*Line == ' ')
+		{
+			*Line++ = '\0';
+		}
+	}
+
+	if (ucArgc == 0)
+	{   // Empty line. Just show the prompt again.
+		return;
+	}
+
+	/* Find the command. Only the few rows in its first character's bucket
+	 * are compared, rather than up to the whole table. */
+	if (bCommandIndexBuilt == FALSE)
+	{
+		BuildCommandIndex();
+	}
+	cFirst = argv[0][0];
+	i = aucCommandStart[COMMAND_BUCKET(cFirst)];
+	ucEnd = aucCommandStart[COMMAND_BUCKET(cFirst) + 1];
+	for (; i < ucEnd; ++i)
+	{
+		if (strcmp_P(argv[0], Commands[i].Name) == 0)
+		{
+			ptrCommand = &Commands[i];
+			break;
+		}
+	}
 
-	if (MenuState == DISPLAY_HELP_MENU1)
-	{	// Display 1st part of help menu
-		SCIWriteString_P(PSTR("  Commands are:\n\r"));
-		SCIWriteString_P(PSTR("  ge  - Display error code\n\r"));
-		MenuState = DISPLAY_HELP_MENU2;
+	if (ptrCommand == 0)
+	{
+		SCIWriteMsg(MSG_UNKNOWN_COMMAND);
 	}
-	
-	else if (MenuState == DISPLAY_HELP_MENU2)
-	{	// Display 2nd part of help menu
-		SCIWriteString_P(PSTR("  ce  - Clear current error\n\r"));
-		SCIWriteString_P(PSTR("  lcd - Display LCD character\n\r"));
-		MenuState = DISPLAY_HELP_MENU3;
+	else if (((ucArgc - 1) < pgm_read_byte(&ptrCommand->ucMinArgs)) ||
+			 ((ucArgc - 1) > pgm_read_byte(&ptrCommand->ucMaxArgs)))
+	{
+		SCIWriteMsg(MSG_USAGE);
+		SCIWriteString_P((PGM_P)pgm_read_word(&ptrCommand->Help));
 	}
-	
-	else if (MenuState == DISPLAY_HELP_MENU3)
-	{	// Display 3rd part of help menu
-		SCIWriteString_P(PSTR("  wv  - Write voltage to D/A\n\r"));
-		MenuState = DISPLAY_HELP_MENU4;
+	else
+	{
+		((void (*)(unsigned char, char **))pgm_read_word(&ptrCommand->pfnHandler))
+			(ucArgc, argv);
 	}
+}
+
+/******************************************************************************
+ * Continues output that didn't fit in the transmit queue in one go. Shows
+ * the prompt once it's done.
+ ******************************************************************************/
+static void ContinueOutput(void)
+{
+	switch (MenuState)
+	{
+		case DISPLAY_HELP:
+			// Each help line takes one transmit descriptor. Queue lines
+			// while there's room, and the rest next time.
+			while ((ucHelpRow < NUM_COMMANDS) && (SCITxSpace() != 0))
+			{
+				SCIWriteString_P((PGM_P)pgm_read_word(&Commands[ucHelpRow].Help));
+				++ucHelpRow;
+			}
+			if (ucHelpRow >= NUM_COMMANDS)
+			{
+				SCIWriteMsg(MSG_PROMPT);
+				MenuState = TOP_MENU;
+			}
+			break;
+
+		case DISPLAY_PROFILE:
+			// Execution times, a row at a time, while there's room
+			while ((ucProfileRow < PROFILE_NUM_IDS) && (SCITxSpace() >= MENU_ROW_SIZE))
+			{
+				DisplayProfileRow((eProfileIdType)ucProfileRow++);
+			}
+			if (ucProfileRow >= PROFILE_NUM_IDS)
+			{
+				SCIWriteMsg(MSG_PROMPT);
+				MenuState = TOP_MENU;
+			}
+			break;
+
+		case RUN_BENCHMARKS:
+			// One benchmark per run, so interrupts are never off for long
+			DisplayBenchmark(ucBenchRow);
+
+			if (++ucBenchRow >= GetNumBenchmarks())
+			{
+				DisplayDtoARate();
+				SCIWriteMsg(MSG_PROMPT);
+				MenuState = TOP_MENU;
+			}
+			break;
+
+		case DISPLAY_ERROR_LOG:
+			// Queue a line at a time, while there's room: the events, then
+			// the counts
+			while ((uiLogEvent != uiLogEnd) && (SCITxSpace() >= LOG_ROW_SIZE))
+			{
+				DisplayErrorEvent(uiLogEvent++);
+			}
+			if (uiLogEvent != uiLogEnd)
+			{
+				break;
+			}
+
+			while ((ucLogType < NUM_ERROR_TYPES) && (SCITxSpace() >= LOG_ROW_SIZE))
+			{
+				if (ucLogType == 0)
+				{
+					SCIWriteMsg(MSG_LOG_COUNTS);
+				}
+				DisplayErrorCount((eErrorType)ucLogType++);
+			}
+			if (ucLogType >= NUM_ERROR_TYPES)
+			{
+				SCIWriteMsg(MSG_NEWLINE);
+				SCIWriteMsg(MSG_PROMPT);
+				MenuState = TOP_MENU;
+			}
+			break;
+
+		case SEND_ERROR_LOG:
+			// Wait until the whole frame fits, then queue it at once
+			if (SCITxSpace() >= ERROR_LOG_FRAME_SIZE)
+			{
+				unsigned char aucFrame[ERROR_LOG_FRAME_SIZE];
+
+				SCIWriteBlock(aucFrame, BuildErrorLogFrame(aucFrame));
+				SCIWriteMsg(MSG_NEWLINE);
+				SCIWriteMsg(MSG_PROMPT);
+				MenuState = TOP_MENU;
+			}
+			break;
+
+		case DISPLAY_TRACE:
+			// A module per line, while there's room, then the drop count
+			while ((ucTraceRow <= TRACE_NUM_MODULES) && (SCITxSpace() >= MENU_ROW_SIZE))
+			{
+				DisplayTraceRow(ucTraceRow++);
+			}
+			if (ucTraceRow > TRACE_NUM_MODULES)
+			{
+				SCIWriteMsg(MSG_PROMPT);
+				MenuState = TOP_MENU;
+			}
+			break;
+
+		case DISPLAY_TASKS:
+			// A task per line, while there's room. The counts are cleared
+			// once they've all been displayed.
+			while ((ucTaskRow < GetNumTasks()) && (SCITxSpace() >= MENU_ROW_SIZE))
+			{
+				DisplayTaskRow(ucTaskRow++);
+			}
+			if (ucTaskRow >= GetNumTasks())
+			{
+				ClearTaskStats();
+				SCIWriteMsg(MSG_PROMPT);
+				MenuState = TOP_MENU;
+			}
+			break;
+
+		case DISPLAY_MEMORY:
+			// 16 bytes per line, while there's room
+			while ((uiMemLeft != 0) && (SCITxSpace() >= MEM_LINE_SIZE))
+			{
+				DisplayMemoryRow();
+			}
+			if (uiMemLeft == 0)
+			{
+				SCIWriteMsg(MSG_NEWLINE);
+				SCIWriteMsg(MSG_PROMPT);
+				MenuState = TOP_MENU;
+			}
+			break;
+
+		case UPLOADING:
+			// Frames are taken in by the RX ISR, and answered from the
+			// foreground loop
+			if (ArbUploadBusy() == FALSE)
+			{
+				DisplayArbStatus();
+				SCIWriteMsg(MSG_PROMPT);
+				MenuState = TOP_MENU;
+			}
+			break;
+
+		case CALIBRATING:
+			// Sweep is run from the foreground loop
+			if (CalibrationBusy() == FALSE)
+			{
+				DisplayCalResult();
+				SCIWriteMsg(MSG_PROMPT);
+				MenuState = TOP_MENU;
+			}
+			break;
+
+		case MEMORY_DUMP:
+			// Binary frame is sent from the foreground loop
+			if (MemoryDumpBusy() == FALSE)
+			{
+				SCIWriteMsg(MSG_NEWLINE);
+				SCIWriteMsg(MSG_PROMPT);
+				MenuState = TOP_MENU;
+			}
+			break;
 
-	else if (MenuState == DISPLAY_HELP_MENU4)
-	{	// Display 4th part of help menu
-		MenuState = DISPLAY_HELP_MENU5;
+		default:
+			MenuState = TOP_MENU;
+			break;
 	}
+}
+
+/******************************************************************************
+ * Command handlers. Each is called with the words of the command line.
+ ******************************************************************************/
+static void CmdHelp(unsigned char ucArgc, char **argv)
+{
+	SCIWriteMsg(MSG_COMMANDS_ARE);
+	ucHelpRow = 0;
+	MenuState = DISPLAY_HELP;
+}
+
+static void CmdGetError(unsigned char ucArgc, char **argv)
+{
+	char zOutputStr[MENU_ROW_SIZE];
+	char *ptrOut;
+
+	ptrOut = FormatString_P(zOutputStr, GetMsg(MSG_ERROR_EQUALS));
+	ptrOut = FormatDec(ptrOut, GetError(), 0);
+	FormatString_P(ptrOut, GetMsg(MSG_NEWLINE));
+	SCIWriteString(zOutputStr);
+}
+
+static void CmdBenchmark(unsigned char ucArgc, char **argv)
+{
+	StartBenchmarks();
+	SCIWriteMsg(MSG_BENCH_HEADING);
+	ucBenchRow = 0;
+	MenuState = RUN_BENCHMARKS;
+}
+
+static void CmdCalibrate(unsigned char ucArgc, char **argv)
+{
+	unsigned int Mode = CAL_FULL;
 
-	else if (MenuState == DISPLAY_HELP_MENU5)
-	{	// Display 5th part of help menu
-		SCIWriteString_P(PSTR("  rm  - Read memory\n\r"));
-		SCIWriteString_P(PSTR("  wm  - Write memory\r"));
-		MenuState = DISPLAY_HELP_MENU6;
+	if ((ucArgc > 1) && (ReadNumber(argv[1], 10, &Mode) == FALSE))
+	{   // Message already displayed
+		return;
 	}
 
-	else if (MenuState == DISPLAY_HELP_MENU6)
-	{	// Display 6th part of help menu
-		SCIWriteString_P(PSTR("  ?   - Display this help menu\n\r"));
-		MenuState = TOP_MENU;
+	if (StartCalibration((eCalModeType)Mode) != NO_ERROR)
+	{
+		SCIWriteMsg(MSG_INVALID_VALUE);
+	}
+	else
+	{   // Result is shown when it's done
+		MenuState = CALIBRATING;
 	}
 }
 
+static void CmdUpload(unsigned char ucArgc, char **argv)
+{
+	unsigned int Mode = ARB_ONCE;
+
+	if ((ucArgc > 1) && (ReadNumber(argv[1], 10, &Mode) == FALSE))
+	{   // Message already displayed
+		return;
+	}
+
+	if (StartArbUpload((eArbModeType)Mode) != NO_ERROR)
+	{
+		SCIWriteMsg(MSG_INVALID_MODE);
+	}
+	else
+	{   // Everything received is frames until the upload ends
+		MenuState = UPLOADING;
+	}
+}
+
+static void CmdClearError(unsigned char ucArgc, char **argv)
+{
+	ClearError();
+}
+
+/* Mode 0 lists the error log and counts, 1 sends them as one binary frame
+ * (see errors.h), and 2 clears them */
+static void CmdErrorLog(unsigned char ucArgc, char **argv)
+{
+	unsigned int Mode = 0;
+	unsigned char ucCount;
+
+	if ((ucArgc > 1) && (ReadNumber(argv[1], 10, &Mode) == FALSE))
+	{   // Message already displayed
+		return;
+	}
+
+	switch (Mode)
+	{
+		case 0:
+			// Only events logged so far are listed, even if more arrive
+			uiLogEvent = GetErrorLogStart(&ucCount);
+			uiLogEnd = uiLogEvent + ucCount;
+			ucLogType = 0;
+			SCIWriteMsg(MSG_LOG_HEADING);
+			MenuState = DISPLAY_ERROR_LOG;
+			break;
+
+		case 1:
+			MenuState = SEND_ERROR_LOG;
+			break;
+
+		case 2:
+			ClearErrorLog();
+			break;
+
+		default:
+			SCIWriteMsg(MSG_INVALID_MODE);
+			break;
+	}
+}
+
+/* Lines of 16 bytes are queued as there's room */
+static void CmdReadMemory(unsigned char ucArgc, char **argv)
+{
+	unsigned int Address, Length = 1;
+
+	if ((ReadNumber(argv[1], 16, &Address) == FALSE) ||
+		((ucArgc > 2) && (ReadNumber(argv[2], 16, &Length) == FALSE)))
+	{   // Message already displayed
+		return;
+	}
+
+	if ((Address < MIN_MEM_ADDR) || (Address > MAX_MEM_ADDR))
+	{
+		SCIWriteMsg(MSG_ADDRESS_RANGE);
+		return;
+	}
+
+	// Limit memory to available RAM
+	if ((Address + Length - 1) > MAX_MEM_ADDR)
+	{
+		Length = MAX_MEM_ADDR - Address + 1;
+	}
+
+	if (Length == 0)
+	{   // default to 1
+		Length = 1;
+	}
+
+	if (Length > MAX_MEM_SIZE)
+	{
+		Length = MAX_MEM_SIZE;
+	}
+
+	SCIWriteMsg(MSG_MEMORY_EQUALS);
+	uiMemAddress = Address;
+	uiMemLeft = Length;
+	MenuState = DISPLAY_MEMORY;
+}
+
+static void CmdWriteMemory(unsigned char ucArgc, char **argv)
+{
+	unsigned int Address, Value;
+
+	if ((ReadNumber(argv[1], 16, &Address) == FALSE) ||
+		(ReadNumber(argv[2], 16, &Value) == FALSE))
+	{   // Message already displayed
+	}
+	else if ((Address < MIN_MEM_ADDR) || (Address > MAX_MEM_ADDR))
+	{
+		SCIWriteMsg(MSG_ADDRESS_RANGE);
+	}
+	else if (Value > 0xFF)
+	{   // invalid value
+		SCIWriteMsg(MSG_INVALID_VALUE);
+	}
+	else
+	{
+		*(unsigned char *)(uintptr_t)Address = (unsigned char)Value;
+	}
+}
+
+static void CmdBinaryDump(unsigned char ucArgc, char **argv)
+{
+	unsigned int Address, Length = 0;
+
+	if ((ReadNumber(argv[1], 16, &Address) == FALSE) ||
+		((ucArgc > 2) && (ReadNumber(argv[2], 16, &Length) == FALSE)))
+	{   // Message already displayed
+		return;
+	}
+
+	if ((Length == 0) && (Address <= RAMEND))
+	{   // Dump to the end of RAM
+		Length = RAMEND - Address + 1;
+	}
+
+	// Any RAM address is allowed. The range is checked when the dump starts.
+	if (StartMemoryDump(Address, Length) != NO_ERROR)
+	{
+		SCIWriteMsg(MSG_ADDRESS_RANGE);
+	}
+	else
+	{   // Frame is sent from the foreground loop
+		MenuState = MEMORY_DUMP;
+	}
+}
+
+static void CmdLCD(unsigned char ucArgc, char **argv)
+{
+	unsigned int Position;
+
+	if (ReadNumber(argv[1], 10, &Position) == TRUE)
+	{   // A space can't be typed as a word, so no character means blank
+		LCDWrite((ucArgc > 2) ? argv[2][0] : ' ', (unsigned char)Position);
+	}
+}
+
+static void CmdLCDDisplay(unsigned char ucArgc, char **argv)
+{
+	unsigned int Value;
+
+	if ((ReadNumber(argv[1], 10, &Value) == TRUE) &&
+		(SetDisplayValue((LCDValueType)Value) != NO_ERROR))
+	{
+		SCIWriteMsg(MSG_INVALID_VALUE);
+	}
+}
+
+static void CmdWriteVoltage(unsigned char ucArgc, char **argv)
+{
+	unsigned int Voltage;
+	unsigned int Channel = 0;
+
+	if ((ucArgc > 2) && (ReadNumber(argv[2], 10, &Channel) == FALSE))
+	{   // Message already displayed
+		return;
+	}
+	if (Channel >= DTOA_NUM_CHANNELS)
+	{
+		SCIWriteMsg(MSG_INVALID_VALUE);
+		return;
+	}
+
+	if ((ReadNumber(argv[1], 10, &Voltage) == TRUE) && (Voltage <= DTOA_MAX_CODE))
+	{	// Valid voltage. Queue it for the D/A, so we don't wait in this
+		// task for the SPI transfer.
+		WriteDtoAChannelAsync((unsigned char)Channel, Voltage);
+	}
+}
+
+static void CmdWaveShape(unsigned char ucArgc, char **argv)
+{
+	unsigned int Value;
+
+	if ((ReadNumber(argv[1], 10, &Value) == TRUE) &&
+		(SetWaveShape((eWaveShapeType)Value) != NO_ERROR))
+	{
+		SCIWriteMsg(MSG_INVALID_WAVEFORM);
+	}
+}
+
+static void CmdWaveMode(unsigned char ucArgc, char **argv)
+{
+	unsigned int Value;
+
+	if ((ReadNumber(argv[1], 10, &Value) == TRUE) &&
+		(SetWaveMode((eWaveModeType)Value) != NO_ERROR))
+	{
+		SCIWriteMsg(MSG_INVALID_MODE);
+	}
+}
+
+/* Frequency is in Hz, with up to 3 decimal places, e.g. "50" or "0.5".
+ * It's passed on in mHz. */
+static void CmdFrequency(unsigned char ucArgc, char **argv)
+{
+	char *ptrFraction;
+	unsigned long ulFrequency;
+	unsigned int uiScale = WAVE_FREQ_SCALE;
+	unsigned char ucDigits = 0;
+
+	ptrFraction = strchr(argv[1], '.');
+	if (ptrFraction != 0)
+	{
+		*ptrFraction++ = '\0';
+	}
+
+	if (ParseUnsigned32(argv[1], 10, &ulFrequency) != NO_ERROR)
+	{
+		SCIWriteMsg(MSG_INVALID_NUMBER);
+		return;
+	}
+
+	if (ulFrequency > (0xFFFFFFFFUL / WAVE_FREQ_SCALE))
+	{
+		SCIWriteMsg(MSG_FREQUENCY_RANGE);
+		return;
+	}
+	ulFrequency *= WAVE_FREQ_SCALE;
+
+	if (ptrFraction != 0)
+	{
+		while ((*ptrFraction >= '0') && (*ptrFraction <= '9') && (ucDigits < 3))
+		{
+			uiScale /= 10;
+			ulFrequency += (*ptrFraction - '0') * uiScale;
+			++ptrFraction;
+			++ucDigits;
+		}
+		if (*ptrFraction != '\0')
+		{
+			SCIWriteMsg(MSG_INVALID_NUMBER);
+			return;
+		}
+	}
+
+	if (SetWaveFrequencyFine(ulFrequency) != NO_ERROR)
+	{
+		SCIWriteMsg(MSG_FREQUENCY_RANGE);
+	}
+}
+
+static void CmdAmplitude(unsigned char ucArgc, char **argv)
+{
+	unsigned int Value;
+
+	if ((ReadNumber(argv[1], 10, &Value) == TRUE) &&
+		(SetWaveAmplitude(Value) != NO_ERROR))
+	{
+		SCIWriteMsg(MSG_AMPLITUDE_RANGE);
+	}
+}
+
+/*
+ * Sequences. Each plays in DDS mode, then goes back to the settings. The
+ * amplitude steps and bursts use the set frequency, and the chirps and
+ * bursts the set amplitude.
+ */
+static void CmdAmpSteps(unsigned char ucArgc, char **argv)
+{
+	SeqSegmentType Segment;
+	WaveStatusType Status;
+	unsigned int First, Last, Steps, Duration;
+
+	if ((ReadNumber(argv[1], 10, &First) == FALSE) ||
+		(ReadNumber(argv[2], 10, &Last) == FALSE) ||
+		(ReadNumber(argv[3], 10, &Steps) == FALSE) ||
+		(ReadNumber(argv[4], 10, &Duration) == FALSE))
+	{   // Message already displayed
+		return;
+	}
+
+	GetWaveStatus(&Status);
+	Segment.ucType = SEQ_AMPLITUDE_STEPS;
+	Segment.ucRepeat = 1;
+	Segment.uiDuration = Duration;
+	Segment.uiCount = Steps;
+	Segment.uiAmplitude = First;
+	Segment.uiEndAmplitude = Last;
+	Segment.ulFrequency = Status.ulFrequency;
+	Segment.ulEndFrequency = 0;
+	if (StartSequence(&Segment) != NO_ERROR)
+	{
+		SCIWriteMsg(MSG_INVALID_VALUE);
+	}
+}
+
+static void CmdBurst(unsigned char ucArgc, char **argv)
+{
+	SeqSegmentType Segment;
+	WaveStatusType Status;
+	unsigned int Cycles, Gap, Bursts = 0;
+
+	if ((ReadNumber(argv[1], 10, &Cycles) == FALSE) ||
+		(ReadNumber(argv[2], 10, &Gap) == FALSE) ||
+		((ucArgc > 3) && (ReadNumber(argv[3], 10, &Bursts) == FALSE)))
+	{   // Message already displayed
+		return;
+	}
+	if (Bursts > 0xFF)
+	{
+		SCIWriteMsg(MSG_INVALID_VALUE);
+		return;
+	}
+
+	GetWaveStatus(&Status);
+	Segment.ucType = SEQ_BURST;
+	Segment.ucRepeat = (unsigned char)Bursts;
+	Segment.uiDuration = Gap;
+	Segment.uiCount = Cycles;
+	Segment.uiAmplitude = Status.uiAmplitude;
+	Segment.uiEndAmplitude = 0;
+	Segment.ulFrequency = Status.ulFrequency;
+	Segment.ulEndFrequency = 0;
+	if (StartSequence(&Segment) != NO_ERROR)
+	{
+		SCIWriteMsg(MSG_INVALID_VALUE);
+	}
+}
+
+static void CmdChirp(unsigned char ucArgc, char **argv)
+{
+	SeqSegmentType Segment;
+	WaveStatusType Status;
+	unsigned int First, Last, Duration, Log = 0;
+
+	if ((ReadNumber(argv[1], 10, &First) == FALSE) ||
+		(ReadNumber(argv[2], 10, &Last) == FALSE) ||
+		(ReadNumber(argv[3], 10, &Duration) == FALSE) ||
+		((ucArgc > 4) && (ReadNumber(argv[4], 10, &Log) == FALSE)))
+	{   // Message already displayed
+		return;
+	}
+	if (Log > 1)
+	{
+		SCIWriteMsg(MSG_INVALID_VALUE);
+		return;
+	}
+
+	GetWaveStatus(&Status);
+	Segment.ucType = (Log == 0) ? SEQ_CHIRP_LINEAR : SEQ_CHIRP_LOG;
+	Segment.ucRepeat = 1;
+	Segment.uiDuration = Duration;
+	Segment.uiCount = 0;
+	Segment.uiAmplitude = Status.uiAmplitude;
+	Segment.uiEndAmplitude = 0;
+	Segment.ulFrequency = (unsigned long)First * WAVE_FREQ_SCALE;
+	Segment.ulEndFrequency = (unsigned long)Last * WAVE_FREQ_SCALE;
+	if (StartSequence(&Segment) != NO_ERROR)
+	{
+		SCIWriteMsg(MSG_FREQUENCY_RANGE);
+	}
+}
+
+/* With no argument, stops whatever sequence is playing */
+static void CmdSequence(unsigned char ucArgc, char **argv)
+{
+	unsigned int Script;
+
+	if (ucArgc == 1)
+	{
+		StopSequence();
+	}
+	else if ((ReadNumber(argv[1], 10, &Script) == TRUE) &&
+			 ((Script > 0xFF) || (StartScript((unsigned char)Script) != NO_ERROR)))
+	{
+		SCIWriteMsg(MSG_INVALID_VALUE);
+	}
+}
+
+/* Displays, then clears, the sample buffer statistics */
+static void CmdSampleStats(unsigned char ucArgc, char **argv)
+{
+	char zOutputStr[MENU_ROW_SIZE];
+	char *ptrOut;
+	unsigned char ucHighWater, ucLowWater;
+	unsigned int uiUnderruns;
+
+	GetSampleBufferStats(&ucHighWater, &ucLowWater, &uiUnderruns);
+	ClearSampleBufferStats();
+
+	ptrOut = FormatString_P(zOutputStr, GetMsg(MSG_HIGH_WATER));
+	ptrOut = FormatDec(ptrOut, ucHighWater, 0);
+	ptrOut = FormatString_P(ptrOut, GetMsg(MSG_LOW_WATER));
+	ptrOut = FormatDec(ptrOut, ucLowWater, 0);
+	ptrOut = FormatString_P(ptrOut, GetMsg(MSG_UNDERRUNS));
+	ptrOut = FormatDec(ptrOut, uiUnderruns, 0);
+	FormatString_P(ptrOut, GetMsg(MSG_NEWLINE));
+	SCIWriteString(zOutputStr);
+}
+
+/* Displays, then clears, the receive fault counts. The messages are in
+ * eSCIFaultType order. */
+static void CmdSerialFaults(unsigned char ucArgc, char **argv)
+{
+	char zOutputStr[MENU_ROW_SIZE];
+	char *ptrOut = zOutputStr;
+	unsigned int auiFaults[SCI_NUM_FAULTS];
+	unsigned char i;
+
+	SCIGetFaultCounts(auiFaults);
+	SCIClearFaultCounts();
+
+	for (i = 0; i < SCI_NUM_FAULTS; ++i)
+	{
+		ptrOut = FormatString_P(ptrOut, GetMsg((eMsgIdType)(MSG_SCI_OVERFLOW + i)));
+		ptrOut = FormatDec(ptrOut, auiFaults[i], 0);
+	}
+	FormatString_P(ptrOut, GetMsg(MSG_NEWLINE));
+	SCIWriteString(zOutputStr);
+}
+
+/* Displays execution times. Rows are queued as there's room, so the Tx
+ * buffer keeps up. */
+static void CmdProfile(unsigned char ucArgc, char **argv)
+{
+	char zOutputStr[MENU_ROW_SIZE];
+	char *ptrOut;
+
+	ptrOut = FormatString_P(zOutputStr, GetMsg(MSG_BUDGET_TICK));
+	ptrOut = FormatDec32(ptrOut, TIMER0_TICK_MS * 1000UL, 0);
+	ptrOut = FormatString_P(ptrOut, GetMsg(MSG_BUDGET_TASK));
+	FormatDec(ptrOut, MAX_MEDIUM_THREAD_MS * 1000, 0);
+	SCIWriteString(zOutputStr);
+	SCIWriteMsg(MSG_PROFILE_HEADING);
+	ucProfileRow = 0;
+	MenuState = DISPLAY_PROFILE;
+}
+
+static void CmdProfileClear(unsigned char ucArgc, char **argv)
+{
+	ClearProfileStats();
+}
+
+/* Displays, then clears, the time spent asleep and the worst sample ISR
+ * latencies */
+static void CmdPowerStats(unsigned char ucArgc, char **argv)
+{
+	char zOutputStr[MENU_ROW_SIZE];
+	char *ptrOut;
+	PowerStatsType Stats;
+
+	GetPowerStats(&Stats);
+	ClearPowerStats();
+
+	ptrOut = FormatString_P(zOutputStr, GetMsg(MSG_IDLE));
+	ptrOut = FormatDec(ptrOut, Stats.ucIdlePercent, 0);
+	ptrOut = FormatString_P(ptrOut, GetMsg(MSG_SLEEPS));
+	ptrOut = FormatDec(ptrOut, Stats.uiSleeps, 0);
+	ptrOut = FormatString_P(ptrOut, GetMsg(MSG_LATENCY));
+	ptrOut = FormatDec(ptrOut, Stats.uiMaxLatency, 0);
+	ptrOut = FormatString_P(ptrOut, GetMsg(MSG_WAKE_LATENCY));
+	ptrOut = FormatDec(ptrOut, Stats.uiMaxWakeLatency, 0);
+	FormatString_P(ptrOut, GetMsg(MSG_NEWLINE));
+	SCIWriteString(zOutputStr);
+}
+
+/* Displays, then clears, the task overrun counts. One task is queued at a
+ * time, as there's room. */
+static void CmdTaskStats(unsigned char ucArgc, char **argv)
+{
+	ucTaskRow = 0;
+	MenuState = DISPLAY_TASKS;
+}
+
+/* With no arguments, lists the modules and their trace levels. One line is
+ * queued at a time, as there's room. */
+static void CmdTrace(unsigned char ucArgc, char **argv)
+{
+	unsigned int Module, Level;
+
+	if (ucArgc == 1)
+	{
+		ucTraceRow = 0;
+		MenuState = DISPLAY_TRACE;
+	}
+	else if (ucArgc != 3)
+	{
+		SCIWriteString_P(HelpTrace);
+	}
+	else if ((ReadNumber(argv[1], 10, &Module) == FALSE) ||
+			 (ReadNumber(argv[2], 10, &Level) == FALSE))
+	{   // Message already displayed
+	}
+	else if ((Module > 0xFF) || (Level > 0xFF) ||
+			 (SetTraceLevel((unsigned char)Module, (unsigned char)Level) != NO_ERROR))
+	{
+		SCIWriteMsg(MSG_INVALID_VALUE);
+	}
+}
+
+/* With no argument, turns telemetry off. Frames every sample by default. */
+static void CmdTelemetry(unsigned char ucArgc, char **argv)
+{
+	unsigned int Period, Decimation = 1;
+
+	if (ucArgc == 1)
+	{
+		StopTelemetry();
+	}
+	else if ((ReadNumber(argv[1], 10, &Period) == FALSE) ||
+			 ((ucArgc > 2) && (ReadNumber(argv[2], 10, &Decimation) == FALSE)))
+	{   // Message already displayed
+	}
+	else if ((Decimation > 0xFF) ||
+			 (StartTelemetry(Period, (unsigned char)Decimation) != NO_ERROR))
+	{
+		SCIWriteMsg(MSG_INVALID_VALUE);
+	}
+}
+
+/* With no argument, lists the rates that can be used */
+static void CmdBaudRate(unsigned char ucArgc, char **argv)
+{
+	char zOutputStr[MENU_ROW_SIZE];
+	char *ptrOut;
+	unsigned long ulBaud, ulRate;
+	unsigned char i;
+
+	if (ucArgc == 1)
+	{
+		ptrOut = FormatString_P(zOutputStr, GetMsg(MSG_BAUD_RATES));
+		for (i = 0; (ulRate = SCIGetBaudRate(i)) != 0; ++i)
+		{
+			if (ptrOut > &zOutputStr[MENU_ROW_SIZE - (FORMAT_DEC32_SIZE + 3)])
+			{   // Queue what's built so far. It joins the rest in the same
+				// transmit ring block.
+				SCIWriteString(zOutputStr);
+				ptrOut = zOutputStr;
+			}
+			ptrOut = FormatString_P(ptrOut, GetMsg(MSG_SPACE));
+			ptrOut = FormatDec32(ptrOut, ulRate, 0);
+		}
+		FormatString_P(ptrOut, GetMsg(MSG_NEWLINE));
+		SCIWriteString(zOutputStr);
+		return;
+	}
+
+	if (ParseUnsigned32(argv[1], 10, &ulBaud) != NO_ERROR)
+	{
+		SCIWriteMsg(MSG_INVALID_NUMBER);
+		return;
+	}
+
+	// Checked here, so the change isn't announced for a rate that won't
+	// be used
+	for (i = 0; (ulRate = SCIGetBaudRate(i)) != 0; ++i)
+	{
+		if (ulRate == ulBaud)
+		{
+			break;
+		}
+	}
+	if (ulRate == 0)
+	{
+		SCIWriteMsg(MSG_BAUD_UNSUPPORTED);
+		return;
+	}
+
+	// Queued first, so it goes out at the old rate. The rate changes once
+	// it and the prompt, queued straight after, have been sent.
+	SCIWriteMsg(MSG_BAUD_CHANGE);
+	SCISetBaudRate(ulBaud);
+}
+
+/******************************************************************************
+ * Converts a number typed at the menu. If it isn't valid, displays a message
+ * and returns FALSE.
+ ******************************************************************************/
+static eBooleanType ReadNumber(const char *Str, unsigned char Radix,
+							   unsigned int *ptrValue)
+{
+	if (ParseUnsigned(Str, Radix, ptrValue) != NO_ERROR)
+	{
+		SCIWriteMsg(MSG_INVALID_NUMBER);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+/******************************************************************************
+ * Displays the next line of an rm command: up to 16 bytes, with the address
+ * of the first. The line is built, then sent in one write.
+ ******************************************************************************/
+static void DisplayMemoryRow(void)
+{
+	char zOutputStr[MEM_LINE_SIZE];
+	char *ptrOutputStr = zOutputStr;
+	unsigned char i;
+
+	// Start line with the address
+	*ptrOutputStr++ = '\n';
+	*ptrOutputStr++ = '\r';
+	*ptrOutputStr++ = ' ';
+	*ptrOutputStr++ = ' ';
+	ptrOutputStr = FormatHex(ptrOutputStr, uiMemAddress, 3);
+	*ptrOutputStr++ = '>';
+	*ptrOutputStr++ = ' ';
+	*ptrOutputStr++ = ' ';
+
+	// Each byte is 2 hex digits and a space
+	for (i = 0; (i < 16) && (uiMemLeft != 0); ++i)
+	{
+		ptrOutputStr = FormatHex(ptrOutputStr, *(unsigned char *)(uintptr_t)uiMemAddress, 2);
+		*ptrOutputStr++ = ' ';
+		++uiMemAddress;
+		--uiMemLeft;
+	}
+	*ptrOutputStr = '\0';
+	SCIWriteString(zOutputStr);
+}
+
+/******************************************************************************
+ * Displays the execution times for one profile ID, in microseconds. A '!'
+ * marks a maximum longer than MAX_MEDIUM_THREAD_MS.
+ ******************************************************************************/
+static void DisplayProfileRow(eProfileIdType Id)
+{
+	ProfileStatsType Stats;
+	char zOutputStr[MENU_ROW_SIZE];
+	char *ptrOut;
+	unsigned long ulMaxTime;
+
+	GetProfileStats(Id, &Stats);
+	ptrOut = FormatString_P(zOutputStr, (PGM_P)pgm_read_word(&ProfileNames[Id]));
+	ptrOut = FormatDec(ptrOut, Stats.uiCount, 0);
+
+	if (Stats.uiCount != 0)
+	{
+		ulMaxTime = PROFILE_TICKS_TO_US(Stats.uiMax);
+
+		ptrOut = FormatString_P(ptrOut, GetMsg(MSG_INDENT));
+		ptrOut = FormatDec32(ptrOut, PROFILE_TICKS_TO_US(Stats.uiMin), 0);
+
+		ptrOut = FormatString_P(ptrOut, GetMsg(MSG_INDENT));
+		ptrOut = FormatDec32(ptrOut,
+							 PROFILE_TICKS_TO_US(Stats.ulTotal / Stats.uiCount), 0);
+
+		ptrOut = FormatString_P(ptrOut, GetMsg(MSG_INDENT));
+		ptrOut = FormatDec32(ptrOut, ulMaxTime, 0);
+
+		if (ulMaxTime > (MAX_MEDIUM_THREAD_MS * 1000UL))
+		{
+			ptrOut = FormatString_P(ptrOut, GetMsg(MSG_OVER_BUDGET));
+		}
+	}
+	FormatString_P(ptrOut, GetMsg(MSG_NEWLINE));
+	SCIWriteString(zOutputStr);
+}
+
+/******************************************************************************
+ * Displays one entry of the scheduler's task table, with its overrun count.
+ ******************************************************************************/
+static void DisplayTaskRow(unsigned char ucTask)
+{
+	TaskStatsType Stats;
+	char zOutputStr[MENU_ROW_SIZE];
+	char *ptrOut;
+
+	GetTaskStats(ucTask, &Stats);
+
+	ptrOut = FormatString_P(zOutputStr, GetMsg(MSG_INDENT));
+	ptrOut = FormatString_P(ptrOut, Stats.Name);
+	ptrOut = FormatString_P(ptrOut, GetMsg(MSG_TASK_PERIOD));
+	ptrOut = FormatDec(ptrOut, Stats.ucPeriod, 0);
+	ptrOut = FormatString_P(ptrOut, GetMsg(Stats.bInterrupt ?
+											MSG_TASK_ISR : MSG_TASK_FG));
+	ptrOut = FormatString_P(ptrOut, GetMsg(MSG_TASK_OVERRUNS));
+	ptrOut = FormatDec(ptrOut, Stats.uiOverruns, 0);
+	FormatString_P(ptrOut, GetMsg(MSG_NEWLINE));
+	SCIWriteString(zOutputStr);
+}
+
+/******************************************************************************
+ * Displays the outcome of the last calibration or self-test.
+ ******************************************************************************/
+static void DisplayCalResult(void)
+{
+	CalResultType Result;
+	char zOutputStr[MENU_ROW_SIZE];
+	char *ptrOut;
+
+	GetCalibrationResult(&Result);
+
+	ptrOut = FormatString_P(zOutputStr, GetMsg((Result.bPassed == TRUE) ?
+											   MSG_CAL_PASSED : MSG_CAL_FAILED));
+	ptrOut = FormatString_P(ptrOut, GetMsg(MSG_CAL_MAX_ERROR));
+	ptrOut = FormatDec(ptrOut, Result.uiMaxError, 0);
+	if (Result.bCalibrated == FALSE)
+	{
+		ptrOut = FormatString_P(ptrOut, GetMsg(MSG_CAL_UNCORRECTED));
+	}
+	FormatString_P(ptrOut, GetMsg(MSG_NEWLINE));
+	SCIWriteString(zOutputStr);
+}
+
+/******************************************************************************
+ * Runs one benchmark, and displays its time in CPU cycles.
+ ******************************************************************************/
+static void DisplayBenchmark(unsigned char ucIndex)
+{
+	char zOutputStr[MENU_ROW_SIZE];
+	char *ptrOut;
+	unsigned int uiCycles;
+
+	uiCycles = RunBenchmark(ucIndex);
+
+	ptrOut = FormatString_P(zOutputStr, GetBenchmarkName(ucIndex));
+	ptrOut = FormatString_P(ptrOut, GetMsg(MSG_SPACE));
+	ptrOut = FormatDec(ptrOut, uiCycles, 0);
+	FormatString_P(ptrOut, GetMsg(MSG_NEWLINE));
+	SCIWriteString(zOutputStr);
+}
+
+/******************************************************************************
+ * Displays the fastest the D/A can be written, as measured, and as limited
+ * by the time to shift a frame out.
+ ******************************************************************************/
+static void DisplayDtoARate(void)
+{
+	char zOutputStr[MENU_ROW_SIZE];
+	char *ptrOut;
+
+	ptrOut = FormatString_P(zOutputStr, GetMsg(MSG_DTOA_RATE));
+	ptrOut = FormatDec32(ptrOut, MeasureDtoARate(), 0);
+	ptrOut = FormatString_P(ptrOut, GetMsg(MSG_DTOA_RATE_LIMIT));
+	ptrOut = FormatDec32(ptrOut, F_CPU / DTOA_FRAME_CYCLES, 0);
+	FormatString_P(ptrOut, GetMsg(MSG_NEWLINE));
+	SCIWriteString(zOutputStr);
+}
+
+/******************************************************************************
+ * Displays how the last waveform upload went.
+ ******************************************************************************/
+static void DisplayArbStatus(void)
+{
+	ArbStatusType Status;
+	char zOutputStr[MENU_ROW_SIZE];
+	char *ptrOut;
+
+	GetArbStatus(&Status);
+
+	if (Status.Result == ARB_UPLOAD_TIMEOUT)
+	{
+		SCIWriteMsg(MSG_ARB_TIMEOUT);
+	}
+	else if (Status.Result == ARB_BUFFER_FULL)
+	{
+		SCIWriteMsg(MSG_ARB_TOO_LONG);
+	}
+
+	ptrOut = FormatString_P(zOutputStr, GetMsg(MSG_ARB_SAMPLES));
+	ptrOut = FormatDec32(ptrOut, Status.ulSamples, 0);
+	ptrOut = FormatString_P(ptrOut, GetMsg(MSG_ARB_RETRIES));
+	ptrOut = FormatDec(ptrOut, Status.uiRetries, 0);
+	ptrOut = FormatString_P(ptrOut, GetMsg(MSG_ARB_GAPS));
+	ptrOut = FormatDec(ptrOut, Status.uiGaps, 0);
+	FormatString_P(ptrOut, GetMsg(MSG_NEWLINE));
+	SCIWriteString(zOutputStr);
+}
+
+/******************************************************************************
+ * Displays one error log entry. If it's been replaced since the listing
+ * started, it's skipped.
+ ******************************************************************************/
+static void DisplayErrorEvent(unsigned int uiEvent)
+{
+	ErrorEventType Event;
+	char zOutputStr[LOG_ROW_SIZE];
+	char *ptrOut;
+
+	if (GetErrorEvent(uiEvent, &Event) == FALSE)
+	{
+		return;
+	}
+
+	zOutputStr[0] = ' ';
+	zOutputStr[1] = ' ';
+	ptrOut = FormatDec(&zOutputStr[2], uiEvent, 5);
+	*ptrOut++ = ' ';
+	ptrOut = FormatDec(ptrOut, Event.uiTick, 5);
+	*ptrOut++ = ' ';
+	ptrOut = FormatDec(ptrOut, Event.ucError, 3);
+	*ptrOut++ = ' ';
+	ptrOut = FormatDec(ptrOut, Event.ucContext, 3);
+	*ptrOut++ = '\n';
+	*ptrOut++ = '\r';
+	*ptrOut = '\0';
+	SCIWriteString(zOutputStr);
+}
+
+/******************************************************************************
+ * Displays one trace module and its level, or after the last module, the
+ * number of events dropped.
+ ******************************************************************************/
+static void DisplayTraceRow(unsigned char ucModule)
+{
+	char zOutputStr[MENU_ROW_SIZE];
+	char *ptrOut;
+
+	if (ucModule < TRACE_NUM_MODULES)
+	{
+		ptrOut = FormatString_P(zOutputStr, GetMsg(MSG_INDENT));
+		ptrOut = FormatDec(ptrOut, ucModule, 0);
+		ptrOut = FormatString_P(ptrOut, GetMsg(MSG_SPACE));
+		ptrOut = FormatString_P(ptrOut, GetTraceModuleName(ucModule));
+		ptrOut = FormatString_P(ptrOut, GetMsg(MSG_TRACE_LEVEL));
+		ptrOut = FormatDec(ptrOut, GetTraceLevel(ucModule), 0);
+	}
+	else
+	{
+		ptrOut = FormatString_P(zOutputStr, GetMsg(MSG_TRACE_DROPPED));
+		ptrOut = FormatDec(ptrOut, GetTraceDropped(), 0);
+	}
+	FormatString_P(ptrOut, GetMsg(MSG_NEWLINE));
+	SCIWriteString(zOutputStr);
+}
+
+/******************************************************************************
+ * Displays how many times an error has been reported, if it has been.
+ ******************************************************************************/
+static void DisplayErrorCount(eErrorType Error)
+{
+	char zOutputStr[LOG_ROW_SIZE];
+	char *ptrOut;
+	unsigned int uiCount;
+
+	uiCount = GetErrorCount(Error);
+	if (uiCount == 0)
+	{
+		return;
+	}
+
+	zOutputStr[0] = ' ';
+	ptrOut = FormatDec(&zOutputStr[1], Error, 0);
+	*ptrOut++ = '=';
+	FormatDec(ptrOut, uiCount, 0);
+	SCIWriteString(zOutputStr);
+}
@@ -13,5 +13,6 @@
 
 /* Function Prototypes */
 void RunMenu(void);
+void RunMenuLine(const char *);		// Runs a line as if it had been typed
 
 #endif /* MENU_H */
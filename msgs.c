@@ -0,0 +1,112 @@
+/******************************************************************************
+ * File Name:	msgs.c
+ * Program:		Project for Real-Time Embedded Systems Programming class
+ * Purpose:		Catalog of the fixed messages sent out the serial port. Each
+ *				message is stored once, in flash, and sent straight from
+ *				there by ID, so none of them takes up RAM and the same text
+ *				used in several places isn't stored several times.
+ ******************************************************************************/
+#include <avr/pgmspace.h>
+
+#include "serial.h"
+#include "msgs.h"
+
+/* Message text, in eMsgIdType order */
+static const char Msg0[] PROGMEM = "\n\r";	// MSG_NEWLINE
+static const char Msg1[] PROGMEM = "cmd> ";	// MSG_PROMPT
+static const char Msg2[] PROGMEM = "Welcome to Embedded Systems Programming\n\r";	// MSG_WELCOME
+static const char Msg3[] PROGMEM = "  Commands are:\n\r";	// MSG_COMMANDS_ARE
+static const char Msg4[] PROGMEM = "  Unknown command. Type ? for help.\n\r";	// MSG_UNKNOWN_COMMAND
+static const char Msg5[] PROGMEM = "  Usage:\n\r";	// MSG_USAGE
+static const char Msg6[] PROGMEM = "  Invalid number\n\r";	// MSG_INVALID_NUMBER
+static const char Msg7[] PROGMEM = "  Invalid value\n\r";	// MSG_INVALID_VALUE
+static const char Msg8[] PROGMEM = "  Address out of range\n\r";	// MSG_ADDRESS_RANGE
+static const char Msg9[] PROGMEM = "  Invalid waveform\n\r";	// MSG_INVALID_WAVEFORM
+static const char Msg10[] PROGMEM = "  Invalid mode\n\r";	// MSG_INVALID_MODE
+static const char Msg11[] PROGMEM = "  Frequency out of range\n\r";	// MSG_FREQUENCY_RANGE
+static const char Msg12[] PROGMEM = "  Amplitude out of range\n\r";	// MSG_AMPLITUDE_RANGE
+static const char Msg13[] PROGMEM = "  Unsupported baud rate\n\r";	// MSG_BAUD_UNSUPPORTED
+static const char Msg14[] PROGMEM = "  Change terminal baud rate now\n\r";	// MSG_BAUD_CHANGE
+static const char Msg15[] PROGMEM = "  Error = ";	// MSG_ERROR_EQUALS
+static const char Msg16[] PROGMEM = "  Memory =";	// MSG_MEMORY_EQUALS
+static const char Msg17[] PROGMEM = "  High water = ";	// MSG_HIGH_WATER
+static const char Msg18[] PROGMEM = ", low water = ";	// MSG_LOW_WATER
+static const char Msg19[] PROGMEM = ", underruns = ";	// MSG_UNDERRUNS
+static const char Msg20[] PROGMEM = "  Budgets (us): tick = ";	// MSG_BUDGET_TICK
+static const char Msg21[] PROGMEM = ", task = ";	// MSG_BUDGET_TASK
+static const char Msg22[] PROGMEM = "\n\r              count   min   avg   max\n\r";	// MSG_PROFILE_HEADING
+static const char Msg23[] PROGMEM = "  Baud rates:";	// MSG_BAUD_RATES
+static const char Msg24[] PROGMEM = "  ";	// MSG_INDENT
+static const char Msg25[] PROGMEM = " ";	// MSG_SPACE
+static const char Msg26[] PROGMEM = " !";	// MSG_OVER_BUDGET
+static const char Msg27[] PROGMEM = ": period ";	// MSG_TASK_PERIOD
+static const char Msg28[] PROGMEM = " (isr)";	// MSG_TASK_ISR
+static const char Msg29[] PROGMEM = " (fg)";	// MSG_TASK_FG
+static const char Msg30[] PROGMEM = ", overruns ";	// MSG_TASK_OVERRUNS
+static const char Msg31[] PROGMEM = "  Calibration passed";	// MSG_CAL_PASSED
+static const char Msg32[] PROGMEM = "  Calibration FAILED";	// MSG_CAL_FAILED
+static const char Msg33[] PROGMEM = ", max error (1/16 count) ";	// MSG_CAL_MAX_ERROR
+static const char Msg34[] PROGMEM = ", uncorrected";	// MSG_CAL_UNCORRECTED
+static const char Msg35[] PROGMEM = "  Routine          cycles/call\n\r";	// MSG_BENCH_HEADING
+static const char Msg36[] PROGMEM = "  Samples ";	// MSG_ARB_SAMPLES
+static const char Msg37[] PROGMEM = ", retries ";	// MSG_ARB_RETRIES
+static const char Msg38[] PROGMEM = ", gaps ";	// MSG_ARB_GAPS
+static const char Msg39[] PROGMEM = "  Upload timed out\n\r";	// MSG_ARB_TIMEOUT
+static const char Msg40[] PROGMEM = "  Block too long to loop\n\r";	// MSG_ARB_TOO_LONG
+static const char Msg41[] PROGMEM = "  RX overflow ";	// MSG_SCI_OVERFLOW
+static const char Msg42[] PROGMEM = ", framing ";	// MSG_SCI_FRAME
+static const char Msg43[] PROGMEM = ", overrun ";	// MSG_SCI_OVERRUN
+static const char Msg44[] PROGMEM = ", parity ";	// MSG_SCI_PARITY
+static const char Msg45[] PROGMEM = "  event  tick err ctx\n\r";	// MSG_LOG_HEADING
+static const char Msg46[] PROGMEM = "  Counts (err=n):";	// MSG_LOG_COUNTS
+static const char Msg47[] PROGMEM = "  Idle ";	// MSG_IDLE
+static const char Msg48[] PROGMEM = "%, sleeps ";	// MSG_SLEEPS
+static const char Msg49[] PROGMEM = ", sample latency (cycles) ";	// MSG_LATENCY
+static const char Msg50[] PROGMEM = ", on wake ";	// MSG_WAKE_LATENCY
+static const char Msg51[] PROGMEM = "  D/A samples/sec ";	// MSG_DTOA_RATE
+static const char Msg52[] PROGMEM = ", shift limit ";	// MSG_DTOA_RATE_LIMIT
+static const char Msg53[] PROGMEM = "  level ";	// MSG_TRACE_LEVEL
+static const char Msg54[] PROGMEM = "  Events dropped ";	// MSG_TRACE_DROPPED
+
+static PGM_P const Messages[MSG_NUM_IDS] PROGMEM =
+{
+	Msg0, Msg1, Msg2, Msg3,
+	Msg4, Msg5, Msg6, Msg7,
+	Msg8, Msg9, Msg10, Msg11,
+	Msg12, Msg13, Msg14, Msg15,
+	Msg16, Msg17, Msg18, Msg19,
+	Msg20, Msg21, Msg22, Msg23,
+	Msg24, Msg25, Msg26, Msg27,
+	Msg28, Msg29, Msg30, Msg31,
+	Msg32, Msg33, Msg34, Msg35,
+	Msg36, Msg37, Msg38, Msg39,
+	Msg40, Msg41, Msg42, Msg43,
+	Msg44, Msg45, Msg46, Msg47,
+	Msg48, Msg49, Msg50, Msg51,
+	Msg52, Msg53, Msg54
+};
+
+/******************************************************************************
+ * Outputs a message from the catalog to the RS-232 port.
+ ******************************************************************************/
+int SCIWriteMsg(eMsgIdType Id)
+{
+	if (Id >= MSG_NUM_IDS)
+	{
+		return -1;
+	}
+	return SCIWriteString_P((PGM_P)pgm_read_word(&Messages[Id]));
+}
+
+/******************************************************************************
+ * Returns the text of a message, for building into a longer line. An
+ * unknown ID gives a space.
+ ******************************************************************************/
+PGM_P GetMsg(eMsgIdType Id)
+{
+	if (Id >= MSG_NUM_IDS)
+	{
+		Id = MSG_SPACE;
+	}
+	return (PGM_P)pgm_read_word(&Messages[Id]);
+}
@@ -0,0 +1,76 @@
+/******************************************************************************
+ * File Name:	msgs.h
+ * Program:		Project for Real-Time Embedded Systems Programming class
+ * Purpose:		Header file for msgs.c file.
+ ******************************************************************************/
+#if !defined(MSGS_H)		/* Prevents including this file multiple times */
+#define MSGS_H
+
+#include <avr/pgmspace.h>
+
+/* Message IDs. Messages[] in msgs.c must be kept in the same order. */
+typedef enum
+{
+	MSG_NEWLINE = 0,
+	MSG_PROMPT,
+	MSG_WELCOME,
+	MSG_COMMANDS_ARE,
+	MSG_UNKNOWN_COMMAND,
+	MSG_USAGE,
+	MSG_INVALID_NUMBER,
+	MSG_INVALID_VALUE,
+	MSG_ADDRESS_RANGE,
+	MSG_INVALID_WAVEFORM,
+	MSG_INVALID_MODE,
+	MSG_FREQUENCY_RANGE,
+	MSG_AMPLITUDE_RANGE,
+	MSG_BAUD_UNSUPPORTED,
+	MSG_BAUD_CHANGE,
+	MSG_ERROR_EQUALS,
+	MSG_MEMORY_EQUALS,
+	MSG_HIGH_WATER,
+	MSG_LOW_WATER,
+	MSG_UNDERRUNS,
+	MSG_BUDGET_TICK,
+	MSG_BUDGET_TASK,
+	MSG_PROFILE_HEADING,
+	MSG_BAUD_RATES,
+	MSG_INDENT,
+	MSG_SPACE,
+	MSG_OVER_BUDGET,
+	MSG_TASK_PERIOD,
+	MSG_TASK_ISR,
+	MSG_TASK_FG,
+	MSG_TASK_OVERRUNS,
+	MSG_CAL_PASSED,
+	MSG_CAL_FAILED,
+	MSG_CAL_MAX_ERROR,
+	MSG_CAL_UNCORRECTED,
+	MSG_BENCH_HEADING,
+	MSG_ARB_SAMPLES,
+	MSG_ARB_RETRIES,
+	MSG_ARB_GAPS,
+	MSG_ARB_TIMEOUT,
+	MSG_ARB_TOO_LONG,
+	MSG_SCI_OVERFLOW,
+	MSG_SCI_FRAME,
+	MSG_SCI_OVERRUN,
+	MSG_SCI_PARITY,
+	MSG_LOG_HEADING,
+	MSG_LOG_COUNTS,
+	MSG_IDLE,
+	MSG_SLEEPS,
+	MSG_LATENCY,
+	MSG_WAKE_LATENCY,
+	MSG_DTOA_RATE,
+	MSG_DTOA_RATE_LIMIT,
+	MSG_TRACE_LEVEL,
+	MSG_TRACE_DROPPED,
+	MSG_NUM_IDS
+} eMsgIdType;
+
+/* Function Prototypes */
+int SCIWriteMsg(eMsgIdType);
+PGM_P GetMsg(eMsgIdType);
+
+#endif /* MSGS_H */
@@ -0,0 +1,223 @@
+/******************************************************************************
+ * File Name:	power.c
+ * Program:		Project for Real-Time Embedded Systems Programming class
+ * Purpose:		Power saving. Peripherals that nothing uses are switched off
+ *				through the power reduction registers, and the foreground
+ *				loop sleeps in idle mode once it has nothing left to do.
+ *				Every change of state comes from an interrupt, and any
+ *				interrupt wakes the CPU, so the loop simply goes round again.
+ *				Work an interrupt makes after its service routine has run
+ *				is caught by checking, with interrupts disabled, that no
+ *				task and no service routine has anything to do.
+ *
+ *				Idle mode stops only the CPU and flash clocks; the timers,
+ *				UART, SPI and A/D keep running. Waking takes 4 cycles more
+ *				than an ordinary interrupt response. To check that the
+ *				sample ISR still meets its deadlines, it reports how late it
+ *				started (see RecordSampleLatency), and the worst cases are
+ *				kept separately for samples that woke the CPU.
+ ******************************************************************************/
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+
+#include "lib.h"
+#include "config.h"
+#include "profile.h"
+#include "sched.h"
+#include "dtoa.h"
+#include "samplebuf.h"
+#include "memdump.h"
+#include "calib.h"
+#include "arb.h"
+#include "sequence.h"
+#include "trace.h"
+#include "telemetry.h"
+#include "power.h"
+
+/* Timer 3 counts per Timer 0 tick, for the idle percentage */
+#define PROFILE_COUNTS_PER_TICK		(TIMER0_TICK_CYCLES / PROFILE_TIMER_SCALER)
+
+/* TRUE from just before the foreground sleeps until the ISR that wakes it
+ * returns */
+static volatile unsigned char ucAsleep = FALSE;
+
+/*
+ * Sleeps, and clears ucAsleep with the very next instruction. After the ISR
+ * that woke the CPU returns, one instruction always runs before any other
+ * interrupt is taken, so only that ISR ever sees ucAsleep set.
+ */
+#if defined(HOST_BUILD)
+#define SLEEP_UNTIL_WOKEN()		do { sleep_cpu(); ucAsleep = FALSE; } while (0)
+#else
+#define SLEEP_UNTIL_WOKEN()		asm volatile ("sleep" "\n\t" \
+											  "sts %0, __zero_reg__" \
+											  : : "i" (&ucAsleep) : "memory")
+#endif
+
+/* Statistics. The foreground writes the idle ones, and the Timer 1 ISR the
+ * latencies. */
+static unsigned long ulIdleCounts = 0;		// Timer 3 counts
+static unsigned int uiSleeps = 0;
+static unsigned int uiStatsStart = 0;		// Tick they were cleared
+static volatile unsigned int uiMaxLatency = 0;
+static volatile unsigned int uiMaxWakeLatency = 0;
+
+/******************************************************************************
+ * Switches off the peripherals nothing uses, and selects idle sleep.
+ * The A/D stays on: it samples in the background for the temperature and
+ * the D/A calibration. The LCD is driven by the display task, and Timer 3
+ * is the profiling clock.
+ ******************************************************************************/
+void InitPower(void)
+{
+	/*------------------ Set PRR0 values ----------------------------
+	 * Bit 7: PRTWI    = 1  TWI off
+	 *     6: PRTIM2   = 1  Timer 2 off
+	 *     5: PRTIM0   = 0  Timer 0 on, scheduler tick
+	 *     4: unused   = 0
+	 *     3: PRTIM1   = 0  Timer 1 on, waveform samples
+	 *     2: PRSPI    = x  SPI on for the D/A, unless it's on USART 1
+	 *     1: PRUSART0 = 0  USART 0 on, menu
+	 *     0: PRADC    = 0  A/D on
+	 */
+#if DTOA_USART_SPI
+	PRR0 = _BV(PRTWI) | _BV(PRTIM2) | _BV(PRSPI);
+#else
+	PRR0 = _BV(PRTWI) | _BV(PRTIM2);
+#endif
+
+	/*------------------ Set PRR1 values ----------------------------
+	 * Bit 7-6: unused   = 0
+	 *       5: PRTIM5   = 1  Timer 5 off
+	 *       4: PRTIM4   = 1  Timer 4 off
+	 *       3: PRTIM3   = 0  Timer 3 on, profiling
+	 *       2: PRUSART3 = 1  USART 3 off
+	 *       1: PRUSART2 = 1  USART 2 off
+	 *       0: PRUSART1 = x  USART 1 off, unless it's driving the D/A
+	 */
+#if DTOA_USART_SPI
+	PRR1 = _BV(PRTIM5) | _BV(PRTIM4) | _BV(PRUSART3) | _BV(PRUSART2);
+#else
+	PRR1 = _BV(PRTIM5) | _BV(PRTIM4) | _BV(PRUSART3) | _BV(PRUSART2) |
+		   _BV(PRUSART1);
+#endif
+
+	// The analog comparator isn't in the power reduction registers
+	SET_BIT(ACSR, ACD);
+
+	set_sleep_mode(SLEEP_MODE_IDLE);
+	ClearPowerStats();
+}
+
+/******************************************************************************
+ * Returns TRUE if any of the service routines in the foreground loop could
+ * do something now. Interrupts are disabled, so each check is kept short.
+ ******************************************************************************/
+static eBooleanType ServiceWorkPending(void)
+{
+	return ((SampleBufferWorkPending() == TRUE) ||
+			(MemoryDumpWorkPending() == TRUE) ||
+			(CalibrationWorkPending() == TRUE) ||
+			(ArbitraryWorkPending() == TRUE) ||
+			(SequenceWorkPending() == TRUE) ||
+			(TraceWorkPending() == TRUE) ||
+			(TelemetryWorkPending() == TRUE)) ? TRUE : FALSE;
+}
+
+/******************************************************************************
+ * Sleeps until the next interrupt, unless a task has been readied or a
+ * service routine has work since they last looked. Called at the end of
+ * each pass of the foreground loop.
+ ******************************************************************************/
+void IdleSleep(void)
+{
+#if IDLE_SLEEP
+	unsigned int uiStart;
+
+	/* With interrupts disabled, nothing can make work between the checks
+	 * and the sleep. sei() lets one more instruction run before any
+	 * interrupt, so the CPU is asleep before one can be taken, and it
+	 * wakes us. */
+	cli();
+	if ((SchedulerTaskReady() == TRUE) || (ServiceWorkPending() == TRUE))
+	{
+		sei();
+		return;
+	}
+
+	uiStart = ProfileTimestamp();
+	ucAsleep = TRUE;
+	sleep_enable();
+	sei();
+	SLEEP_UNTIL_WOKEN();
+	sleep_disable();
+
+	// Includes the ISR that woke us. A sleep is never longer than a tick,
+	// so the timestamp doesn't wrap.
+	ulIdleCounts += (unsigned int)(ProfileTimestamp() - uiStart);
+	if (uiSleeps != 0xFFFF)
+	{
+		++uiSleeps;
+	}
+#endif
+}
+
+/******************************************************************************
+ * Records how many CPU cycles after its compare match the sample ISR
+ * started. Called from the Timer 1 ISR, so interrupts are disabled. Samples
+ * that come while another interrupt's wake-up is being handled only count
+ * as ordinary ones.
+ ******************************************************************************/
+void RecordSampleLatency(unsigned int uiCycles)
+{
+	if (uiCycles > uiMaxLatency)
+	{
+		uiMaxLatency = uiCycles;
+	}
+	if ((ucAsleep == TRUE) && (uiCycles > uiMaxWakeLatency))
+	{
+		uiMaxWakeLatency = uiCycles;
+	}
+}
+
+/******************************************************************************
+ * Copies the statistics since they were last cleared. The idle percentage
+ * is only right for up to 65535 ticks (27 minutes).
+ ******************************************************************************/
+void GetPowerStats(PowerStatsType *ptrStats)
+{
+	unsigned long ulElapsed;
+	unsigned char ucSREG;
+
+	ulElapsed = (unsigned int)(GetTickCount() - uiStatsStart) *
+				PROFILE_COUNTS_PER_TICK;
+	ptrStats->ucIdlePercent = (ulElapsed == 0) ? 0 :
+		(unsigned char)(ulIdleCounts / (ulElapsed / 100));
+	ptrStats->uiSleeps = uiSleeps;
+
+	// 16-bit reads; don't let the ISR change them halfway through.
+	ucSREG = SREG;
+	cli();
+	ptrStats->uiMaxLatency = uiMaxLatency;
+	ptrStats->uiMaxWakeLatency = uiMaxWakeLatency;
+	SREG = ucSREG;
+}
+
+/******************************************************************************
+ * Clears the statistics.
+ ******************************************************************************/
+void ClearPowerStats(void)
+{
+	unsigned char ucSREG;
+
+	ulIdleCounts = 0;
+	uiSleeps = 0;
+	uiStatsStart = GetTickCount();
+
+	ucSREG = SREG;
+	cli();
+	uiMaxLatency = 0;
+	uiMaxWakeLatency = 0;
+	SREG = ucSREG;
+}
@@ -0,0 +1,30 @@
+/******************************************************************************
+ * File Name:	power.h
+ * Program:		Project for Real-Time Embedded Systems Programming class
+ * Purpose:		Header file for power.c file.
+ ******************************************************************************/
+#if !defined(POWER_H)		/* Prevents including this file multiple times */
+#define POWER_H
+
+#include "lib.h"
+
+/* Set to 0 to keep the foreground loop spinning instead of sleeping */
+#define IDLE_SLEEP                      1
+
+/* Statistics since they were last cleared, for display */
+typedef struct
+{
+	unsigned char ucIdlePercent;	// Time the foreground spent asleep
+	unsigned int uiSleeps;			// Times it went to sleep. Stops at 0xFFFF.
+	unsigned int uiMaxLatency;		// Worst sample ISR latency, CPU cycles
+	unsigned int uiMaxWakeLatency;	// Worst, for samples that woke the CPU
+} PowerStatsType;
+
+/* Function Prototypes */
+void InitPower(void);
+void IdleSleep(void);					// Called from foreground loop
+void RecordSampleLatency(unsigned int);	// Called from Timer 1 ISR
+void GetPowerStats(PowerStatsType *);
+void ClearPowerStats(void);
+
+#endif /* POWER_H */
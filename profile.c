@@ -0,0 +1,126 @@
+/******************************************************************************
+ * File Name:	profile.c
+ * Program:		Project for Real-Time Embedded Systems Programming class
+ * Purpose:		Execution time measurement. Timer 3 runs free, and each
+ *				timed ISR or task records the count at its entry and exit.
+ *				The difference is accumulated into min/max/average
+ *				statistics for the menu to display.
+ *
+ *				Times include any interrupts that were serviced while the
+ *				code was running. At F_CPU/8, the counter wraps every
+ *				65536*8/F_CPU seconds (65 mSecs at 8 MHz), which is longer
+ *				than anything we time.
+ ******************************************************************************/
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#include "lib.h"
+#include "profile.h"
+
+static ProfileStatsType ProfileStats[PROFILE_NUM_IDS];
+
+/******************************************************************************
+ * Starts Timer 3 running free, and clears the statistics.
+ ******************************************************************************/
+void InitProfile(void)
+{
+	/*------------------ Set TCCR3A values --------------------------
+	 * Bit 7-2: COM3xx = 0  Normal port operation. No Output Compare
+	 *     1: WGM31  = 0  Sets Waveform Generation mode to Normal
+	 *     0: WGM30  = 0
+	 */
+	TCCR3A = 0;
+
+	/*------------------ Set TCCR3B values --------------------------
+	 * Bit 7: ICNC3  = 0  No input capture
+	 *     6: ICES3  = 0
+	 *     5: unused = 0
+	 *     4: WGM33  = 0  Sets Waveform Generation mode to Normal
+	 *     3: WGM32  = 0
+	 *     2: CS32   = 0  Sets prescaler to 8, I/O clock
+	 *     1: CS31   = 1
+	 *     0: CS30   = 0
+	 */
+	TCCR3B = _BV(CS31);
+
+	// No interrupts. We only read the count.
+	TIMSK3 = 0;
+
+	ClearProfileStats();
+}
+
+/******************************************************************************
+ * Returns the current Timer 3 count. The 16-bit read goes through the
+ * timer's TEMP register, which a nested ISR reading the timer could change
+ * between our two byte reads, so we read with interrupts disabled.
+ ******************************************************************************/
+unsigned int ProfileTimestamp(void)
+{
+	unsigned int uiCount;
+	unsigned char ucSREG;
+
+	ucSREG = SREG;
+	cli();
+	uiCount = TCNT3;
+	SREG = ucSREG;
+	return uiCount;
+}
+
+/******************************************************************************
+ * Records one execution of the specified code, which started at the
+ * specified timestamp. Each ID is only updated by its own code, and an ISR
+ * can't interrupt itself, so no locking is needed here.
+ ******************************************************************************/
+void ProfileEnd(eProfileIdType Id, unsigned int uiStart)
+{
+	ProfileStatsType *ptrStats = &ProfileStats[Id];
+	unsigned int uiElapsed = ProfileTimestamp() - uiStart;
+
+	if (uiElapsed < ptrStats->uiMin)
+	{
+		ptrStats->uiMin = uiElapsed;
+	}
+	if (uiElapsed > ptrStats->uiMax)
+	{
+		ptrStats->uiMax = uiElapsed;
+	}
+	if (ptrStats->uiCount != 0xFFFF)
+	{
+		ptrStats->ulTotal += uiElapsed;
+		++ptrStats->uiCount;
+	}
+}
+
+/******************************************************************************
+ * Copies the statistics for the specified ID. The copy is done with
+ * interrupts off, so all fields come from the same moment.
+ ******************************************************************************/
+void GetProfileStats(eProfileIdType Id, ProfileStatsType *ptrStats)
+{
+	unsigned char ucSREG;
+
+	ucSREG = SREG;
+	cli();
+	*ptrStats = ProfileStats[Id];
+	SREG = ucSREG;
+}
+
+/******************************************************************************
+ * Clears all statistics.
+ ******************************************************************************/
+void ClearProfileStats(void)
+{
+	unsigned char i;
+	unsigned char ucSREG;
+
+	for (i = 0; i < PROFILE_NUM_IDS; ++i)
+	{
+		ucSREG = SREG;
+		cli();
+		ProfileStats[i].uiMin = 0xFFFF;
+		ProfileStats[i].uiMax = 0;
+		ProfileStats[i].ulTotal = 0;
+		ProfileStats[i].uiCount = 0;
+		SREG = ucSREG;
+	}
+}
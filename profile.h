@@ -0,0 +1,72 @@
+/******************************************************************************
+ * File Name:	profile.h
+ * Program:		Project for Real-Time Embedded Systems Programming class
+ * Purpose:		Header file for profile.c file. Defines the macros used to
+ *				time ISRs and tasks.
+ *
+ *				Put PROFILE_START(id) after the declarations at the top of the
+ *				code to be timed, and PROFILE_END(id) at the bottom. Set
+ *				PROFILING to 0 to compile all of it out.
+ ******************************************************************************/
+#if !defined(PROFILE_H)		/* Prevents including this file multiple times */
+#define PROFILE_H
+
+#include "lib.h"
+
+/* Set to 0 to remove all profiling code */
+#define PROFILING                       1
+
+/* The code with this ID drives TIMING_BIT high while it runs, for viewing on
+ * a scope. Set to PROFILE_NUM_IDS for none. */
+#define PROFILE_SCOPE_ID                PROFILE_TIMER0
+
+/* Timer 3 runs free at F_CPU/8. Convert its counts to microseconds. */
+#define PROFILE_TIMER_SCALER            8
+#define PROFILE_TICKS_TO_US(ticks)      \
+    (((unsigned long)(ticks) * PROFILE_TIMER_SCALER) / (F_CPU / 1000000UL))
+
+/* Things we can time */
+typedef enum
+{
+	PROFILE_TIMER0 = 0,		// Medium-thread ISR, including its tasks
+	PROFILE_USART0_RX,
+	PROFILE_USART0_UDRE,
+	PROFILE_TIMER1,			// Waveform sample ISR
+	PROFILE_SPI,			// D/A frame ISR
+	PROFILE_ADC,			// A/D conversion ISR
+	PROFILE_HEARTBEAT,		// Medium-thread tasks
+	PROFILE_MENU,
+	PROFILE_DISPLAY,
+	PROFILE_NUM_IDS
+} eProfileIdType;
+
+/* Execution time statistics, in Timer 3 counts */
+typedef struct
+{
+	unsigned int uiMin;
+	unsigned int uiMax;
+	unsigned long ulTotal;
+	unsigned int uiCount;	// Stops counting (and totalling) at 0xFFFF
+} ProfileStatsType;
+
+#if PROFILING
+#define PROFILE_START(id)                                       \
+    unsigned int uiProfileStart = ProfileTimestamp();           \
+    if ((id) == PROFILE_SCOPE_ID) SET_BIT(PORTB, TIMING_BIT)
+
+#define PROFILE_END(id)                                         \
+    if ((id) == PROFILE_SCOPE_ID) CLEAR_BIT(PORTB, TIMING_BIT); \
+    ProfileEnd((id), uiProfileStart)
+#else
+#define PROFILE_START(id)
+#define PROFILE_END(id)
+#endif /* PROFILING */
+
+/* Function Prototypes */
+void InitProfile(void);
+unsigned int ProfileTimestamp(void);
+void ProfileEnd(eProfileIdType, unsigned int);	// ID, start timestamp
+void GetProfileStats(eProfileIdType, ProfileStatsType *);
+void ClearProfileStats(void);
+
+#endif /* PROFILE_H */
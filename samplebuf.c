@@ -0,0 +1,221 @@
+/******************************************************************************
+ * File Name:	samplebuf.c
+ * Program:		Project for Real-Time Embedded Systems Programming class
+ * Purpose:		Circular buffer of D/A samples. The foreground loop fills it,
+ *				and the waveform ISR drains it at the sample rate. Each entry
+ *				holds a sample for every D/A channel, and each channel has
+ *				its own producer, so the channels stay in step.
+ *
+ *				There is exactly one producer and one consumer. The producer
+ *				only writes the Head index and the consumer only writes the
+ *				Tail index, so neither side ever has to disable interrupts.
+ *				The indexes are single bytes, so reading or writing one is
+ *				atomic on the AVR; a pointer, as used by the serial buffers,
+ *				would take two accesses.
+ ******************************************************************************/
+#include <avr/interrupt.h>
+
+#include "lib.h"
+#include "errors.h"
+#include "samplebuf.h"
+
+/* Macro for moving circular buffer indexes */
+#define INC_SAMPLE_INDEX(index)		(((index) + 1) & (SAMPLE_BUFFER_SIZE - 1))
+
+/* Number of samples in the buffer */
+#define SAMPLE_COUNT(head, tail)	(((head) - (tail)) & (SAMPLE_BUFFER_SIZE - 1))
+
+/*
+ * Define sample buffer variables. The Head and Tail indexes - but not the
+ * data being indexed - need to be volatile.
+ */
+static DtoAFrameType aSampleBuffer[SAMPLE_BUFFER_SIZE];
+static volatile unsigned char ucSampleHead = 0;
+static volatile unsigned char ucSampleTail = 0;
+
+/* Fill levels seen by the consumer, and the number of times it found the
+ * buffer empty. Only the consumer writes these. To clear them, the
+ * foreground sets bClearStats, and the consumer does the clearing. */
+static volatile unsigned char ucHighWater = 0;
+static volatile unsigned char ucLowWater = SAMPLE_BUFFER_SIZE - 1;
+static volatile unsigned int uiUnderruns = 0;
+static volatile eBooleanType bClearStats = FALSE;
+
+/* Foreground function that computes the next sample for each channel, if
+ * any. A channel without one holds its last value. */
+static unsigned int (*apfnSampleProducer[DTOA_NUM_CHANNELS])(void);
+static DtoAFrameType LastFrame;
+static unsigned char ucNumProducers = 0;
+
+/******************************************************************************
+ * Adds a frame to the buffer. Returns FALSE, and discards the frame, if
+ * the buffer is full. Only the producer may call this.
+ ******************************************************************************/
+eBooleanType PutSample(const DtoAFrameType *ptrFrame)
+{
+	unsigned char ucNext = INC_SAMPLE_INDEX(ucSampleHead);
+
+	if (ucNext == ucSampleTail)
+	{	// Buffer is full
+		return FALSE;
+	}
+
+	/* Store the data before moving the index, so the consumer never sees
+	 * an entry that hasn't been written yet. */
+	aSampleBuffer[ucSampleHead] = *ptrFrame;
+	ucSampleHead = ucNext;
+	return TRUE;
+}
+
+/******************************************************************************
+ * Removes the oldest frame from the buffer, and updates the fill statistics.
+ * Returns FALSE if the buffer was empty; this is an underrun, and is reported
+ * as DTOA_SAMPLE_UNDERRUN. Only the consumer may call this.
+ ******************************************************************************/
+eBooleanType GetSample(DtoAFrameType *ptrFrame)
+{
+	unsigned char ucTail = ucSampleTail;
+	unsigned char ucCount = SAMPLE_COUNT(ucSampleHead, ucTail);
+
+	if (bClearStats == TRUE)
+	{
+		ucHighWater = 0;
+		ucLowWater = SAMPLE_BUFFER_SIZE - 1;
+		uiUnderruns = 0;
+		bClearStats = FALSE;
+	}
+
+	if (ucCount > ucHighWater)
+	{
+		ucHighWater = ucCount;
+	}
+	if (ucCount < ucLowWater)
+	{
+		ucLowWater = ucCount;
+	}
+
+	if (ucCount == 0)
+	{	// Nothing to send. Count it, unless the counter is saturated.
+		if (uiUnderruns != 0xFFFF)
+		{
+			++uiUnderruns;
+		}
+		ReportError(DTOA_SAMPLE_UNDERRUN);
+		return FALSE;
+	}
+
+	*ptrFrame = aSampleBuffer[ucTail];
+	ucSampleTail = INC_SAMPLE_INDEX(ucTail);
+	return TRUE;
+}
+
+/******************************************************************************
+ * Returns the number of samples that can be added to the buffer.
+ ******************************************************************************/
+unsigned char GetSampleBufferSpace(void)
+{
+	return (SAMPLE_BUFFER_SIZE - 1) - SAMPLE_COUNT(ucSampleHead, ucSampleTail);
+}
+
+/******************************************************************************
+ * Discards everything in the buffer. Only safe while the consumer is
+ * stopped.
+ ******************************************************************************/
+void FlushSampleBuffer(void)
+{
+	ucSampleHead = ucSampleTail;
+}
+
+/******************************************************************************
+ * Sets the function the foreground loop calls to compute new samples for a
+ * channel. Pass 0 to stop producing for it. Nothing is produced once no
+ * channel has a producer.
+ ******************************************************************************/
+void SetSampleProducer(unsigned char ucChannel, unsigned int (*pfnProducer)(void))
+{
+	unsigned char i;
+
+	if (ucChannel >= DTOA_NUM_CHANNELS)
+	{
+		ReportError(PARAMETER_OUT_OF_RANGE);
+		return;
+	}
+
+	apfnSampleProducer[ucChannel] = pfnProducer;
+
+	ucNumProducers = 0;
+	for (i = 0; i < DTOA_NUM_CHANNELS; ++i)
+	{
+		if (apfnSampleProducer[i] != 0)
+		{
+			++ucNumProducers;
+		}
+	}
+}
+
+/******************************************************************************
+ * Tops up the buffer from the sample producer. Called from the foreground
+ * loop.
+ ******************************************************************************/
+void ServiceSampleBuffer(void)
+{
+	unsigned int (*pfnProducer)(void);
+	unsigned char ucSpace;
+	unsigned char i;
+
+	if (ucNumProducers == 0)
+	{
+		return;
+	}
+
+	for (ucSpace = GetSampleBufferSpace(); ucSpace > 0; --ucSpace)
+	{
+		for (i = 0; i < DTOA_NUM_CHANNELS; ++i)
+		{
+			pfnProducer = apfnSampleProducer[i];
+			if (pfnProducer != 0)
+			{
+				LastFrame.auiChannel[i] = pfnProducer();
+			}
+		}
+		PutSample(&LastFrame);
+	}
+}
+
+/******************************************************************************
+ * Returns TRUE if ServiceSampleBuffer has samples to make now. Called by
+ * IdleSleep with interrupts disabled.
+ ******************************************************************************/
+eBooleanType SampleBufferWorkPending(void)
+{
+	return ((ucNumProducers != 0) && (GetSampleBufferSpace() != 0)) ? TRUE : FALSE;
+}
+
+/******************************************************************************
+ * Returns fill statistics since they were last cleared: the highest and
+ * lowest number of samples waiting when the consumer took one, and the
+ * number of times it found the buffer empty.
+ ******************************************************************************/
+void GetSampleBufferStats(unsigned char *ptrHighWater,
+						  unsigned char *ptrLowWater,
+						  unsigned int *ptrUnderruns)
+{
+	unsigned char ucSREG;
+
+	*ptrHighWater = ucHighWater;
+	*ptrLowWater = ucLowWater;
+
+	// 16-bit read; don't let the consumer change it halfway through.
+	ucSREG = SREG;
+	cli();
+	*ptrUnderruns = uiUnderruns;
+	SREG = ucSREG;
+}
+
+/******************************************************************************
+ * Asks the consumer to clear the fill statistics before its next sample.
+ ******************************************************************************/
+void ClearSampleBufferStats(void)
+{
+	bClearStats = TRUE;
+}
@@ -0,0 +1,32 @@
+/******************************************************************************
+ * File Name:	samplebuf.h
+ * Program:		Project for Real-Time Embedded Systems Programming class
+ * Purpose:		Header file for samplebuf.c file.
+ ******************************************************************************/
+#if !defined(SAMPLEBUF_H)	/* Prevents including this file multiple times */
+#define SAMPLEBUF_H
+
+#include "lib.h"
+#include "dtoa.h"
+
+/* Number of entries in the sample buffer. Must be a power of 2, and no more
+ * than 128, so the indexes fit in one byte. One entry is always left empty,
+ * so the buffer holds SAMPLE_BUFFER_SIZE - 1 samples. Each entry is a
+ * frame, with a sample for every D/A channel. */
+#define SAMPLE_BUFFER_SIZE              64
+
+/* Function Prototypes */
+eBooleanType PutSample(const DtoAFrameType *);	// Foreground (producer) only
+eBooleanType GetSample(DtoAFrameType *);		// D/A ISR (consumer) only
+unsigned char GetSampleBufferSpace(void);
+void FlushSampleBuffer(void);
+void SetSampleProducer(unsigned char,				// D/A channel
+					   unsigned int (*)(void));
+void ServiceSampleBuffer(void);				// Called from foreground loop
+eBooleanType SampleBufferWorkPending(void);	// Called from IdleSleep
+void GetSampleBufferStats(unsigned char *,	// High-water mark
+						  unsigned char *,	// Low-water mark
+						  unsigned int *);	// Number of underruns
+void ClearSampleBufferStats(void);
+
+#endif /* SAMPLEBUF_H */
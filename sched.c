@@ -0,0 +1,225 @@
+/******************************************************************************
+ * File Name:	sched.c
+ * Program:		Project for Real-Time Embedded Systems Programming class
+ * Purpose:		Table-driven cooperative scheduler for the medium-thread
+ *				tasks.
+ *
+ *				The Timer 0 ISR calls SchedulerTick() once per tick. Each task
+ *				has a countdown, reloaded from its period when it reaches 0,
+ *				so no division is needed to decide what's due. Short tasks run
+ *				right there in the ISR. Everything else just gets a ready flag,
+ *				and RunScheduler(), called from the foreground loop, runs the
+ *				highest-priority ready task.
+ *
+ *				If a task comes due again before its last run has finished,
+ *				that's an overrun. It's counted for that task, and reported
+ *				as MEDIUM_TASK_OVERRUN, with the task's index in the table
+ *				as the error log context.
+ ******************************************************************************/
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+
+#include "lib.h"
+#include "errors.h"
+#include "config.h"
+#include "heartbeat.h"
+#include "menu.h"
+#include "display.h"
+#include "profile.h"
+#include "trace.h"
+#include "sched.h"
+
+/* Fixed part of a task table entry */
+typedef struct
+{
+	void (*pfnTask)(void);
+	unsigned char ucPeriod;		// Timer 0 ticks between runs
+	unsigned char ucPriority;	// 0 is highest
+	eBooleanType bInterrupt;	// TRUE to run from the tick ISR. Must be short.
+	unsigned char ucProfileId;	// eProfileIdType, for timing the task
+	PGM_P Name;
+} TaskType;
+
+static const char HeartbeatName[] PROGMEM = "heartbeat";
+static const char MenuName[] PROGMEM = "menu";
+static const char DisplayName[] PROGMEM = "display";
+
+/*
+ * The task table. Keep it sorted by priority, highest (0) first;
+ * RunScheduler runs the first ready task it finds.
+ */
+static const TaskType Tasks[] PROGMEM =
+{
+	{ heartbeat, TICKS_FOR_MS(HEARTBEAT_MS), 0, TRUE,
+	  PROFILE_HEARTBEAT, HeartbeatName },
+	{ RunMenu,   TICKS_FOR_MS(MENU_MS),      1, FALSE,
+	  PROFILE_MENU,      MenuName },
+	{ DisplayTask, TICKS_FOR_MS(DISPLAY_MS), 2, FALSE,
+	  PROFILE_DISPLAY,   DisplayName }
+};
+
+#define NUM_TASKS	(sizeof(Tasks)/sizeof(Tasks[0]))
+
+/* Changing part of the task table. The tick ISR sets bReady; the foreground
+ * clears it when it starts the task, and sets bRunning until it's done. */
+static unsigned char aucCountdown[NUM_TASKS];
+static volatile eBooleanType abReady[NUM_TASKS];
+static volatile eBooleanType abRunning[NUM_TASKS];
+static volatile unsigned int auiOverruns[NUM_TASKS];
+
+/* Ticks since reset. Wraps, so only differences are meaningful. */
+static volatile unsigned int uiTickCount = 0;
+
+/******************************************************************************
+ * Counts down each task's ticks, and runs or readies the ones that are due.
+ * Called from the Timer 0 ISR, so interrupts are disabled.
+ ******************************************************************************/
+void SchedulerTick(void)
+{
+	unsigned char i;
+	void (*pfnTask)(void);
+
+	++uiTickCount;
+
+	for (i = 0; i < NUM_TASKS; ++i)
+	{
+		if (aucCountdown[i] > 1)
+		{	// Not due yet
+			--aucCountdown[i];
+			continue;
+		}
+
+		aucCountdown[i] = pgm_read_byte(&Tasks[i].ucPeriod);
+
+		if (pgm_read_byte(&Tasks[i].bInterrupt) == TRUE)
+		{	// Short task. Run it now.
+			pfnTask = (void (*)(void))pgm_read_word(&Tasks[i].pfnTask);
+			{
+				PROFILE_START(pgm_read_byte(&Tasks[i].ucProfileId));
+				pfnTask();
+				PROFILE_END((eProfileIdType)pgm_read_byte(&Tasks[i].ucProfileId));
+			}
+		}
+		else
+		{	// Leave it for the foreground
+			if ((abReady[i] == TRUE) || (abRunning[i] == TRUE))
+			{	// Last run hasn't finished
+				if (auiOverruns[i] != 0xFFFF)
+				{
+					++auiOverruns[i];
+				}
+				ReportErrorContext(MEDIUM_TASK_OVERRUN, i);
+			}
+			abReady[i] = TRUE;
+		}
+	}
+}
+
+/******************************************************************************
+ * Runs the highest-priority ready task, if any. Called from the foreground
+ * loop; returning after one task lets a higher-priority task that became
+ * ready meanwhile go next.
+ ******************************************************************************/
+void RunScheduler(void)
+{
+	unsigned char i;
+	void (*pfnTask)(void);
+
+	for (i = 0; i < NUM_TASKS; ++i)
+	{
+		if (abReady[i] == TRUE)
+		{
+			abRunning[i] = TRUE;
+			abReady[i] = FALSE;
+			TRACE(SCHED, TRACE_DEBUG, TRACE_ID_SCHED_RUN, i);
+
+			pfnTask = (void (*)(void))pgm_read_word(&Tasks[i].pfnTask);
+			{
+				PROFILE_START(pgm_read_byte(&Tasks[i].ucProfileId));
+				pfnTask();
+				PROFILE_END((eProfileIdType)pgm_read_byte(&Tasks[i].ucProfileId));
+			}
+
+			abRunning[i] = FALSE;
+			return;
+		}
+	}
+}
+
+/******************************************************************************
+ * Returns TRUE if a foreground task is ready to run.
+ ******************************************************************************/
+eBooleanType SchedulerTaskReady(void)
+{
+	unsigned char i;
+
+	for (i = 0; i < NUM_TASKS; ++i)
+	{
+		if (abReady[i] == TRUE)
+		{
+			return TRUE;
+		}
+	}
+	return FALSE;
+}
+
+/******************************************************************************
+ * Returns the number of Timer 0 ticks since reset. It wraps every 65536
+ * ticks, so subtract two readings to time an interval.
+ ******************************************************************************/
+unsigned int GetTickCount(void)
+{
+	unsigned int uiTicks;
+	unsigned char ucSREG;
+
+	// 16-bit read; don't let the tick ISR change it halfway through.
+	ucSREG = SREG;
+	cli();
+	uiTicks = uiTickCount;
+	SREG = ucSREG;
+	return uiTicks;
+}
+
+/******************************************************************************
+ * Returns the number of entries in the task table.
+ ******************************************************************************/
+unsigned char GetNumTasks(void)
+{
+	return NUM_TASKS;
+}
+
+/******************************************************************************
+ * Copies the settings and statistics for the specified task.
+ ******************************************************************************/
+void GetTaskStats(unsigned char Task, TaskStatsType *ptrStats)
+{
+	unsigned char ucSREG;
+
+	ptrStats->Name = (PGM_P)pgm_read_word(&Tasks[Task].Name);
+	ptrStats->ucPeriod = pgm_read_byte(&Tasks[Task].ucPeriod);
+	ptrStats->ucPriority = pgm_read_byte(&Tasks[Task].ucPriority);
+	ptrStats->bInterrupt = (eBooleanType)pgm_read_byte(&Tasks[Task].bInterrupt);
+
+	// 16-bit read; don't let the tick ISR change it halfway through.
+	ucSREG = SREG;
+	cli();
+	ptrStats->uiOverruns = auiOverruns[Task];
+	SREG = ucSREG;
+}
+
+/******************************************************************************
+ * Clears the overrun counts.
+ ******************************************************************************/
+void ClearTaskStats(void)
+{
+	unsigned char i;
+	unsigned char ucSREG;
+
+	for (i = 0; i < NUM_TASKS; ++i)
+	{
+		ucSREG = SREG;
+		cli();
+		auiOverruns[i] = 0;
+		SREG = ucSREG;
+	}
+}
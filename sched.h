@@ -0,0 +1,32 @@
+/******************************************************************************
+ * File Name:	sched.h
+ * Program:		Project for Real-Time Embedded Systems Programming class
+ * Purpose:		Header file for sched.c file.
+ ******************************************************************************/
+#if !defined(SCHED_H)		/* Prevents including this file multiple times */
+#define SCHED_H
+
+#include <avr/pgmspace.h>
+
+#include "lib.h"
+
+/* Task statistics, for display */
+typedef struct
+{
+	PGM_P Name;
+	unsigned char ucPeriod;		// Timer 0 ticks between runs
+	unsigned char ucPriority;	// 0 is highest
+	eBooleanType bInterrupt;	// TRUE if the task runs in the tick ISR
+	unsigned int uiOverruns;	// Times the task was due before it had run
+} TaskStatsType;
+
+/* Function Prototypes */
+void SchedulerTick(void);			// Called from Timer 0 ISR
+void RunScheduler(void);			// Called from foreground loop
+eBooleanType SchedulerTaskReady(void);
+unsigned int GetTickCount(void);
+unsigned char GetNumTasks(void);
+void GetTaskStats(unsigned char, TaskStatsType *);
+void ClearTaskStats(void);
+
+#endif /* SCHED_H */
@@ -0,0 +1,583 @@
+/******************************************************************************
+ * File Name:	sequence.c
+ * Program:		Project for Real-Time Embedded Systems Programming class
+ * Purpose:		Sequences for DDS mode: frequency chirps, amplitude steps and
+ *				bursts, one at a time from a menu command, or a script of
+ *				them from flash. Everything is worked out here, in the
+ *				foreground, when a segment starts; the sample ISR only adds a
+ *				fixed step to the phase step every sample (see
+ *				SetWaveSegment), so it costs the same at every frequency.
+ *
+ *				A linear chirp is one such step, for the whole segment. A log
+ *				chirp is made of one linear piece per tick, each with the
+ *				same frequency ratio; the next piece is always waiting, and
+ *				the ISR starts it the sample after the last one ends.
+ ******************************************************************************/
+#include <string.h>
+#include <avr/pgmspace.h>
+
+#include "lib.h"
+#include "config.h"
+#include "errors.h"
+#include "sched.h"
+#include "trace.h"
+#include "waveform.h"
+#include "sequence.h"
+
+/* Samples in each piece of a log chirp: about a tick's worth */
+#define SEQ_PIECE_SAMPLES			((DDS_SAMPLE_RATE * TIMER0_TICK_MS) / 1000UL)
+
+/* Log chirp exponents are fixed point, with this many fraction bits */
+#define SEQ_LOG_BITS				16
+
+typedef enum
+{
+	SEQ_IDLE = 0,
+	SEQ_PLAYING,
+	SEQ_GAP					// Between bursts
+} eSeqStateType;
+
+/* 2^(2^-(i+1)), as 2.30 fixed-point numbers, for ScaleByPowerOf2 */
+static const unsigned long PowerOf2Table[SEQ_LOG_BITS] PROGMEM =
+{
+	0x5A82799AUL, 0x4C1BF829UL, 0x45CAE0F2UL, 0x42D561B4UL,
+	0x4166C34CUL, 0x40B268FAUL, 0x4058F6A8UL, 0x402C6BE9UL,
+	0x4016321BUL, 0x400B1818UL, 0x40058BCEUL, 0x4002C5D8UL,
+	0x400162E8UL, 0x4000B173UL, 0x400058B9UL, 0x40002C5DUL
+};
+
+/*
+ * Scripts: { type, repeat, mSecs, count, amplitude, end amplitude,
+ * frequency, end frequency }. Each ends with SEQ_END or SEQ_LOOP.
+ */
+
+/* 0: production test. Log sweep 20 Hz to 8 kHz, amplitude steps at 1 kHz,
+ * then ten bursts of ten periods. */
+static const SeqSegmentType Script0[] PROGMEM =
+{
+	{ SEQ_CHIRP_LOG,       1,  10000,  0, 1023,    0,   20000UL, 8000000UL },
+	{ SEQ_AMPLITUDE_STEPS, 1,    500, 11,    0, 1023, 1000000UL,       0UL },
+	{ SEQ_BURST,          10,    100, 10, 1023,    0, 1000000UL,       0UL },
+	{ SEQ_END,             0,      0,  0,    0,    0,       0UL,       0UL }
+};
+
+/* 1: linear sweep 100 Hz to 5 kHz and back, until stopped */
+static const SeqSegmentType Script1[] PROGMEM =
+{
+	{ SEQ_CHIRP_LINEAR,    1,   2000,  0, 1023,    0,  100000UL, 5000000UL },
+	{ SEQ_CHIRP_LINEAR,    1,   2000,  0, 1023,    0, 5000000UL,  100000UL },
+	{ SEQ_LOOP,            0,      0,  0,    0,    0,       0UL,       0UL }
+};
+
+static const SeqSegmentType * const Scripts[SEQ_NUM_SCRIPTS] PROGMEM =
+{
+	Script0, Script1
+};
+
+/* The script playing, or 0 for a single segment, and the segment playing */
+static const SeqSegmentType *ptrScript = 0;
+static unsigned char ucScriptIndex = 0;
+static SeqSegmentType Segment;
+static WaveSegmentType SeqWave;				// What Segment is played as
+
+static eSeqStateType SeqState = SEQ_IDLE;
+static unsigned char ucRepeatsLeft = 0;		// 0 = until stopped
+static unsigned int uiStep = 0;				// Amplitude step, or chirp piece
+static unsigned int uiStepStart = 0;		// Tick it started
+static unsigned int uiStepTicks = 0;		// How long it lasts
+
+// Log chirps
+static unsigned long ulStartIncrement = 0;
+static unsigned long ulPieceEnd = 0;		// Phase step at the end of a piece
+static long lLogRatio = 0;					// log2(end / start), fixed point
+
+static eErrorType CheckSegment(const SeqSegmentType *ptrSegment);
+static eErrorType BeginSequence(void);
+static void LoadSegment(void);
+static void PlaySegment(void);
+static void EndRepeat(void);
+static void SetLogPiece(void);
+static unsigned int StepAmplitude(unsigned int uiIndex);
+static unsigned int TicksForMs(unsigned int uiMs);
+static long Log2Fixed(unsigned long X);
+static unsigned long ScaleByPowerOf2(unsigned long X, long Exponent);
+
+/******************************************************************************
+ * Plays one segment, then goes back to the frequency and amplitude settings.
+ * Switches to DDS mode, and to a sine wave if the output is off.
+ ******************************************************************************/
+eErrorType StartSequence(const SeqSegmentType *ptrSegment)
+{
+	eErrorType Error;
+
+	Error = CheckSegment(ptrSegment);
+	if (Error != NO_ERROR)
+	{
+		return Error;
+	}
+	if (ptrSegment->ucType <= SEQ_LOOP)
+	{	// Only mean something in a script
+		return INVALID_PARAMETER;
+	}
+
+	ptrScript = 0;
+	ucScriptIndex = 0;
+	Segment = *ptrSegment;
+	ucRepeatsLeft = Segment.ucRepeat;
+	return BeginSequence();
+}
+
+/******************************************************************************
+ * Plays one of the scripts built in, 0 to SEQ_NUM_SCRIPTS - 1. Every segment
+ * is checked before it starts.
+ ******************************************************************************/
+eErrorType StartScript(unsigned char ucScript)
+{
+	const SeqSegmentType *ptrSegment;
+	SeqSegmentType Check;
+	eErrorType Error;
+
+	if (ucScript >= SEQ_NUM_SCRIPTS)
+	{
+		return PARAMETER_OUT_OF_RANGE;
+	}
+
+	ptrSegment = (const SeqSegmentType *)pgm_read_word(&Scripts[ucScript]);
+	memcpy_P(&Check, ptrSegment, sizeof(Check));
+	if (Check.ucType == SEQ_LOOP)
+	{	// Would loop without playing anything
+		return INVALID_PARAMETER;
+	}
+	for ( ; ; )
+	{
+		Error = CheckSegment(&Check);
+		if (Error != NO_ERROR)
+		{
+			return Error;
+		}
+		if (Check.ucType <= SEQ_LOOP)
+		{
+			break;
+		}
+		memcpy_P(&Check, ++ptrSegment, sizeof(Check));
+	}
+
+	ptrScript = (const SeqSegmentType *)pgm_read_word(&Scripts[ucScript]);
+	ucScriptIndex = 0;
+	memcpy_P(&Segment, ptrScript, sizeof(Segment));
+	if (Segment.ucType == SEQ_END)
+	{	// Nothing in it
+		ptrScript = 0;
+		return NO_ERROR;
+	}
+	ucRepeatsLeft = Segment.ucRepeat;
+	return BeginSequence();
+}
+
+/******************************************************************************
+ * Stops any sequence, and goes back to the frequency and amplitude settings.
+ ******************************************************************************/
+void StopSequence(void)
+{
+	if (SeqState == SEQ_IDLE)
+	{
+		return;
+	}
+	SeqState = SEQ_IDLE;
+	ptrScript = 0;
+	SetWaveSegment(0);
+}
+
+/******************************************************************************
+ * Returns TRUE while a sequence is playing.
+ ******************************************************************************/
+eBooleanType SequenceRunning(void)
+{
+	return (SeqState != SEQ_IDLE) ? TRUE : FALSE;
+}
+
+/******************************************************************************
+ * Moves the sequence on: the next log chirp piece, amplitude step, burst or
+ * segment. Called from the foreground loop. A log chirp needs a piece every
+ * tick, so nothing else in the loop may take that long.
+ ******************************************************************************/
+void ServiceSequence(void)
+{
+	WaveStatusType Status;
+	unsigned int uiElapsed;
+
+	if (SeqState == SEQ_IDLE)
+	{
+		return;
+	}
+
+	GetWaveStatus(&Status);
+	if ((Status.Mode != WAVE_MODE_DDS) || (Status.Shape == WAVE_OFF))
+	{	// Changed from the menu. That's the end of it.
+		StopSequence();
+		return;
+	}
+
+	uiElapsed = (unsigned int)(GetTickCount() - uiStepStart);
+	if (SeqState == SEQ_GAP)
+	{
+		if (uiElapsed >= uiStepTicks)
+		{
+			EndRepeat();
+		}
+		return;
+	}
+
+	switch (Segment.ucType)
+	{
+		case SEQ_CHIRP_LOG:
+			// Once the last piece has started, it ends the segment itself
+			if (WaveSegmentPending() == FALSE)
+			{
+				if (uiStep < uiStepTicks)
+				{
+					SetLogPiece();
+					SetWaveSegment(&SeqWave);
+				}
+				else
+				{
+					EndRepeat();
+				}
+			}
+			break;
+
+		case SEQ_AMPLITUDE_STEPS:
+			if (uiElapsed >= uiStepTicks)
+			{
+				if (++uiStep >= Segment.uiCount)
+				{
+					EndRepeat();
+				}
+				else
+				{
+					uiStepStart += uiStepTicks;
+					SeqWave.uiAmplitude = StepAmplitude(uiStep);
+					SetWaveSegment(&SeqWave);
+				}
+			}
+			break;
+
+		case SEQ_BURST:
+			if (WaveBurstDone() == TRUE)
+			{	// The gap is timed from the end of the burst
+				SeqState = SEQ_GAP;
+				uiStepStart = GetTickCount();
+			}
+			break;
+
+		default:	// SEQ_TONE and SEQ_CHIRP_LINEAR
+			if (uiElapsed >= uiStepTicks)
+			{	// A chirp still going finishes before the next segment starts
+				EndRepeat();
+			}
+			break;
+	}
+}
+
+/******************************************************************************
+ * Returns TRUE if ServiceSequence has something to do now: the next log
+ * chirp piece, or the end of a step, burst or gap. Called by IdleSleep with
+ * interrupts disabled.
+ ******************************************************************************/
+eBooleanType SequenceWorkPending(void)
+{
+	if (SeqState == SEQ_IDLE)
+	{
+		return FALSE;
+	}
+
+	if (SeqState == SEQ_PLAYING)
+	{
+		if (Segment.ucType == SEQ_CHIRP_LOG)
+		{
+			return (WaveSegmentPending() == FALSE) ? TRUE : FALSE;
+		}
+		if (Segment.ucType == SEQ_BURST)
+		{
+			return WaveBurstDone();
+		}
+	}
+	return ((unsigned int)(GetTickCount() - uiStepStart) >= uiStepTicks) ?
+			TRUE : FALSE;
+}
+
+/******************************************************************************
+ * Returns NO_ERROR if a segment can be played, or why not.
+ ******************************************************************************/
+static eErrorType CheckSegment(const SeqSegmentType *ptrSegment)
+{
+	if (ptrSegment->ucType > SEQ_BURST)
+	{
+		return INVALID_PARAMETER;
+	}
+	if (ptrSegment->ucType <= SEQ_LOOP)
+	{
+		return NO_ERROR;
+	}
+
+	if ((ptrSegment->ulFrequency < (WAVE_MIN_FREQUENCY * WAVE_FREQ_SCALE)) ||
+		(ptrSegment->ulFrequency > (DDS_MAX_FREQUENCY * WAVE_FREQ_SCALE)) ||
+		(ptrSegment->uiAmplitude > WAVE_MAX_AMPLITUDE))
+	{
+		return PARAMETER_OUT_OF_RANGE;
+	}
+
+	if (((ptrSegment->ucType == SEQ_CHIRP_LINEAR) ||
+		 (ptrSegment->ucType == SEQ_CHIRP_LOG)) &&
+		((ptrSegment->ulEndFrequency < (WAVE_MIN_FREQUENCY * WAVE_FREQ_SCALE)) ||
+		 (ptrSegment->ulEndFrequency > (DDS_MAX_FREQUENCY * WAVE_FREQ_SCALE))))
+	{
+		return PARAMETER_OUT_OF_RANGE;
+	}
+
+	if ((ptrSegment->ucType == SEQ_AMPLITUDE_STEPS) &&
+		((ptrSegment->uiEndAmplitude > WAVE_MAX_AMPLITUDE) ||
+		 (ptrSegment->uiCount == 0)))
+	{
+		return PARAMETER_OUT_OF_RANGE;
+	}
+
+	if ((ptrSegment->ucType == SEQ_BURST) && (ptrSegment->uiCount == 0))
+	{
+		return PARAMETER_OUT_OF_RANGE;
+	}
+	return NO_ERROR;
+}
+
+/******************************************************************************
+ * Gets the generator ready, then plays the first segment.
+ ******************************************************************************/
+static eErrorType BeginSequence(void)
+{
+	WaveStatusType Status;
+
+	// Only change what has to, since each change restarts the generator
+	GetWaveStatus(&Status);
+	if (Status.Mode != WAVE_MODE_DDS)
+	{
+		SetWaveMode(WAVE_MODE_DDS);
+	}
+	if (Status.Shape == WAVE_OFF)
+	{
+		SetWaveShape(WAVE_SINE);
+	}
+
+	PlaySegment();
+	return NO_ERROR;
+}
+
+/******************************************************************************
+ * Plays the script's segment at ucScriptIndex, going back to the start at a
+ * SEQ_LOOP, or stops at a SEQ_END.
+ ******************************************************************************/
+static void LoadSegment(void)
+{
+	memcpy_P(&Segment, &ptrScript[ucScriptIndex], sizeof(Segment));
+	if (Segment.ucType == SEQ_LOOP)
+	{	// StartScript made sure the first isn't a SEQ_LOOP too
+		ucScriptIndex = 0;
+		memcpy_P(&Segment, ptrScript, sizeof(Segment));
+	}
+	if (Segment.ucType == SEQ_END)
+	{
+		StopSequence();
+		return;
+	}
+	ucRepeatsLeft = Segment.ucRepeat;
+	PlaySegment();
+}
+
+/******************************************************************************
+ * Works out how to play Segment, and starts it.
+ ******************************************************************************/
+static void PlaySegment(void)
+{
+	unsigned long ulEndIncrement;
+
+	SeqState = SEQ_PLAYING;
+	uiStep = 0;
+	uiStepStart = GetTickCount();
+	uiStepTicks = TicksForMs(Segment.uiDuration);
+
+	SeqWave.ulIncrement = GetWavePhaseStep(Segment.ulFrequency);
+	SeqWave.lStep = 0;
+	SeqWave.ulSteps = 0;
+	SeqWave.uiAmplitude = Segment.uiAmplitude;
+	SeqWave.uiCycles = 0;
+
+	switch (Segment.ucType)
+	{
+		case SEQ_CHIRP_LINEAR:
+			/* The step is rounded toward 0, so the chirp can end a little
+			 * short; the next segment starts from the right frequency. At
+			 * most 65535 mSecs at 20 kHz, so the count fits in 32 bits. */
+			ulEndIncrement = GetWavePhaseStep(Segment.ulEndFrequency);
+			SeqWave.ulSteps = ((unsigned long)Segment.uiDuration *
+							   DDS_SAMPLE_RATE) / 1000UL;
+			if (SeqWave.ulSteps != 0)
+			{
+				SeqWave.lStep = ((long)ulEndIncrement - (long)SeqWave.ulIncrement) /
+								(long)SeqWave.ulSteps;
+			}
+			break;
+
+		case SEQ_CHIRP_LOG:
+			// One piece per tick, each with the same ratio
+			ulStartIncrement = SeqWave.ulIncrement;
+			ulPieceEnd = SeqWave.ulIncrement;
+			lLogRatio = Log2Fixed(GetWavePhaseStep(Segment.ulEndFrequency)) -
+						Log2Fixed(ulStartIncrement);
+			SetLogPiece();
+			break;
+
+		case SEQ_BURST:
+			SeqWave.uiCycles = Segment.uiCount;
+			break;
+
+		default:	// SEQ_TONE, and SEQ_AMPLITUDE_STEPS at its first step
+			break;
+	}
+
+	SetWaveSegment(&SeqWave);
+	TRACE(WAVE, TRACE_INFO, TRACE_ID_SEQ_SEGMENT,
+		  ((unsigned int)ucScriptIndex << 8) | Segment.ucType);
+}
+
+/******************************************************************************
+ * Plays the segment again, or moves on to the next one.
+ ******************************************************************************/
+static void EndRepeat(void)
+{
+	if ((ucRepeatsLeft == 0) || (--ucRepeatsLeft != 0))
+	{
+		PlaySegment();
+	}
+	else if (ptrScript == 0)
+	{	// That was the only one
+		StopSequence();
+	}
+	else
+	{
+		++ucScriptIndex;
+		LoadSegment();
+	}
+}
+
+/******************************************************************************
+ * Sets SeqWave for the next piece of a log chirp. Piece n ends at
+ * start * 2^(lLogRatio * n / pieces).
+ ******************************************************************************/
+static void SetLogPiece(void)
+{
+	long lPieces = (long)uiStepTicks;
+	long lExponent;
+
+	++uiStep;
+	// Split up, so lLogRatio * uiStep can't overflow
+	lExponent = ((lLogRatio / lPieces) * (long)uiStep) +
+				(((lLogRatio % lPieces) * (long)uiStep) / lPieces);
+
+	SeqWave.ulIncrement = ulPieceEnd;
+	ulPieceEnd = ScaleByPowerOf2(ulStartIncrement, lExponent);
+	SeqWave.lStep = ((long)ulPieceEnd - (long)SeqWave.ulIncrement) /
+					(long)SEQ_PIECE_SAMPLES;
+	SeqWave.ulSteps = SEQ_PIECE_SAMPLES;
+}
+
+/******************************************************************************
+ * Returns the amplitude for a step of SEQ_AMPLITUDE_STEPS, evenly spread from
+ * the first amplitude to the last.
+ ******************************************************************************/
+static unsigned int StepAmplitude(unsigned int uiIndex)
+{
+	long lRange;
+
+	if (Segment.uiCount < 2)
+	{
+		return Segment.uiAmplitude;
+	}
+	lRange = (long)Segment.uiEndAmplitude - (long)Segment.uiAmplitude;
+	return (unsigned int)((long)Segment.uiAmplitude +
+						  ((lRange * (long)uiIndex) / (long)(Segment.uiCount - 1)));
+}
+
+/******************************************************************************
+ * Returns the number of ticks in a time, rounded up, and at least 1.
+ ******************************************************************************/
+static unsigned int TicksForMs(unsigned int uiMs)
+{
+	unsigned int uiTicks = uiMs / TIMER0_TICK_MS;
+
+	if (((uiMs % TIMER0_TICK_MS) != 0) || (uiTicks == 0))
+	{
+		++uiTicks;
+	}
+	return uiTicks;
+}
+
+/******************************************************************************
+ * Returns log2(X), for X > 0, with SEQ_LOG_BITS fraction bits. X is scaled to
+ * between 1 and 2, then each squaring gives the next bit of the fraction.
+ ******************************************************************************/
+static long Log2Fixed(unsigned long X)
+{
+	long Result = 31;
+	unsigned char i;
+
+	// X is now 1.31 fixed point, between 1 and 2
+	while ((X & 0x80000000UL) == 0)
+	{
+		X <<= 1;
+		--Result;
+	}
+
+	for (i = 0; i < SEQ_LOG_BITS; ++i)
+	{
+		// 2.30 fixed point. 2 or more means a 1, and is X / 2 as 1.31.
+		X = MultiplyHigh(X, X);
+		Result <<= 1;
+		if ((X & 0x80000000UL) != 0)
+		{
+			Result |= 1;
+		}
+		else
+		{
+			X <<= 1;
+		}
+	}
+	return Result;
+}
+
+/******************************************************************************
+ * Returns X * 2^Exponent, with SEQ_LOG_BITS fraction bits in Exponent, for
+ * X < 2^31 and results that fit in 32 bits. The fraction's bits each pick a
+ * factor from PowerOf2Table, and the whole part is a shift.
+ ******************************************************************************/
+static unsigned long ScaleByPowerOf2(unsigned long X, long Exponent)
+{
+	unsigned long Scale = 0x40000000UL;		// 1.0, as 2.30 fixed point
+	unsigned int uiFraction;
+	int Shift;
+	unsigned char i;
+
+	// Offset, so the whole part rounds down without shifting a negative
+	Exponent += 32L << SEQ_LOG_BITS;
+	Shift = (int)(Exponent >> SEQ_LOG_BITS) - 32;
+	uiFraction = (unsigned int)(Exponent & ((1L << SEQ_LOG_BITS) - 1));
+
+	for (i = 0; i < SEQ_LOG_BITS; ++i)
+	{
+		if ((uiFraction & (0x8000U >> i)) != 0)
+		{
+			Scale = MultiplyHigh(Scale, pgm_read_dword(&PowerOf2Table[i])) << 2;
+		}
+	}
+
+	X = MultiplyHigh(X, Scale) << 2;
+	return (Shift >= 0) ? (X << Shift) : (X >> -Shift);
+}
@@ -0,0 +1,49 @@
+/******************************************************************************
+ * File Name:	sequence.h
+ * Program:		Project for Real-Time Embedded Systems Programming class
+ * Purpose:		Header file for sequence.c file.
+ ******************************************************************************/
+#if !defined(SEQUENCE_H)	/* Prevents including this file multiple times */
+#define SEQUENCE_H
+
+#include "lib.h"
+#include "errors.h"
+
+typedef enum
+{
+	SEQ_END = 0,			// End of a script
+	SEQ_LOOP,				// Go back to the start of the script
+	SEQ_TONE,				// ulFrequency, for uiDuration mSecs
+	SEQ_CHIRP_LINEAR,		// ulFrequency to ulEndFrequency in uiDuration mSecs
+	SEQ_CHIRP_LOG,			// The same, with the same ratio every tick
+	SEQ_AMPLITUDE_STEPS,	// uiCount steps, uiAmplitude to uiEndAmplitude,
+							// uiDuration mSecs each
+	SEQ_BURST				// uiCount periods, then uiDuration mSecs silence
+} eSeqType;
+
+/* One segment of a sequence. Frequencies are in mHz, as for
+ * SetWaveFrequencyFine, and amplitudes are peak to peak in D/A counts. */
+typedef struct
+{
+	unsigned char ucType;			// eSeqType
+	unsigned char ucRepeat;			// Times to play it; 0 = until stopped
+	unsigned int uiDuration;		// mSecs
+	unsigned int uiCount;
+	unsigned int uiAmplitude;
+	unsigned int uiEndAmplitude;	// SEQ_AMPLITUDE_STEPS only
+	unsigned long ulFrequency;
+	unsigned long ulEndFrequency;	// Chirps only
+} SeqSegmentType;
+
+/* Number of scripts built in, for StartScript */
+#define SEQ_NUM_SCRIPTS                 2
+
+/* Function Prototypes */
+eErrorType StartSequence(const SeqSegmentType *);	// One segment, from RAM
+eErrorType StartScript(unsigned char);
+void StopSequence(void);
+eBooleanType SequenceRunning(void);
+void ServiceSequence(void);					// Called from foreground loop
+eBooleanType SequenceWorkPending(void);		// Called from IdleSleep
+
+#endif /* SEQUENCE_H */
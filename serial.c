@@ -18,36 +18,202 @@
  *							Replaced OSC_FREQ with F_CPU.
  * 01 Nov 10	T Lill		Converted program to ATmega2560
  ******************************************************************************/
+#include <string.h>
 #include <avr/io.h>
 #include <avr/interrupt.h>
 
 #include "lib.h"
+#include "config.h"
 #include "serial.h"
 #include "errors.h"
+#include "profile.h"
+#include "msgs.h"
 
-// Calculate Baud Rate values. Note that UBRR_VALUE should be < 4095. 
-// No check is made to verify this.
-// For F_CPU = 8 MHz, UBBR = 207, which is OK.
-#define BAUD_RATE			2400
-#define UART_CLOCK_DIVIDER	16
-#define UBRR_VALUE 		(((F_CPU/UART_CLOCK_DIVIDER)/BAUD_RATE) - 1)
+/* Table entry for a rate; see config.h for the calculations */
+#define BAUD_ENTRY(baud)		{ (baud), BAUD_UBRR(baud), BAUD_USE_U2X(baud) }
 
-/* Macros for moving character buffer pointers */
-#define INC_CIRC_BUFFER_PTR(ptr, Addr, Length)	            \
-    ((ptr >= Addr + Length - 1) ? Addr : ptr+1)
+typedef struct
+{
+	unsigned long ulBaud;
+	unsigned int uiUBRR;
+	unsigned char bDoubleSpeed;
+} BaudRateType;
+
+/* Rates that can be selected at run time. Rates F_CPU can't generate within
+ * MAX_BAUD_ERROR are left out; at 8 MHz, that's 57600 and 115200. */
+static const BaudRateType BaudRates[] PROGMEM =
+{
+#if BAUD_OK(2400UL)
+	BAUD_ENTRY(2400UL),
+#endif
+#if BAUD_OK(9600UL)
+	BAUD_ENTRY(9600UL),
+#endif
+#if BAUD_OK(19200UL)
+	BAUD_ENTRY(19200UL),
+#endif
+#if BAUD_OK(38400UL)
+	BAUD_ENTRY(38400UL),
+#endif
+#if BAUD_OK(57600UL)
+	BAUD_ENTRY(57600UL),
+#endif
+#if BAUD_OK(115200UL)
+	BAUD_ENTRY(115200UL),
+#endif
+#if BAUD_OK(250000UL)
+	BAUD_ENTRY(250000UL),
+#endif
+#if BAUD_OK(500000UL)
+	BAUD_ENTRY(500000UL),
+#endif
+#if BAUD_OK(1000000UL)
+	BAUD_ENTRY(1000000UL),
+#endif
+};
+
+#define NUM_BAUD_RATES		(sizeof(BaudRates) / sizeof(BaudRates[0]))
+
+/* Rate waiting to be set once the transmitter is idle */
+static const BaudRateType *ptrPendingBaud = 0;
+
+/*
+ * Output is queued as descriptors, each a block of bytes that the UDRE ISR
+ * sends straight from where it is:
+ *   TX_FLASH  - program memory, from SCIWriteString_P. Never copied.
+ *   TX_STATIC - RAM that stays unchanged until it's sent, from
+ *               SCIWriteStatic. Never copied.
+ *   TX_RING   - bytes copied into zOutputChars, for data in buffers the
+ *               caller reuses at once, such as strings on the stack.
+ *               Consecutive ring writes share one descriptor.
+ * Both queues are a power of 2 in size, so the indexes wrap with a mask. The
+ * foreground only writes the Head indexes and the ISR only writes the Tail
+ * indexes, and each index is one byte, so reading one is atomic.
+ */
+#define TX_QUEUE_INDEX(index)	((index) & (SCI_TX_QUEUE_SIZE - 1))
+#define TX_RING_INDEX(index)	((index) & (SCI_TX_RING_SIZE - 1))
+#define TX_QUEUE_EMPTY()		(ucTxQueueHead == ucTxQueueTail)
+
+typedef enum
+{
+	TX_RING = 0,
+	TX_STATIC,
+	TX_FLASH
+} TxSourceType;
+
+typedef struct
+{
+	const char *ptrData;		// Not used for TX_RING
+	unsigned int uiLength;		// Bytes left to send. Never 0 while queued.
+	unsigned char ucSource;		// TxSourceType
+} TxDescriptorType;
+
+static TxDescriptorType aTxQueue[SCI_TX_QUEUE_SIZE];
+static volatile unsigned char ucTxQueueHead = 0;
+static volatile unsigned char ucTxQueueTail = 0;
+
+static char zOutputChars[SCI_TX_RING_SIZE];
+static volatile unsigned char ucTxRingHead = 0;
+static volatile unsigned char ucTxRingTail = 0;
+
+/* When TRUE, writes wait for room rather than failing */
+static eBooleanType bTxBlocking = FALSE;
 
 /*
- * Define output string variables.  The Head and Tail pointers - but not the
- * data being pointed to - need to be volatile.
+ * Input is kept in a ring, a power of 2 in size so the indexes wrap with a
+ * mask. As for output, the RX ISR only writes the Head index and
+ * SCIReadChar only writes the Tail index.
  */
-static char zOutputChars[MAX_OUT_STR_SIZE];
-static char * volatile ptrOutputCharHead;		
-static char * volatile ptrOutputCharTail;
+#define RX_RING_INDEX(index)	((index) & (SCI_RX_RING_SIZE - 1))
+#define RX_RING_COUNT()			RX_RING_INDEX(ucRxRingHead - ucRxRingTail)
+
+#if (SCI_RX_RING_SIZE & (SCI_RX_RING_SIZE - 1)) != 0
+#error "SCI_RX_RING_SIZE must be a power of 2"
+#endif
+
+#if (SCI_FLOW_CONTROL != SCI_FLOW_NONE) && (SCI_RX_STOP_LEVEL <= SCI_RX_START_LEVEL)
+#error "SCI_RX_RING_SIZE is too small for flow control"
+#endif
+
+/* Define input ring variables */
+static char zInputChars[SCI_RX_RING_SIZE];
+static volatile unsigned char ucRxRingHead = 0;
+static volatile unsigned char ucRxRingTail = 0;
+
+/* TRUE while the host has been told to stop sending */
+static volatile eBooleanType bRxStopped = FALSE;
+
+#if SCI_FLOW_CONTROL == SCI_FLOW_XONXOFF
+/* XON or XOFF waiting to go out ahead of the transmit queue, or 0. The UDRE
+ * ISR runs with interrupts enabled; while it does, bInTxISR is TRUE, and the
+ * RX ISR leaves it to that ISR to re-enable the UDRE interrupt. */
+static volatile unsigned char ucTxFlowChar = 0;
+static volatile eBooleanType bInTxISR = FALSE;
+#endif
+
+/* Receive fault counts, in eSCIFaultType order. Only the RX ISR changes
+ * them, and each stops at 0xFFFF. */
+static volatile unsigned int auiRxFaults[SCI_NUM_FAULTS];
+
+/* When set, received bytes go to this function, from the RX ISR, instead of
+ * the input buffer. Its second argument is TRUE if the byte had a framing,
+ * overrun or parity error. */
+static void (* volatile pfnRxHandler)(unsigned char, eBooleanType) = 0;
+
+/******************************************************************************
+ * Tells the host to stop sending (TRUE), or to go on (FALSE). Called with
+ * interrupts disabled.
+ ******************************************************************************/
+static void SetRxFlow(eBooleanType bStop)
+{
+	bRxStopped = bStop;
+
+#if SCI_FLOW_CONTROL == SCI_FLOW_XONXOFF
+	ucTxFlowChar = (bStop == TRUE) ? SCI_XOFF : SCI_XON;
+	if (bInTxISR == FALSE)
+	{
+		SET_BIT(UCSR0B, UDRIE0);
+	}
+#elif SCI_FLOW_CONTROL == SCI_FLOW_RTS
+	if (bStop == TRUE)
+	{
+		SET_BIT(SCI_RTS_PORT, SCI_RTS_BIT);
+	}
+	else
+	{
+		CLEAR_BIT(SCI_RTS_PORT, SCI_RTS_BIT);
+	}
+#endif
+}
 
-/* Define input string variables */
-static char zInputChars[MAX_IN_STR_SIZE];
-static char * volatile ptrInputCharHead;
-static char * volatile ptrInputCharTail;
+/******************************************************************************
+ * Counts a receive fault, and reports it. Called from the RX ISR.
+ ******************************************************************************/
+static void CountRxFault(eSCIFaultType Fault, eErrorType Error)
+{
+	if (auiRxFaults[Fault] != 0xFFFF)
+	{
+		++auiRxFaults[Fault];
+	}
+	ReportError(Error);
+}
+
+/******************************************************************************
+ * Sets the baud rate registers from a BaudRates[] entry.
+ ******************************************************************************/
+static void SetBaudRegisters(const BaudRateType *ptrBaud)
+{
+	UBRR0 = pgm_read_word(&ptrBaud->uiUBRR);
+
+	if (pgm_read_byte(&ptrBaud->bDoubleSpeed) != 0)
+	{
+		SET_BIT(UCSR0A, U2X0);
+	}
+	else
+	{
+		CLEAR_BIT(UCSR0A, U2X0);
+	}
+}
 
 /******************************************************************************
  * Initialize the SCI interface.
@@ -55,7 +221,7 @@ static char * volatile ptrInputCharTail;
 void SCIInitialize(void)
 {
 	// Set the baud rate 
-	UBRR0 = UBRR_VALUE;
+	UBRR0 = BAUD_UBRR(BAUD_RATE);
 	
 	/* Setup the frame format
 	 * UCSRC: 
@@ -85,28 +251,36 @@ void SCIInitialize(void)
 
 	/* UCSR0A: 
 	 *   Bit 7: RXC0  = 0, Receive complete
-	 *       6: TXC0  = 0, Transmit complete
+	 *       6: TXC0  = 1, Clears transmit complete, written as a 1
 	 *       5: UDRE0 = 0, Read-only bit
 	 *       4: FE0   = 0, Read-only bit
 	 *       3: DOR0  = 0, Read-only bit
 	 *       2: UPE0  = 0, Read-only bit
-	 *       1: U2X0  = 0, Do not want to double TX rate
+	 *       1: U2X0  = ?, Double speed if it gives a more accurate rate
 	 *       0: MPCM0 = 0, No multi-processor mode
 	 */
-	UCSR0A = 0;
+	UCSR0A = (BAUD_USE_U2X(BAUD_RATE) ? _BV(U2X0) : 0) | _BV(TXC0);
 
-   /* Initialize the pointers to the character buffers. New characters to be
-     * received or transmitted are  added using the Head pointer. When characters
+#if SCI_FLOW_CONTROL == SCI_FLOW_RTS
+	// RTS starts low, so the host may send
+	CLEAR_BIT(SCI_RTS_PORT, SCI_RTS_BIT);
+	SET_BIT(SCI_RTS_DDR, SCI_RTS_BIT);
+#endif
+
+   /* Initialize the indexes of the character buffers. New characters to be
+     * received or transmitted are  added using the Head index. When characters
      * retrieved by an outside program or transmitted by the transmitter, they're
-     * removed from the buffers using the Tail pointer. */
-    ptrInputCharHead    = zInputChars;
-    ptrInputCharTail    = zInputChars;
-    ptrOutputCharHead   = zOutputChars;
-    ptrOutputCharTail   = zOutputChars;
+     * removed from the buffers using the Tail index. */
+    ucRxRingHead        = 0;
+    ucRxRingTail        = 0;
+    ucTxQueueHead       = 0;
+    ucTxQueueTail       = 0;
+    ucTxRingHead        = 0;
+    ucTxRingTail        = 0;
 
     // Display start-up greeting
-    SCIWriteString_P(PSTR("Welcome to Embedded Systems Programming\n\r"));
-	SCIWriteString_P(PSTR("cmd> "));
+    SCIWriteMsg(MSG_WELCOME);
+	SCIWriteMsg(MSG_PROMPT);
 }
  
 
@@ -118,28 +292,92 @@ void SCIInitialize(void)
 ISR(USART0_UDRE_vect)
 {
 	char TxData;
+	TxDescriptorType *ptrDesc;
+	PROFILE_START(PROFILE_USART0_UDRE);
 	    
 	// Disable UDR interrupt, and enable global interrupts
 	CLEAR_BIT(UCSR0B, UDRIE0);
-	sei();
 
-	// Save value to transmit, so we can send it later in the ISR.
-	TxData = *ptrOutputCharTail;
+#if SCI_FLOW_CONTROL == SCI_FLOW_XONXOFF
+	if (ucTxFlowChar != 0)
+	{	// Flow control goes out ahead of anything queued
+		UCSR0A = (UCSR0A & _BV(U2X0)) | _BV(TXC0);
+		UDR0 = ucTxFlowChar;
+		ucTxFlowChar = 0;
+		if (!TX_QUEUE_EMPTY())
+		{
+			SET_BIT(UCSR0B, UDRIE0);
+		}
+		PROFILE_END(PROFILE_USART0_UDRE);
+		return;
+	}
+	bInTxISR = TRUE;
+#endif
+	sei();
 
-	/* Move pointer to next character */            
-	ptrOutputCharTail = INC_CIRC_BUFFER_PTR(ptrOutputCharTail, 
-						zOutputChars, MAX_OUT_STR_SIZE);
+	// Fetch value to transmit from the oldest descriptor, so we can send it
+	// later in the ISR.
+	ptrDesc = &aTxQueue[ucTxQueueTail];
+	if (ptrDesc->ucSource == TX_FLASH)
+	{
+		TxData = pgm_read_byte(ptrDesc->ptrData);
+		++ptrDesc->ptrData;
+	}
+	else if (ptrDesc->ucSource == TX_STATIC)
+	{
+		TxData = *ptrDesc->ptrData;
+		++ptrDesc->ptrData;
+	}
+	else
+	{
+		TxData = zOutputChars[ucTxRingTail];
+		ucTxRingTail = TX_RING_INDEX(ucTxRingTail + 1);
+	}
 
-	// Send next character. We do this as close to the end of the ISR as
-	// possible.
+	// Send next character. TXC0 is cleared with it, so it's only set once
+	// this character is out (see SCISetBaudRate). It's cleared by writing
+	// a 1; U2X0 must be kept as it is.
+	UCSR0A = (UCSR0A & _BV(U2X0)) | _BV(TXC0);
     UDR0 = TxData;
 
+	/* Move to the next descriptor once this one is done. This comes after
+	 * the character is written, so the queue is never seen empty while
+	 * there's still one to send. */
+	if (--ptrDesc->uiLength == 0)
+	{
+		ucTxQueueTail = TX_QUEUE_INDEX(ucTxQueueTail + 1);
+	}
+
 	/* Check to see if we've just transmitted the last character.
 	 * If not, enable the interrupt. */
-	if (ptrOutputCharTail != ptrOutputCharHead)        
+#if SCI_FLOW_CONTROL == SCI_FLOW_XONXOFF
+	cli();
+	bInTxISR = FALSE;
+	if (!TX_QUEUE_EMPTY() || (ucTxFlowChar != 0))
+#else
+	if (!TX_QUEUE_EMPTY())
+#endif
 	{
 		SET_BIT(UCSR0B, UDRIE0);
 	}
+
+	PROFILE_END(PROFILE_USART0_UDRE);
+}
+
+/*****************************************************************************
+ * Interrupt Handler for Transmit Complete. Only enabled while a baud rate
+ * change is waiting. Changes the rate once the last character has been
+ * shifted out, so no character is sent at a mix of two rates.
+ *****************************************************************************/
+ISR(USART0_TX_vect)
+{
+	if (TX_QUEUE_EMPTY() && (ptrPendingBaud != 0))
+	{   // Transmitter is idle
+		SetBaudRegisters(ptrPendingBaud);
+		ptrPendingBaud = 0;
+		CLEAR_BIT(UCSR0B, TXCIE0);
+	}
+	// else, more characters were queued. Wait for them to go.
 }
 
 /*****************************************************************************
@@ -148,143 +386,391 @@ ISR(USART0_UDRE_vect)
 ISR(USART0_RX_vect)
 {
 	unsigned char status;
-	char *ptrPrev;
+	unsigned char ucData;
+	unsigned char ucHead;
+	void (*pfnHandler)(unsigned char, eBooleanType);
+	PROFILE_START(PROFILE_USART0_RX);
    
 	/* must do this first, since reading UDR0 resets the error flags */
 	status = UCSR0A;
-   
-	/* Append character to input string */
-	*ptrInputCharHead = UDR0;
-
-   /* Move pointer to next character */
-	ptrPrev = ptrInputCharHead;
-	ptrInputCharHead = INC_CIRC_BUFFER_PTR(ptrInputCharHead, zInputChars, 
-										   MAX_IN_STR_SIZE);
+	ucData = UDR0;
 
-	/* Check for receive buffer overflow */
-	if (ptrInputCharHead == ptrInputCharTail)
-	{  /* Buffer is full. By incrementing the pointer, it actually looks
-		* empty. So, decrement by 1, throwing away last received character,
-		* and record the problem.
-		*/
-		ptrInputCharHead = ptrPrev;
-		ReportError(SCI_RX_BUFFER_OVERFLOW);
+	pfnHandler = pfnRxHandler;
+	if (pfnHandler != 0)
+	{	// Binary data. The handler drops bad bytes itself.
+		pfnHandler(ucData, ((status & (_BV(FE0) | _BV(DOR0) | _BV(UPE0))) != 0) ?
+							TRUE : FALSE);
+	}
+	else
+	{
+		/* Check for receive buffer overflow */
+		ucHead = ucRxRingHead;
+		if (RX_RING_INDEX(ucHead + 1) == ucRxRingTail)
+		{	// Ring is full. Throw away the character, and record the problem.
+			CountRxFault(SCI_FAULT_RX_OVERFLOW, SCI_RX_BUFFER_OVERFLOW);
+		}
+		else
+		{	/* Append character, then move the index past it */
+			zInputChars[ucHead] = ucData;
+			ucRxRingHead = RX_RING_INDEX(ucHead + 1);
+		}
+
+#if SCI_FLOW_CONTROL != SCI_FLOW_NONE
+		if ((bRxStopped == FALSE) && (RX_RING_COUNT() >= SCI_RX_STOP_LEVEL))
+		{
+			SetRxFlow(TRUE);
+		}
+#endif
 	}
 
 	/* Check for input character errors */
    
 	if ((status & _BV(FE0)) != 0)
 	{
-		ReportError(SCI_RX_FRAME);
+		CountRxFault(SCI_FAULT_FRAME, SCI_RX_FRAME);
 	}
 
 	if ((status & _BV(DOR0)) != 0)
 	{
-		ReportError(SCI_RX_DATA_OVERRUN);
+		CountRxFault(SCI_FAULT_OVERRUN, SCI_RX_DATA_OVERRUN);
 	}
 
 	if ((status & _BV(UPE0)) != 0)
 	{
-		ReportError(SCI_RX_PARITY);
+		CountRxFault(SCI_FAULT_PARITY, SCI_RX_PARITY);
 	}
+
+	PROFILE_END(PROFILE_USART0_RX);
 }
 
 /******************************************************************************
- * Outputs the specified string to the RS-232 port.
+ * Sends received bytes to pfnHandler, called from the RX ISR, instead of the
+ * input buffer. Pass 0 to go back to the input buffer; anything left in it
+ * from before is discarded, so stray bytes don't reach the menu.
  ******************************************************************************/
-int SCIWriteString(char *Str)
+void SCISetRxHandler(void (*pfnHandler)(unsigned char, eBooleanType))
 {
-    int iReturnCode = 0;    /* Assume success */
-    eBooleanType bCopyComplete = FALSE;
-
-    /* Check to see if transmit buffer is full */
-    while ((INC_CIRC_BUFFER_PTR(ptrOutputCharHead, 
-			    				zOutputChars,
-				    			MAX_OUT_STR_SIZE) != ptrOutputCharTail) &&
-           (bCopyComplete == FALSE))
-
-	{   /* Copy string to transmit to the output buffer */
-        if (*Str != '\0')
-        {
-            *ptrOutputCharHead = *Str;
- 
-            /* Move pointer to next character */
-  		    ptrOutputCharHead = INC_CIRC_BUFFER_PTR(ptrOutputCharHead, 
-			    								    zOutputChars,
-				    							    MAX_OUT_STR_SIZE);
-            ++Str;
-        }
-        else
-        {   /* Done copying characters */
-            bCopyComplete = TRUE;
-        }
-    }   /* end of copying string */
+	unsigned char ucSREG;
+
+	ucSREG = SREG;
+	cli();
+	pfnRxHandler = pfnHandler;
+	ucRxRingTail = ucRxRingHead;
+	if (bRxStopped == TRUE)
+	{
+		SetRxFlow(FALSE);
+	}
+	SREG = ucSREG;
+}
+
+/******************************************************************************
+ * Returns TRUE if a write that finds no room should wait for it. Waiting with
+ * interrupts disabled would never end, so it fails then too.
+ ******************************************************************************/
+static eBooleanType TxCanWait(void)
+{
+	if ((bTxBlocking == TRUE) && ((SREG & _BV(SREG_I)) != 0))
+	{
+		return TRUE;
+	}
+	return FALSE;
+}
+
+/******************************************************************************
+ * Returns the number of free bytes in the transmit ring.
+ ******************************************************************************/
+static unsigned int TxRingSpace(void)
+{
+	return (SCI_TX_RING_SIZE - 1) -
+		   TX_RING_INDEX((unsigned char)(ucTxRingHead - ucTxRingTail));
+}
+
+/******************************************************************************
+ * Adds a descriptor for a block that isn't copied. Returns FALSE if the
+ * descriptor queue is full.
+ ******************************************************************************/
+static eBooleanType QueueTxBlock(const char *ptrData, unsigned int uiLength,
+								 TxSourceType Source)
+{
+	unsigned char ucNext = TX_QUEUE_INDEX(ucTxQueueHead + 1);
+
+	while (ucNext == ucTxQueueTail)
+	{   /* Descriptor queue is full */
+		if (TxCanWait() == FALSE)
+		{
+			return FALSE;
+		}
+	}
+
+	aTxQueue[ucTxQueueHead].ptrData  = ptrData;
+	aTxQueue[ucTxQueueHead].uiLength = uiLength;
+	aTxQueue[ucTxQueueHead].ucSource = Source;
+	ucTxQueueHead = ucNext;
 
     /* Enable transmitter interrupt */
 	SET_BIT(UCSR0B, UDRIE0);
+	return TRUE;
+}
 
-    /* See if the reason we stopped copying the string was because the 
-     * buffer was full. Note that the buffer being full may no longer be the
-     * case, even if it was true when copying, so we have to use our complete
-     * flag. */
-    if (bCopyComplete == FALSE)
-    {   /* Prematurely terminated copying */
-        ReportError(SCI_TX_BUFFER_OVERFLOW);
-        iReturnCode = -1;
-    }
-
-    return iReturnCode;
+/******************************************************************************
+ * Copies a block into the transmit ring and queues it. If it doesn't all fit,
+ * nothing is copied, unless blocking is on, when it's copied as room appears.
+ * Returns FALSE if it couldn't be queued.
+ ******************************************************************************/
+static eBooleanType CopyTxBlock(const char *ptrData, unsigned int uiLength)
+{
+	unsigned int uiCount, i;
+	unsigned char ucHead;
+	unsigned char ucLast;
+	unsigned char ucSREG;
+	eBooleanType bAdded;
+
+	if ((TxCanWait() == FALSE) && (uiLength > SCITxSpace()))
+	{
+		return FALSE;
+	}
+
+	while (uiLength != 0)
+	{
+		/* A free descriptor is needed first, in case the last ring descriptor
+		 * is finished before these bytes can be added to it. Only this
+		 * function uses descriptors up, so it stays free. */
+		uiCount = SCITxSpace();
+		if (uiCount == 0)
+		{
+			if (TxCanWait() == FALSE)
+			{
+				return FALSE;
+			}
+			continue;
+		}
+		if (uiCount > uiLength)
+		{
+			uiCount = uiLength;
+		}
+
+		/* Copy into the free part of the ring, which the ISR doesn't read */
+		ucHead = ucTxRingHead;
+		for (i = 0; i < uiCount; ++i)
+		{
+			zOutputChars[ucHead] = *ptrData++;
+			ucHead = TX_RING_INDEX(ucHead + 1);
+		}
+		uiLength -= uiCount;
+		ucLast = TX_QUEUE_INDEX(ucTxQueueHead - 1);
+
+		/* Add the bytes to the last descriptor if it's a ring descriptor the
+		 * ISR hasn't finished, or else give them their own. The ISR changes
+		 * the length, so this is done with interrupts disabled. */
+		ucSREG = SREG;
+		cli();
+		bAdded = FALSE;
+		if (!TX_QUEUE_EMPTY() && (aTxQueue[ucLast].ucSource == TX_RING))
+		{
+			aTxQueue[ucLast].uiLength += uiCount;
+			bAdded = TRUE;
+		}
+		ucTxRingHead = ucHead;
+		SREG = ucSREG;
+
+		if (bAdded == FALSE)
+		{
+			QueueTxBlock(0, uiCount, TX_RING);
+		}
+		else
+		{
+			SET_BIT(UCSR0B, UDRIE0);
+		}
+	}
+
+	return TRUE;
+}
+
+/******************************************************************************
+ * Outputs the specified string to the RS-232 port. The string is copied, so
+ * the buffer can be reused as soon as this returns.
+ ******************************************************************************/
+int SCIWriteString(char *Str)
+{
+	if (CopyTxBlock(Str, strlen(Str)) == FALSE)
+	{
+		ReportError(SCI_TX_BUFFER_OVERFLOW);
+		return -1;
+	}
+	return 0;
 }
 
 /******************************************************************************
  * Outputs the specified string, stored in program space, to the RS-232 port.
+ * The string is sent straight from flash, so only a descriptor is used.
  ******************************************************************************/
 int SCIWriteString_P(PGM_P Str_P)
 {
-    int iReturnCode = 0;    /* Assume success */
-    eBooleanType bCopyComplete = FALSE;
-	char Char_P;
-	
-    /* Check to see if transmit buffer is full */
-    while ((INC_CIRC_BUFFER_PTR(ptrOutputCharHead, 
-			    				zOutputChars,
-				    			MAX_OUT_STR_SIZE) != ptrOutputCharTail) &&
-           (bCopyComplete == FALSE))
-
-	{   /* Copy string to transmit to the output buffer */
-		Char_P = pgm_read_byte(Str_P);
-        if (Char_P != '\0')
-        {
-            *ptrOutputCharHead = Char_P;
- 
-            /* Move pointer to next character */
-  		    ptrOutputCharHead = INC_CIRC_BUFFER_PTR(ptrOutputCharHead, 
-			    								    zOutputChars,
-				    							    MAX_OUT_STR_SIZE);
-            ++Str_P;
-        }
-        else
-        {   /* Done copying characters */
-            bCopyComplete = TRUE;
-        }
-    }   /* end of copying string */
+	unsigned int uiLength = strlen_P(Str_P);
 
-    /* Enable transmitter interrupt */
-	SET_BIT(UCSR0B, UDRIE0);
+	if ((uiLength != 0) && (QueueTxBlock(Str_P, uiLength, TX_FLASH) == FALSE))
+	{
+		ReportError(SCI_TX_BUFFER_OVERFLOW);
+		return -1;
+	}
+	return 0;
+}
+
+/******************************************************************************
+ * Outputs a block of raw bytes to the RS-232 port. Unlike SCIWriteString,
+ * a 0 byte is sent like any other, so this can be used for binary data.
+ * The bytes are copied.
+ ******************************************************************************/
+int SCIWriteBlock(const void *Data, unsigned int Length)
+{
+	if (CopyTxBlock((const char *)Data, Length) == FALSE)
+	{
+		ReportError(SCI_TX_BUFFER_OVERFLOW);
+		return -1;
+	}
+	return 0;
+}
+
+/******************************************************************************
+ * Outputs a block of RAM to the RS-232 port without copying it. The caller
+ * must not change the block until SCITxIdle returns TRUE.
+ ******************************************************************************/
+int SCIWriteStatic(const void *Data, unsigned int Length)
+{
+	if ((Length != 0) &&
+		(QueueTxBlock((const char *)Data, Length, TX_STATIC) == FALSE))
+	{
+		ReportError(SCI_TX_BUFFER_OVERFLOW);
+		return -1;
+	}
+	return 0;
+}
+
+/******************************************************************************
+ * Returns the number of bytes that SCIWriteString or SCIWriteBlock can take
+ * without failing.
+ ******************************************************************************/
+unsigned int SCITxSpace(void)
+{
+	if (TX_QUEUE_INDEX(ucTxQueueHead + 1) == ucTxQueueTail)
+	{   /* No free descriptor */
+		return 0;
+	}
+	return TxRingSpace();
+}
 
-    /* See if the reason we stopped copying the string was because the 
-     * buffer was full. Note that the buffer being full may no longer be the
-     * case, even if it was true when copying, so we have to use our complete
-     * flag. */
-    if (bCopyComplete == FALSE)
-    {   /* Prematurely terminated copying */
-        ReportError(SCI_TX_BUFFER_OVERFLOW);
-        iReturnCode = -1;
-    }
-
-    return iReturnCode;
+/******************************************************************************
+ * Returns TRUE once everything queued has been handed to the transmitter.
+ ******************************************************************************/
+eBooleanType SCITxIdle(void)
+{
+	return TX_QUEUE_EMPTY() ? TRUE : FALSE;
+}
+
+/******************************************************************************
+ * Turns blocking writes on or off, and returns the previous setting. While
+ * blocking is on, a write that doesn't fit waits for the transmitter to make
+ * room, so long output such as help text is never lost. The foreground loop
+ * is held up while it waits, so don't leave it on while streaming samples.
+ ******************************************************************************/
+eBooleanType SCISetTxBlocking(eBooleanType bBlocking)
+{
+	eBooleanType bPrevious = bTxBlocking;
+
+	bTxBlocking = bBlocking;
+	return bPrevious;
 }
 
+/******************************************************************************
+ * Changes the baud rate. Characters already in the transmit buffer are sent
+ * at the old rate first. Returns PARAMETER_OUT_OF_RANGE if the rate isn't in
+ * BaudRates[].
+ ******************************************************************************/
+eErrorType SCISetBaudRate(unsigned long ulBaud)
+{
+	unsigned char i;
+	unsigned char ucSREG;
+	const BaudRateType *ptrBaud = 0;
+
+	for (i = 0; i < NUM_BAUD_RATES; ++i)
+	{
+		if (pgm_read_dword(&BaudRates[i].ulBaud) == ulBaud)
+		{
+			ptrBaud = &BaudRates[i];
+		}
+	}
+
+	if (ptrBaud == 0)
+	{
+		return PARAMETER_OUT_OF_RANGE;
+	}
+
+	ucSREG = SREG;
+	cli();
+	if (TX_QUEUE_EMPTY() && ((UCSR0A & _BV(TXC0)) != 0))
+	{   // Nothing queued, and last character is out: TXC0 is cleared as
+		// each character is written, so it can't be left over from an
+		// earlier one. Change now.
+		SetBaudRegisters(ptrBaud);
+	}
+	else
+	{   // Change from the transmit complete interrupt. TXC0 is cleared by
+		// writing a 1; U2X0 must be kept as it is.
+		ptrPendingBaud = ptrBaud;
+		UCSR0A = (UCSR0A & _BV(U2X0)) | _BV(TXC0);
+		SET_BIT(UCSR0B, TXCIE0);
+	}
+	SREG = ucSREG;
+
+	return NO_ERROR;
+}
+
+/******************************************************************************
+ * Returns the Index'th baud rate that SCISetBaudRate accepts, or 0 past the
+ * end of the list.
+ ******************************************************************************/
+unsigned long SCIGetBaudRate(unsigned char Index)
+{
+	if (Index >= NUM_BAUD_RATES)
+	{
+		return 0;
+	}
+	return pgm_read_dword(&BaudRates[Index].ulBaud);
+}
+
+/******************************************************************************
+ * Copies the receive fault counts, in eSCIFaultType order.
+ ******************************************************************************/
+void SCIGetFaultCounts(unsigned int *puiCounts)
+{
+	unsigned char i;
+	unsigned char ucSREG;
+
+	for (i = 0; i < SCI_NUM_FAULTS; ++i)
+	{	// 16-bit read; don't let the RX ISR change it halfway through.
+		ucSREG = SREG;
+		cli();
+		puiCounts[i] = auiRxFaults[i];
+		SREG = ucSREG;
+	}
+}
+
+/******************************************************************************
+ * Clears the receive fault counts.
+ ******************************************************************************/
+void SCIClearFaultCounts(void)
+{
+	unsigned char i;
+	unsigned char ucSREG;
+
+	for (i = 0; i < SCI_NUM_FAULTS; ++i)
+	{
+		ucSREG = SREG;
+		cli();
+		auiRxFaults[i] = 0;
+		SREG = ucSREG;
+	}
+}
 
 /******************************************************************************
  * Returns a character in the Receive buffer. If it's empty, it returns
@@ -293,15 +779,23 @@ int SCIWriteString_P(PGM_P Str_P)
 char SCIReadChar(void)
 {
    char cReturnVal;
+   unsigned char ucTail = ucRxRingTail;
+   unsigned char ucSREG;
 
-   if (ptrInputCharHead != ptrInputCharTail)
+   if (ucRxRingHead != ucTail)
    {   /* Receive buffer is not empty */
-      cReturnVal = *ptrInputCharTail;
-
-      /* Move pointer to next character */
-		ptrInputCharTail = INC_CIRC_BUFFER_PTR(ptrInputCharTail, 
-											   zInputChars,
-											   MAX_IN_STR_SIZE);
+      cReturnVal = zInputChars[ucTail];
+
+      /* Move index to next character */
+      ucRxRingTail = RX_RING_INDEX(ucTail + 1);
+
+      if ((bRxStopped == TRUE) && (RX_RING_COUNT() <= SCI_RX_START_LEVEL))
+      {   // Drained enough. Let the host go on.
+         ucSREG = SREG;
+         cli();
+         SetRxFlow(FALSE);
+         SREG = ucSREG;
+      }
    }
    else
    {
@@ -15,14 +15,70 @@
 
 #include <avr/pgmspace.h>
 
-/* Maximum size of I/O strings */
-#define MAX_OUT_STR_SIZE                250
-#define MAX_IN_STR_SIZE                 10
+#include "lib.h"
+#include "errors.h"
+
+/* Receive ring size. Must be a power of 2, no more than 256. */
+#define SCI_RX_RING_SIZE                64
+
+/*
+ * Receive flow control. With SCI_FLOW_XONXOFF, XOFF is sent to the host when
+ * the ring is nearly full, and XON once it has drained. Don't use it with the
+ * binary dump, since the host would take XON and XOFF bytes in the dump as
+ * flow control. With SCI_FLOW_RTS, the RTS output is raised to stop the host,
+ * and lowered to let it go on.
+ */
+#define SCI_FLOW_NONE                   0
+#define SCI_FLOW_XONXOFF                1
+#define SCI_FLOW_RTS                    2
+#define SCI_FLOW_CONTROL                SCI_FLOW_NONE
+
+#define SCI_XON                         0x11
+#define SCI_XOFF                        0x13
+
+#define SCI_RTS_PORT                    PORTE
+#define SCI_RTS_DDR                     DDRE
+#define SCI_RTS_BIT                     PE2
+
+/* The host is stopped once this many bytes are waiting, and started again
+ * once they're down to SCI_RX_START_LEVEL. The space above the stop level
+ * takes what the host sends before it reacts. */
+#define SCI_RX_STOP_LEVEL               (SCI_RX_RING_SIZE - 16)
+#define SCI_RX_START_LEVEL              (SCI_RX_RING_SIZE / 4)
+
+/* Transmit queue sizes. Both must be powers of 2, no more than 256. The ring
+ * holds copied bytes, and the queue holds one descriptor per block, less one
+ * that's kept free. The menu builds each line of a reply as one block, so a
+ * reply and its prompt take no more than 4, and this leaves plenty for the
+ * telemetry and trace frames queued alongside. */
+#define SCI_TX_RING_SIZE                256
+#define SCI_TX_QUEUE_SIZE               32
+
+/* Receive faults, each counted separately */
+typedef enum
+{
+	SCI_FAULT_RX_OVERFLOW = 0,	// Ring full; the byte was dropped
+	SCI_FAULT_FRAME,
+	SCI_FAULT_OVERRUN,
+	SCI_FAULT_PARITY,
+	SCI_NUM_FAULTS
+} eSCIFaultType;
 
 /* Function Prototypes */
 void SCIInitialize(void);
 int  SCIWriteString(char *);
 char SCIReadChar(void);
+void SCISetRxHandler(void (*)(unsigned char,		// Received byte
+							 eBooleanType));	// TRUE if it had an error
 int  SCIWriteString_P(PGM_P Str_P);
+int  SCIWriteBlock(const void *, unsigned int);
+int  SCIWriteStatic(const void *, unsigned int);
+unsigned int SCITxSpace(void);
+eBooleanType SCITxIdle(void);
+eBooleanType SCISetTxBlocking(eBooleanType);
+eErrorType SCISetBaudRate(unsigned long);
+unsigned long SCIGetBaudRate(unsigned char);
+void SCIGetFaultCounts(unsigned int *);	// SCI_NUM_FAULTS entries
+void SCIClearFaultCounts(void);
 
 #endif /* SERIAL_H */
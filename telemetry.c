@@ -0,0 +1,192 @@
+/******************************************************************************
+ * File Name:	telemetry.c
+ * Program:		Project for Real-Time Embedded Systems Programming class
+ * Purpose:		Telemetry. While it's on, the foreground samples the D/A
+ *				code every period, and sends a binary frame of it, with the
+ *				frequency, temperature, ISR timing and error count, after
+ *				every so many samples. The frame format is in telemetry.h.
+ *
+ *				Command responses come first. A frame is only queued if it
+ *				leaves TELEM_TX_RESERVE bytes free in the transmit buffer,
+ *				and not at all during a binary dump or upload, whose frames
+ *				mustn't be split. Otherwise it's skipped and counted, since
+ *				the next one has newer values anyway.
+ ******************************************************************************/
+#include <util/crc16.h>
+
+#include "lib.h"
+#include "config.h"
+#include "errors.h"
+#include "serial.h"
+#include "sched.h"
+#include "dtoa.h"
+#include "waveform.h"
+#include "tempsensor.h"
+#include "profile.h"
+#include "power.h"
+#include "memdump.h"
+#include "arb.h"
+#include "telemetry.h"
+
+_Static_assert((TELEM_FRAME_SIZE + TELEM_TX_RESERVE) < SCI_TX_RING_SIZE,
+			   "A telemetry frame would never fit in the transmit buffer");
+
+static eBooleanType bTelemetryOn = FALSE;
+static unsigned int uiPeriodTicks = 0;
+static unsigned char ucDecimation = 0;
+
+static unsigned int uiLastSample = 0;		// Tick of the last sample
+static unsigned char ucSamples = 0;			// Since the last frame
+static unsigned int uiMinCode = 0;
+static unsigned int uiMaxCode = 0;
+static unsigned char ucFrameNumber = 0;
+static unsigned char ucSkipped = 0;
+
+static void SendTelemetryFrame(unsigned int uiCode);
+static unsigned char *PutWord(unsigned char *ptrOut, unsigned int uiValue);
+
+/******************************************************************************
+ * Starts sending telemetry: a sample every uiPeriod mSecs, rounded to the
+ * nearest tick, and a frame every ucDecimation samples. Returns
+ * PARAMETER_OUT_OF_RANGE if either is 0.
+ ******************************************************************************/
+eErrorType StartTelemetry(unsigned int uiPeriod, unsigned char ucDecimate)
+{
+	unsigned int uiTicks;
+
+	uiTicks = (unsigned int)((uiPeriod + (TIMER0_TICK_MS / 2UL)) / TIMER0_TICK_MS);
+	if ((uiTicks == 0) || (ucDecimate == 0))
+	{
+		return PARAMETER_OUT_OF_RANGE;
+	}
+
+	uiPeriodTicks = uiTicks;
+	ucDecimation = ucDecimate;
+	ucSamples = 0;
+	ucFrameNumber = 0;
+	ucSkipped = 0;
+	uiLastSample = GetTickCount();
+	bTelemetryOn = TRUE;
+	return NO_ERROR;
+}
+
+/******************************************************************************
+ * Stops sending telemetry. A frame already queued is still sent.
+ ******************************************************************************/
+void StopTelemetry(void)
+{
+	bTelemetryOn = FALSE;
+}
+
+/******************************************************************************
+ * Takes a sample when one is due, and sends a frame after every ucDecimation
+ * of them. Called from the foreground loop.
+ ******************************************************************************/
+void ServiceTelemetry(void)
+{
+	unsigned int uiCode;
+
+	if (TelemetryWorkPending() == FALSE)
+	{
+		return;
+	}
+	// Stay in step with the ticks, even if we were held up
+	uiLastSample += uiPeriodTicks;
+
+	uiCode = GetDtoAValue();
+	if ((ucSamples == 0) || (uiCode < uiMinCode))
+	{
+		uiMinCode = uiCode;
+	}
+	if ((ucSamples == 0) || (uiCode > uiMaxCode))
+	{
+		uiMaxCode = uiCode;
+	}
+
+	if (++ucSamples >= ucDecimation)
+	{
+		ucSamples = 0;
+		SendTelemetryFrame(uiCode);
+	}
+}
+
+/******************************************************************************
+ * Returns TRUE once the next sample is due. Called by IdleSleep with
+ * interrupts disabled, as well as from ServiceTelemetry.
+ ******************************************************************************/
+eBooleanType TelemetryWorkPending(void)
+{
+	return ((bTelemetryOn == TRUE) &&
+			((unsigned int)(GetTickCount() - uiLastSample) >= uiPeriodTicks)) ?
+			TRUE : FALSE;
+}
+
+/******************************************************************************
+ * Builds a frame and queues it, or counts it as skipped if the transmit
+ * buffer is needed for something else.
+ ******************************************************************************/
+static void SendTelemetryFrame(unsigned int uiCode)
+{
+	unsigned char aucFrame[TELEM_FRAME_SIZE];
+	unsigned char *ptrOut;
+	WaveStatusType Status;
+	ProfileStatsType Profile;
+	PowerStatsType Power;
+	unsigned long ulErrors = 0;
+	unsigned int uiCRC = 0;
+	unsigned char i;
+
+	if ((MemoryDumpBusy() == TRUE) || (ArbUploadBusy() == TRUE) ||
+		(SCITxSpace() < (TELEM_FRAME_SIZE + TELEM_TX_RESERVE)))
+	{
+		if (ucSkipped != 0xFF)
+		{
+			++ucSkipped;
+		}
+		++ucFrameNumber;
+		return;
+	}
+
+	GetWaveStatus(&Status);
+	GetProfileStats(PROFILE_TIMER1, &Profile);
+	GetPowerStats(&Power);
+	for (i = 0; i < NUM_ERROR_TYPES; ++i)
+	{
+		ulErrors += GetErrorCount((eErrorType)i);
+	}
+
+	aucFrame[0] = TELEM_SYNC1;
+	aucFrame[1] = TELEM_SYNC2;
+	aucFrame[2] = ucFrameNumber++;
+	aucFrame[3] = ucSkipped;
+	ptrOut = PutWord(&aucFrame[4], uiCode);
+	ptrOut = PutWord(ptrOut, uiMinCode);
+	ptrOut = PutWord(ptrOut, uiMaxCode);
+	ptrOut = PutWord(ptrOut, (unsigned int)Status.ulActualFrequency);
+	ptrOut = PutWord(ptrOut, (unsigned int)(Status.ulActualFrequency >> 16));
+	ptrOut = PutWord(ptrOut, (unsigned int)ReadTemperature());
+	ptrOut = PutWord(ptrOut, (unsigned int)PROFILE_TICKS_TO_US(Profile.uiMax));
+	ptrOut = PutWord(ptrOut, Power.uiMaxLatency);
+	*ptrOut++ = Power.ucIdlePercent;
+	*ptrOut++ = (unsigned char)GetError();
+	ptrOut = PutWord(ptrOut, (ulErrors > 0xFFFF) ? 0xFFFF : (unsigned int)ulErrors);
+
+	for (i = 2; i < (TELEM_FRAME_SIZE - 2); ++i)
+	{
+		uiCRC = _crc_xmodem_update(uiCRC, aucFrame[i]);
+	}
+	PutWord(ptrOut, uiCRC);
+
+	SCIWriteBlock(aucFrame, TELEM_FRAME_SIZE);
+	ucSkipped = 0;
+}
+
+/******************************************************************************
+ * Stores a 16-bit value, LSB first, and returns where the next byte goes.
+ ******************************************************************************/
+static unsigned char *PutWord(unsigned char *ptrOut, unsigned int uiValue)
+{
+	*ptrOut++ = (unsigned char)uiValue;
+	*ptrOut++ = (unsigned char)(uiValue >> 8);
+	return ptrOut;
+}
@@ -0,0 +1,48 @@
+/******************************************************************************
+ * File Name:	telemetry.h
+ * Program:		Project for Real-Time Embedded Systems Programming class
+ * Purpose:		Header file for telemetry.c file.
+ ******************************************************************************/
+#if !defined(TELEMETRY_H)	/* Prevents including this file multiple times */
+#define TELEMETRY_H
+
+#include "lib.h"
+#include "errors.h"
+
+/*
+ * While telemetry is on, the D/A code is sampled every period, and after
+ * every 'decimation' samples one frame is sent:
+ *
+ *   Byte 0-1:  Sync, TELEM_SYNC1 then TELEM_SYNC2
+ *        2:    Frame number. Wraps; a gap means frames were skipped.
+ *        3:    Frames skipped since the last one, because the transmit
+ *              buffer was needed for something else. Stops at 255.
+ *        4-5:  D/A code (channel 0) at the last sample
+ *        6-7:  Lowest D/A code sampled since the last frame
+ *        8-9:  Highest D/A code sampled since the last frame
+ *        10-13: Frequency being made, mHz. 0 when off.
+ *        14-15: Temperature, 0.1 C, signed
+ *        16-17: Longest Timer 1 ISR, uSecs, since the profile was cleared
+ *        18-19: Worst sample ISR latency, CPU cycles, since "pw"
+ *        20:   Idle time since "pw", percent
+ *        21:   Current error code
+ *        22-23: Errors reported since reset, all types. Stops at 0xFFFF.
+ *   Last 2:    CRC of bytes 2 up to the end of the data, XMODEM CRC.
+ *
+ * All multi-byte values are LSB first. telemetry.py decodes and plots them.
+ */
+#define TELEM_SYNC1                     0xA5
+#define TELEM_SYNC2                     0xC3
+#define TELEM_FRAME_SIZE                26
+
+/* Transmit buffer space left for command responses. A frame is only sent
+ * if it leaves at least this much free. */
+#define TELEM_TX_RESERVE                64
+
+/* Function Prototypes */
+eErrorType StartTelemetry(unsigned int, unsigned char);	// mSecs, decimation
+void StopTelemetry(void);
+void ServiceTelemetry(void);				// Called from foreground loop
+eBooleanType TelemetryWorkPending(void);	// Called from IdleSleep
+
+#endif /* TELEMETRY_H */
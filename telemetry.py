@@ -0,0 +1,118 @@
+#!/usr/bin/env python3
+#
+# telemetry.py - Decodes the board's telemetry frames, and plots them live.
+#
+# Usage: telemetry.py [--plot] [--baud rate] [port or file]
+#
+# Turn telemetry on first with the "tm" command, e.g. "tm 100 1". Frames
+# are found by their sync bytes and checked by their CRC, so menu output,
+# trace frames and anything else on the port are skipped. With no port or
+# file, reads standard input. Each frame is printed as one CSV line; with
+# --plot, the D/A code, frequency and temperature are plotted as well (needs
+# pyserial for a port, and matplotlib for --plot). The frame format is in
+# telemetry.h.
+
+import argparse
+import binascii
+import struct
+import sys
+import time
+
+SYNC = b'\xa5\xc3'
+FRAME_SIZE = 26
+FORMAT = '<BBHHHIhHHBBHH'		# Bytes 2 to 25, the CRC last
+FIELDS = ('frame', 'skipped', 'code', 'min', 'max', 'mhz', 'temp',
+		  'isr_us', 'latency', 'idle', 'error', 'errors')
+
+
+def frames(stream):
+	"""Yields each good frame from a stream of bytes, as a dict."""
+	data = b''
+	while True:
+		chunk = stream.read(64)
+		if not chunk:
+			return
+		data += chunk
+		while True:
+			start = data.find(SYNC)
+			if start < 0:
+				data = data[-1:]	# Might be the first sync byte
+				break
+			if len(data) - start < FRAME_SIZE:
+				data = data[start:]
+				break
+			frame = data[start:start + FRAME_SIZE]
+			if binascii.crc_hqx(frame[2:-2], 0) != struct.unpack('<H', frame[-2:])[0]:
+				data = data[start + 1:]		# Not a frame after all
+				continue
+			data = data[start + FRAME_SIZE:]
+			yield dict(zip(FIELDS, struct.unpack(FORMAT, frame[2:])))
+
+
+def open_input(name, baud):
+	if name is None:
+		return sys.stdin.buffer
+	try:
+		import serial
+		return serial.Serial(name, baud, timeout=0.1)
+	except (ImportError, ValueError, OSError):
+		return open(name, 'rb')
+
+
+class Plot:
+	"""Scrolling plot of the last 'length' frames."""
+
+	def __init__(self, length=500):
+		import matplotlib.pyplot as plt
+		self.plt = plt
+		self.length = length
+		self.rows = {'code': [], 'hz': [], 'temp': []}
+		self.figure, self.axes = plt.subplots(3, 1, sharex=True)
+		self.lines = {}
+		for axis, (key, label) in zip(self.axes, (('code', 'D/A code'),
+												  ('hz', 'Hz'),
+												  ('temp', 'deg C'))):
+			self.lines[key], = axis.plot([], [])
+			axis.set_ylabel(label)
+		plt.ion()
+		plt.show()
+		self.drawn = 0.0
+
+	def add(self, row):
+		values = {'code': row['code'], 'hz': row['mhz'] / 1000.0,
+				  'temp': row['temp'] / 10.0}
+		for key, value in values.items():
+			self.rows[key] = (self.rows[key] + [value])[-self.length:]
+		if time.time() - self.drawn < 0.2:
+			return
+		self.drawn = time.time()
+		for axis, key in zip(self.axes, ('code', 'hz', 'temp')):
+			self.lines[key].set_data(range(len(self.rows[key])), self.rows[key])
+			axis.relim()
+			axis.autoscale_view()
+		self.plt.pause(0.001)
+
+
+def main():
+	parser = argparse.ArgumentParser(description='Decode telemetry frames.')
+	parser.add_argument('input', nargs='?', help='serial port or capture file')
+	parser.add_argument('--baud', type=int, default=2400)
+	parser.add_argument('--plot', action='store_true')
+	args = parser.parse_args()
+
+	plot = Plot() if args.plot else None
+	print(','.join(FIELDS))
+	last = None
+	for row in frames(open_input(args.input, args.baud)):
+		if last is not None and row['frame'] != (last + 1) & 0xFF:
+			print('# %d frames lost' % ((row['frame'] - last - 1) & 0xFF),
+				  file=sys.stderr)
+		last = row['frame']
+		print(','.join(str(row[field]) for field in FIELDS))
+		sys.stdout.flush()
+		if plot:
+			plot.add(row)
+
+
+if __name__ == '__main__':
+	main()
@@ -15,8 +15,10 @@
 
 /********************************* Includes ***********************************/
 #include <avr/io.h>
+#include <avr/pgmspace.h>
 #include "errors.h"
 #include "tempsensor.h"
+#include "adc.h"
 
 #include "lib.h"
 #include "serial.h"
@@ -24,72 +26,74 @@
 /******************************************************************************
  * constants
  *****************************************************************************/
-#define T_AMB   ((int long)298)
-#define BETA    ((int long)3380)
-#define T_ZERO  ((int long)273)
-#define TEMP1   ((BETA<<8)/T_AMB)
-#define TEMP2   (TEMP1 - (1<<9))
+#define T_AMB   ((unsigned long)298)
+#define BETA    ((unsigned long)3380)
+#define T_ZERO_TENTHS	2731		/* 273.15 K, in 0.1 K, less the 0.5 for rounding */
 
-/******************************************************************************
- * Initialization for A/D, which is needed by temperature sensor.
- *****************************************************************************/
-void InitAtoD(void)
-{
-	/*------------------ Set ADMUX values -------------------------- 
-	 * Bit(s)   7: REFS1  = 0  Choose AVCC reference voltage
-	 *          6: REFS0  = 1.
-	 *          5: ADLAR  = 0  Result is right-adjusted
-	 *          4: MUX4   = 0  Select ADC1 for conversion
-	 *          3: MUX3   = 0  
-	 *          2: MUX2   = 0  
-     *          1: MUX1   = 0  
-	 *          0: MUX0   = 1
-	 */	 
-	ADMUX = _BV(REFS0) | _BV(MUX0);
+/* The conversion table has an entry every TEMP_TABLE_STEP A/D counts, and
+ * the reading is interpolated between them. Readings are the sum of
+ * ADC_AVERAGE_SIZE conversions, so the table step in those units is
+ * TEMP_TABLE_STEP << ADC_AVERAGE_SHIFT. */
+#define TEMP_TABLE_SHIFT	5
+#define TEMP_TABLE_STEP		(1 << TEMP_TABLE_SHIFT)
+#define TEMP_TABLE_SIZE		((1024 / TEMP_TABLE_STEP) + 1)
+#define TEMP_SUM_SHIFT		(TEMP_TABLE_SHIFT + ADC_AVERAGE_SHIFT)
+#define TEMP_SUM_FRACTION	((1 << TEMP_SUM_SHIFT) - 1)
 
-	/*------------------ Set ADCSRB values -------------------------- 
-	 * Bit(s)   7: Unused = 0
-	 *          6: ACME   = 0  No analog multiplexing
-	 *          5: Unused = 0  
-	 *          4: Unused = 0  
-	 *          3  MUX5   = 0
-	 *          2: ADTS2  = 0  Free running mode on A/D conversion.
-     *          1: ADTS1  = 0 
-	 *          0: ADTS0  = 0
-	 */	 
-	ADCSRB = 0;
+/*
+ * Temperature, in 0.1 C, for an A/D reading, from the formula explained
+ * at ReadTemperature. The denominator is multiplied through by T_AMB, so
+ * BETA*256/T_AMB isn't truncated:
+ *	 T(0.1 K) = (BETA*256*10) / (ADC - 512 + BETA*256/T_AMB)
+ *			  = (BETA*2560*T_AMB) / (ADC*T_AMB - 512*T_AMB + BETA*256)
+ * Taking 273.15 off and rounding to nearest is the same as truncating and
+ * taking 273.1 off. It's all constant, so the compiler works out the
+ * table, and it follows BETA and T_AMB if they're changed.
+ */
+#define TEMP_DENOMINATOR(adc)	\
+	((unsigned long)(adc) * T_AMB - 512 * T_AMB + BETA * 256)
+#define TEMP_TENTHS(adc)		\
+	((int)((BETA * 2560 * T_AMB) / TEMP_DENOMINATOR(adc)) - T_ZERO_TENTHS)
+#define TEMP_ENTRY(i)			TEMP_TENTHS((i) * TEMP_TABLE_STEP)
 
-	/*------------------ Set DIDR0 and DIDR2 values -----------------
-	 * Bit(s) 7-0:  ADCxD = 1  Disable all digital input buffers.
-	 */	 
-	DIDR0 = 0xFF;
-	DIDR2 = 0xFF;
+/* Temperature at each table point. It falls as the reading rises, by less
+ * each step, since the curve flattens out: with the BETA and T_AMB above,
+ * from 47 tenths for the first step to 24 for the last. */
+static const int TempTable[TEMP_TABLE_SIZE] PROGMEM =
+{
+	TEMP_ENTRY( 0), TEMP_ENTRY( 1), TEMP_ENTRY( 2), TEMP_ENTRY( 3),
+	TEMP_ENTRY( 4), TEMP_ENTRY( 5), TEMP_ENTRY( 6), TEMP_ENTRY( 7),
+	TEMP_ENTRY( 8), TEMP_ENTRY( 9), TEMP_ENTRY(10), TEMP_ENTRY(11),
+	TEMP_ENTRY(12), TEMP_ENTRY(13), TEMP_ENTRY(14), TEMP_ENTRY(15),
+	TEMP_ENTRY(16), TEMP_ENTRY(17), TEMP_ENTRY(18), TEMP_ENTRY(19),
+	TEMP_ENTRY(20), TEMP_ENTRY(21), TEMP_ENTRY(22), TEMP_ENTRY(23),
+	TEMP_ENTRY(24), TEMP_ENTRY(25), TEMP_ENTRY(26), TEMP_ENTRY(27),
+	TEMP_ENTRY(28), TEMP_ENTRY(29), TEMP_ENTRY(30), TEMP_ENTRY(31),
+	TEMP_ENTRY(32)
+};
 
-    /*------------------ Set ADCSRA values -------------------------- 
-	 * Bit(s)   7:  ADEN  = 1  Enable the ADC
-	 *          6:  ADSC  = 1  Start a conversion 
-	 *          5: ADATE  = 1  Enable auto triggerring
-	 *          4:  ADIF  = 1  Clear any pending interrupt
-	 *          3:  ADIE  = 0  Don't enable interrupt
-	 *          2: ADPS2  = 1  Divide 8 MHz clock by 64 to get  
-     *          1: ADPS1  = 1  125 kHz.
-	 *          0: ADPS0  = 0
-	 */	 
-	ADCSRA = _BV(ADEN) | _BV(ADSC)  | _BV(ADATE) | _BV(ADIF) 
-					   | _BV(ADPS2) | _BV(ADPS1);
-}
+/* ReadTemperature multiplies a step's drop by the fraction of the way
+ * through it, in 16 bits. The first step drops the most. */
+#define TEMP_MAX_DROP			(TEMP_ENTRY(0) - TEMP_ENTRY(1))
+_Static_assert(TEMP_MAX_DROP <= 0xFF, "A table step drops too far for ucDrop");
+_Static_assert(((unsigned long)TEMP_MAX_DROP * TEMP_SUM_FRACTION +
+				(1 << (TEMP_SUM_SHIFT - 1))) <= 0xFFFF,
+			   "Interpolation would overflow 16 bits");
 
 /******************************************************************************
- * Read the A/D converter, and calculate the temperature.
+ * Read the A/D converter, and calculate the temperature, in 0.1 degrees C.
  *
- * ASSIGNMENT:  fill in this function to:
- *	(1) Read the Analog-to-Digital Converter
- *	(2) Calculate the temperature, in degrees Celsius, using the Taylor's
- *		series approximation discussed in class.
- *	(3) Return the temperature as an integer value from this function.
+ * The reading is the thermistor channel's running average from adc.c, so
+ * this never waits for a conversion. It's the sum of ADC_AVERAGE_SIZE
+ * conversions, which keeps the extra resolution of the average.
+ *
+ * The temperature comes from TempTable, interpolating linearly between
+ * the two nearest points. That's one 16-bit multiply and no division.
+ * The formula's curve bends so little between points that interpolation
+ * adds under 0.02 C; the result is within about 0.1 C of the formula.
  *
  *  ___________________________________________________________________________
- *  Explanation of solution:
+ *  Explanation of the formula:
  *    ln (x) = 2 ((x-1)/(x+1))    i.e, first term of Taylor's series
  *           = 2 [(Vadc - (Vref - Vadc))/(Vadc + (Vref - Vadc))]
  *		     = 4(Vadc / Vref) - 2
@@ -97,21 +101,30 @@ void InitAtoD(void)
  *		     = (ADC/256) - 2
  *  Inserting this term in the complete temperature formula would yield:
  *	  Temperature = (BETA * 256)/[(ADC - (2*256) + (BETA*256/T_AMB)] - T_ZERO
- *                = (BETA * 256)/(ADC + TEMP2) - T_ZERO
- *                = ((BETA << 2)/((ADC + TEMP2) >> 6 )) - T_ZERO;
- *
- *       where,TEMP2 = [-(2*256) + (BETA*256/T_AMB)]
  *
- *       Also note that multiplication of 256 is split into left shift of 2 
- *       in numerator and right shift of 6 in denominator for scaling purposes.
- *    
  ******************************************************************************/
 int ReadTemperature(void)
 {
-    int long Temperature = 0;
+	unsigned int uiReading;
+	unsigned char ucIndex;
+	unsigned int uiFraction;
+	int Temperature;
+	unsigned char ucDrop;
+
+	uiReading = GetAtoDSum(ADC_CHANNEL_TEMP);
+
+	// Table point at or below the reading, and how far past it we are
+	ucIndex = (unsigned char)(uiReading >> TEMP_SUM_SHIFT);
+	uiFraction = uiReading & TEMP_SUM_FRACTION;
+
+	Temperature = (int)pgm_read_word(&TempTable[ucIndex]);
+	ucDrop = (unsigned char)(Temperature -
+							 (int)pgm_read_word(&TempTable[ucIndex + 1]));
 
-	// calculation explanation is shown above
-	Temperature = ( ( BETA << 2 ) / (( ADC  + TEMP2 ) >> 6 ) ) - T_ZERO;
+	// At most TEMP_MAX_DROP * TEMP_SUM_FRACTION, which is checked above to
+	// fit in 16 bits
+	Temperature -= (int)((ucDrop * uiFraction +
+						  (1 << (TEMP_SUM_SHIFT - 1))) >> TEMP_SUM_SHIFT);
 
-   return (int)Temperature;
+	return Temperature;
 }
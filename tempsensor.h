@@ -11,8 +11,7 @@
 #if !defined(TEMPSENSOR_H)		/* Prevents including this file multiple times */
 #define TEMPSENSOR_H
 
-/* Interrupt prototypes */
-void InitAtoD(void);
-int ReadTemperature(void);
+/* Interrupt prototypes. InitAtoD(), in adc.c, must be called first. */
+int ReadTemperature(void);		// 0.1 degrees C
 
 #endif /* TEMPSENSOR_H */
@@ -0,0 +1,253 @@
+/******************************************************************************
+ * File Name:	trace.c
+ * Program:		Project for Real-Time Embedded Systems Programming class
+ * Purpose:		Event tracing. TRACE records an ID and a value, with a
+ *				Timer 3 timestamp, in a ring; that's all an ISR pays for.
+ *				ServiceTrace, in the foreground loop, sends them on as binary
+ *				frames when there's room in the transmit buffer, so tracing
+ *				doesn't change the timing of the code being traced.
+ *
+ *				Each module has its own level, all TRACE_OFF at reset. Calls
+ *				above a module's TRACE_MAX_ level aren't compiled at all.
+ ******************************************************************************/
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+#include <util/crc16.h>
+
+#include "lib.h"
+#include "errors.h"
+#include "profile.h"
+#include "serial.h"
+#include "memdump.h"
+#include "arb.h"
+#include "trace.h"
+
+#define TRACE_INDEX(index)			((index) & (TRACE_RING_SIZE - 1))
+
+typedef struct
+{
+	unsigned int uiTime;		// ProfileTimestamp() when it was recorded
+	unsigned char ucId;			// eTraceIdType
+	unsigned int uiValue;
+} TraceEventType;
+
+/* The ring. TraceEvent adds at the head, with interrupts disabled, and
+ * ServiceTrace takes from the tail. */
+static TraceEventType aTraceRing[TRACE_RING_SIZE];
+static volatile unsigned char ucTraceHead = 0;
+static volatile unsigned char ucTraceTail = 0;
+static volatile unsigned int uiTraceDropped = 0;		// Since the last frame
+static unsigned int uiTraceDroppedTotal = 0;			// Since reset
+
+unsigned char aucTraceLevel[TRACE_NUM_MODULES];
+
+static const char DtoAName[] PROGMEM = "dtoa";
+static const char WaveName[] PROGMEM = "wave";
+static const char SchedName[] PROGMEM = "sched";
+static const char ArbName[] PROGMEM = "arb";
+static const char ErrorsName[] PROGMEM = "errors";
+
+/* In eTraceModuleType order */
+static PGM_P const ModuleNames[TRACE_NUM_MODULES] PROGMEM =
+{
+	DtoAName, WaveName, SchedName, ArbName, ErrorsName
+};
+
+/******************************************************************************
+ * Adds an event to the ring, or counts it as dropped if the ring is full.
+ * Can be called from anywhere; interrupts are disabled while it's added.
+ ******************************************************************************/
+void TraceEvent(unsigned char ucId, unsigned int uiValue)
+{
+	TraceEventType *ptrEvent;
+	unsigned char ucHead;
+	unsigned char ucSREG;
+
+	ucSREG = SREG;
+	cli();
+	ucHead = ucTraceHead;
+	if (TRACE_INDEX(ucHead + 1) == ucTraceTail)
+	{	// Full
+		if (uiTraceDropped != 0xFFFF)
+		{
+			++uiTraceDropped;
+		}
+	}
+	else
+	{
+		ptrEvent = &aTraceRing[ucHead];
+		ptrEvent->uiTime = ProfileTimestamp();
+		ptrEvent->ucId = ucId;
+		ptrEvent->uiValue = uiValue;
+		ucTraceHead = TRACE_INDEX(ucHead + 1);
+	}
+	SREG = ucSREG;
+}
+
+/******************************************************************************
+ * Returns how many events the next frame can carry: 0 if there are none,
+ * the whole frame doesn't fit in the transmit buffer yet, or another binary
+ * transfer is under way. A frame in the middle of a memory dump or an upload
+ * would corrupt it, so events wait in the ring until it's over.
+ ******************************************************************************/
+static unsigned char FrameEvents(void)
+{
+	unsigned char ucCount;
+
+	if ((MemoryDumpBusy() == TRUE) || (ArbUploadBusy() == TRUE))
+	{
+		return 0;
+	}
+
+	ucCount = TRACE_INDEX(ucTraceHead - ucTraceTail);
+	if (ucCount > TRACE_FRAME_EVENTS)
+	{
+		ucCount = TRACE_FRAME_EVENTS;
+	}
+	if ((ucCount != 0) &&
+		(SCITxSpace() < (unsigned int)(5 + (ucCount * 5) + 2)))
+	{	// Wait for room, rather than lose some of it
+		ucCount = 0;
+	}
+	return ucCount;
+}
+
+/******************************************************************************
+ * Sends the events recorded so far as one frame, if there are any and the
+ * whole frame fits in the transmit buffer. Called from the foreground loop.
+ ******************************************************************************/
+void ServiceTrace(void)
+{
+	unsigned char aucFrame[TRACE_FRAME_SIZE];
+	TraceEventType *ptrEvent;
+	unsigned char *ptrOut;
+	unsigned char ucTail;
+	unsigned char ucCount;
+	unsigned int uiDropped;
+	unsigned int uiCRC = 0;
+	unsigned int uiLength;
+	unsigned int i;
+	unsigned char ucSREG;
+
+	ucCount = FrameEvents();
+	if (ucCount == 0)
+	{
+		return;
+	}
+	ucTail = ucTraceTail;
+
+	// Take the dropped count. 16 bits, and the ISRs change it.
+	ucSREG = SREG;
+	cli();
+	uiDropped = uiTraceDropped;
+	uiTraceDropped = 0;
+	SREG = ucSREG;
+
+	if ((uiTraceDroppedTotal + uiDropped) < uiTraceDroppedTotal)
+	{
+		uiTraceDroppedTotal = 0xFFFF;
+	}
+	else
+	{
+		uiTraceDroppedTotal += uiDropped;
+	}
+
+	aucFrame[0] = TRACE_SYNC1;
+	aucFrame[1] = TRACE_SYNC2;
+	aucFrame[2] = ucCount;
+	aucFrame[3] = (unsigned char)uiDropped;
+	aucFrame[4] = (unsigned char)(uiDropped >> 8);
+	ptrOut = &aucFrame[5];
+
+	// Only the tail is ours; events past it are left alone until it moves
+	for (i = 0; i < ucCount; ++i)
+	{
+		ptrEvent = &aTraceRing[ucTail];
+		*ptrOut++ = (unsigned char)ptrEvent->uiTime;
+		*ptrOut++ = (unsigned char)(ptrEvent->uiTime >> 8);
+		*ptrOut++ = ptrEvent->ucId;
+		*ptrOut++ = (unsigned char)ptrEvent->uiValue;
+		*ptrOut++ = (unsigned char)(ptrEvent->uiValue >> 8);
+		ucTail = TRACE_INDEX(ucTail + 1);
+	}
+	ucTraceTail = ucTail;
+
+	uiLength = ptrOut - aucFrame;
+	for (i = 2; i < uiLength; ++i)
+	{
+		uiCRC = _crc_xmodem_update(uiCRC, aucFrame[i]);
+	}
+	*ptrOut++ = (unsigned char)uiCRC;
+	*ptrOut++ = (unsigned char)(uiCRC >> 8);
+
+	SCIWriteBlock(aucFrame, uiLength + 2);
+}
+
+/******************************************************************************
+ * Returns TRUE if ServiceTrace can send a frame now. Called by IdleSleep
+ * with interrupts disabled.
+ ******************************************************************************/
+eBooleanType TraceWorkPending(void)
+{
+	return (FrameEvents() != 0) ? TRUE : FALSE;
+}
+
+/******************************************************************************
+ * Sets a module's trace level. Levels above its TRACE_MAX_ level are
+ * accepted, but events above that level still aren't recorded, because
+ * they aren't compiled in.
+ ******************************************************************************/
+eErrorType SetTraceLevel(unsigned char ucModule, unsigned char ucLevel)
+{
+	if ((ucModule >= TRACE_NUM_MODULES) || (ucLevel > TRACE_DEBUG))
+	{
+		return PARAMETER_OUT_OF_RANGE;
+	}
+	aucTraceLevel[ucModule] = ucLevel;
+	return NO_ERROR;
+}
+
+/******************************************************************************
+ * Returns a module's trace level, or TRACE_OFF if there's no such module.
+ ******************************************************************************/
+unsigned char GetTraceLevel(unsigned char ucModule)
+{
+	if (ucModule >= TRACE_NUM_MODULES)
+	{
+		return TRACE_OFF;
+	}
+	return aucTraceLevel[ucModule];
+}
+
+/******************************************************************************
+ * Returns a module's name, for display, or 0 if there's no such module.
+ ******************************************************************************/
+PGM_P GetTraceModuleName(unsigned char ucModule)
+{
+	if (ucModule >= TRACE_NUM_MODULES)
+	{
+		return 0;
+	}
+	return (PGM_P)pgm_read_word(&ModuleNames[ucModule]);
+}
+
+/******************************************************************************
+ * Returns the number of events dropped since reset because the ring was
+ * full. Stops at 0xFFFF.
+ ******************************************************************************/
+unsigned int GetTraceDropped(void)
+{
+	unsigned int uiDropped;
+	unsigned char ucSREG;
+
+	ucSREG = SREG;
+	cli();
+	uiDropped = uiTraceDropped;
+	SREG = ucSREG;
+
+	if ((uiTraceDroppedTotal + uiDropped) < uiTraceDroppedTotal)
+	{
+		return 0xFFFF;
+	}
+	return uiTraceDroppedTotal + uiDropped;
+}
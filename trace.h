@@ -0,0 +1,103 @@
+/******************************************************************************
+ * File Name:	trace.h
+ * Program:		Project for Real-Time Embedded Systems Programming class
+ * Purpose:		Header file for trace.c file.
+ ******************************************************************************/
+#if !defined(TRACE_H)		/* Prevents including this file multiple times */
+#define TRACE_H
+
+#include <avr/pgmspace.h>
+
+#include "lib.h"
+#include "errors.h"
+
+/* Trace levels. An event is recorded if its level is no higher than its
+ * module's level. */
+#define TRACE_OFF                       0
+#define TRACE_ERROR                     1
+#define TRACE_INFO                      2
+#define TRACE_DEBUG                     3
+
+/*
+ * Highest level compiled in for each module. TRACE calls above it are
+ * left out of the build altogether; the ones below it cost a test of the
+ * module's level while that's turned down.
+ */
+#define TRACE_MAX_DTOA                  TRACE_DEBUG
+#define TRACE_MAX_WAVE                  TRACE_INFO
+#define TRACE_MAX_SCHED                 TRACE_DEBUG
+#define TRACE_MAX_ARB                   TRACE_DEBUG
+#define TRACE_MAX_ERRORS                TRACE_DEBUG
+
+typedef enum
+{
+	TRACE_MODULE_DTOA = 0,
+	TRACE_MODULE_WAVE,
+	TRACE_MODULE_SCHED,
+	TRACE_MODULE_ARB,
+	TRACE_MODULE_ERRORS,
+	TRACE_NUM_MODULES
+} eTraceModuleType;
+
+/* What an event is. The value's meaning is given for each. */
+typedef enum
+{
+	TRACE_ID_DTOA_WRITE = 0,	// Sample written by WriteDtoASample
+	TRACE_ID_WAVE_START,		// Waveform (re)started: mode << 8 | shape
+	TRACE_ID_SCHED_RUN,			// Task started: its index in the task table
+	TRACE_ID_ARB_FRAME,			// Upload frame stored: sequence number
+	TRACE_ID_ARB_NAK,			// Upload frame refused: sequence expected
+	TRACE_ID_ERROR,				// Error reported: context << 8 | error code
+	TRACE_ID_SEQ_SEGMENT		// Sequence segment started: index << 8 | type
+} eTraceIdType;
+
+/* Events held until the foreground sends them. Must be a power of 2, no
+ * more than 256. When it's full, new events are dropped and counted. */
+#define TRACE_RING_SIZE                 32
+
+/*
+ * Events are sent on the serial port in binary frames, as soon as there
+ * are any and there's room:
+ *
+ *   Byte 0-1:  Sync, TRACE_SYNC1 then TRACE_SYNC2
+ *        2:    Number of events, N, 1 to TRACE_FRAME_EVENTS
+ *        3-4:  Events dropped since the last frame, LSB first. Stops at
+ *              0xFFFF.
+ *        5- :  N events of 5 bytes: time (Timer 3 counts, LSB first), ID,
+ *              value (LSB first)
+ *   Last 2:    CRC of bytes 2 up to the end of the events, LSB first.
+ *              XMODEM CRC, as for the memory dump.
+ */
+#define TRACE_SYNC1                     0xA5
+#define TRACE_SYNC2                     0x7E
+#define TRACE_FRAME_EVENTS              8
+#define TRACE_FRAME_SIZE                (5 + (TRACE_FRAME_EVENTS * 5) + 2)
+
+/* Module levels, read by TRACE. Use SetTraceLevel to change them. */
+extern unsigned char aucTraceLevel[TRACE_NUM_MODULES];
+
+/*
+ * Records an event for a module, e.g. TRACE(DTOA, TRACE_DEBUG,
+ * TRACE_ID_DTOA_WRITE, Value). Only the ID and value are stored; nothing
+ * is formatted, so it's safe in an ISR.
+ */
+#define TRACE(module, level, id, value)									\
+	do																	\
+	{																	\
+		if (((level) <= TRACE_MAX_##module) &&							\
+			((level) <= aucTraceLevel[TRACE_MODULE_##module]))			\
+		{																\
+			TraceEvent((id), (value));									\
+		}																\
+	} while (0)
+
+/* Function Prototypes */
+void TraceEvent(unsigned char, unsigned int);	// ID, value; use TRACE
+void ServiceTrace(void);						// Called from foreground loop
+eBooleanType TraceWorkPending(void);			// Called from IdleSleep
+eErrorType SetTraceLevel(unsigned char, unsigned char);	// Module, level
+unsigned char GetTraceLevel(unsigned char);
+PGM_P GetTraceModuleName(unsigned char);
+unsigned int GetTraceDropped(void);
+
+#endif /* TRACE_H */
@@ -0,0 +1,830 @@
+/******************************************************************************
+ * File Name:	waveform.c
+ * Program:		Project for Real-Time Embedded Systems Programming class
+ * Purpose:		Waveform generator. Timer 1 interrupts at the sample rate, and
+ *				its ISR sends the next sample to the D/A. Four modes:
+ *				- Table: the sample rate is Frequency * WAVE_TABLE_SIZE, and
+ *				  the ISR steps through a pre-computed table in RAM. All the
+ *				  arithmetic happens when the shape or amplitude changes.
+ *				- DDS: the sample rate is fixed at DDS_SAMPLE_RATE, and a
+ *				  32-bit phase accumulator indexes a sine table in flash.
+ *				  Frequency resolution is DDS_SAMPLE_RATE/2^32 Hz, and
+ *				  retuning only changes the phase step, so it's phase
+ *				  continuous.
+ *				- Stream: the sample rate is fixed at STREAM_SAMPLE_RATE, and
+ *				  the ISR plays whatever the foreground loop has put in the
+ *				  sample buffer. By default, the foreground computes the
+ *				  selected shape with its own phase accumulator.
+ *				- Arbitrary: like stream, but the samples come from a block
+ *				  uploaded over the serial port (see arb.c). Any shape but
+ *				  WAVE_OFF plays it.
+ *
+ *				Retuning while a waveform plays doesn't stop it. The
+ *				foreground writes the new frequency and amplitude settings
+ *				into a shadow copy, and whatever makes the samples takes it
+ *				over at the start of its next period: the table index or
+ *				phase wrapping, which is a zero crossing for the sine and
+ *				triangle. Changing mode or shape still restarts the
+ *				generator.
+ *
+ *				DDS mode can also play the segments of a sequence (see
+ *				sequence.c): a chirp, made by adding a fixed step to the
+ *				phase step every sample, or a burst of a number of periods.
+ ******************************************************************************/
+
+/********************************* Includes ***********************************/
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+
+#include "lib.h"
+#include "errors.h"
+#include "dtoa.h"
+#include "samplebuf.h"
+#include "arb.h"
+#include "profile.h"
+#include "power.h"
+#include "trace.h"
+#include "waveform.h"
+
+/******************************************************************************
+ * constants
+ *****************************************************************************/
+// D/A value at the middle of the output range
+#define WAVE_OFFSET             512
+
+// Largest D/A value
+#define DTOA_MAX_VALUE          1023
+
+/* One period of a sine wave, in D/A counts (0 to 1023), indexed by the top
+ * 8 bits of the DDS phase. The table mode uses every 4th entry. */
+static const unsigned int SineTable[256] PROGMEM =
+{
+	 512,  524,  537,  549,  562,  574,  587,  599,
+	 611,  624,  636,  648,  660,  672,  684,  696,
+	 707,  719,  730,  741,  753,  764,  774,  785,
+	 796,  806,  816,  826,  836,  846,  855,  864,
+	 873,  882,  890,  899,  907,  915,  922,  930,
+	 937,  944,  950,  957,  963,  968,  974,  979,
+	 984,  989,  993,  997, 1001, 1004, 1008, 1011,
+	1013, 1015, 1017, 1019, 1021, 1022, 1022, 1023,
+	1023, 1023, 1022, 1022, 1021, 1019, 1017, 1015,
+	1013, 1011, 1008, 1004, 1001,  997,  993,  989,
+	 984,  979,  974,  968,  963,  957,  950,  944,
+	 937,  930,  922,  915,  907,  899,  890,  882,
+	 873,  864,  855,  846,  836,  826,  816,  806,
+	 796,  785,  774,  764,  753,  741,  730,  719,
+	 707,  696,  684,  672,  660,  648,  636,  624,
+	 611,  599,  587,  574,  562,  549,  537,  524,
+	 512,  499,  486,  474,  461,  449,  436,  424,
+	 412,  399,  387,  375,  363,  351,  339,  327,
+	 316,  304,  293,  282,  270,  259,  249,  238,
+	 227,  217,  207,  197,  187,  177,  168,  159,
+	 150,  141,  133,  124,  116,  108,  101,   93,
+	  86,   79,   73,   66,   60,   55,   49,   44,
+	  39,   34,   30,   26,   22,   19,   15,   12,
+	  10,    8,    6,    4,    2,    1,    1,    0,
+	   0,    0,    1,    1,    2,    4,    6,    8,
+	  10,   12,   15,   19,   22,   26,   30,   34,
+	  39,   44,   49,   55,   60,   66,   73,   79,
+	  86,   93,  101,  108,  116,  124,  133,  141,
+	 150,  159,  168,  177,  187,  197,  207,  217,
+	 227,  238,  249,  259,  270,  282,  293,  304,
+	 316,  327,  339,  351,  363,  375,  387,  399,
+	 412,  424,  436,  449,  461,  474,  486,  499
+};
+
+/******************************************************************************
+ * global variables
+ *****************************************************************************/
+/* Samples for one period, in D/A counts. One is played while the other is
+ * rebuilt for a new amplitude. */
+static unsigned int auiWaveTables[2][WAVE_TABLE_SIZE];
+static volatile unsigned char ucWaveIndex = 0;
+
+/* Settings used to make the samples */
+typedef struct
+{
+	const unsigned int *ptrTable;	// Table mode: samples for one period
+	unsigned int uiTimerTop;		// Table mode: OCR1A
+	unsigned char ucClockSelect;	// Table mode: TCCR1B clock select bits
+	unsigned long ulIncrement;		// DDS, stream: phase step per sample
+	unsigned int uiAmplitude;		// DDS, stream: peak to peak, D/A counts
+	long lStep;						// DDS: added to ulIncrement each sample...
+	unsigned long ulStepsLeft;		// ...this many more times
+	unsigned int uiCyclesLeft;		// DDS: periods until silence; 0 = no end
+} WaveParamsType;
+
+/*
+ * ActiveParams are the ones in use. The foreground only writes them while
+ * nothing is making samples. Otherwise it writes ShadowParams, and sets
+ * bParamsPending once they're complete; the sample maker copies them over
+ * at the start of a period, and clears it. Clearing bParamsPending before
+ * writing ShadowParams again means they're never copied half written. It's
+ * one byte, and an ISR always runs to completion, so no interrupts need to
+ * be disabled.
+ */
+static WaveParamsType ActiveParams = { auiWaveTables[0], 0, 0, 0,
+									   WAVE_MAX_AMPLITUDE, 0, 0, 0 };
+static WaveParamsType ShadowParams = { auiWaveTables[0], 0, 0, 0,
+									   WAVE_MAX_AMPLITUDE, 0, 0, 0 };
+static volatile eBooleanType bParamsPending = FALSE;
+
+/* Set by the ISR when a burst's last period ends (see SetWaveSegment) */
+static volatile eBooleanType bBurstDone = FALSE;
+
+/* DDS phase accumulator. The top 8 bits of the phase index SineTable. */
+static unsigned long ulDDSPhase = 0;
+
+// Phase accumulator for the stream mode's foreground producer
+static unsigned long ulStreamPhase = 0;
+
+// Current settings
+static volatile eWaveModeType WaveMode = WAVE_MODE_TABLE;
+static volatile eWaveShapeType WaveShape = WAVE_OFF;
+static unsigned long ulWaveFrequency = 100 * WAVE_FREQ_SCALE;
+static unsigned int uiWaveAmplitude = WAVE_MAX_AMPLITUDE;
+
+// Frequency actually being made, after rounding, in mHz. Foreground only.
+static unsigned long ulWaveActualFrequency = 0;
+
+/******************************************************************************
+ * Function prototypes
+ *****************************************************************************/
+static int  GetShapeValue(eWaveShapeType Shape, unsigned char Index);
+static void BeginWaveParams(void);
+static void CommitWaveParams(void);
+static const unsigned int *FillWaveTable(void);
+static void BuildWaveTable(void);
+static void StartWaveTimer(void);
+static unsigned long GetFrequencyLimit(void);
+static unsigned long FractionToPhase(unsigned long Num, unsigned long Den);
+static void UpdatePhaseStep(void);
+static unsigned int GetSampleAtPhase(unsigned char ucPhase,
+									 unsigned int uiAmplitude);
+static unsigned int ProduceStreamSample(void);
+
+/******************************************************************************
+ * Initializes Timer 1 for the waveform generator. The timer is left stopped
+ * until a waveform is selected.
+ *****************************************************************************/
+void InitWaveform(void)
+{
+	/*------------------ Set TCCR1A values --------------------------
+	 * Bit 7: COM1A1 = 0  Normal port operation. No Output Compare
+	 *     6: COM1A0 = 0
+	 *     5: COM1B1 = 0
+	 *     4: COM1B0 = 0
+	 *     3: COM1C1 = 0
+	 *     2: COM1C0 = 0
+	 *     1: WGM11  = 0  Sets Waveform Generation mode to CTC, with
+	 *     0: WGM10  = 0  OCR1A as the TOP value
+	 */
+	TCCR1A = 0;
+
+	/*------------------ Set TCCR1B values --------------------------
+	 * Bit 7: ICNC1  = 0  No input capture
+	 *     6: ICES1  = 0
+	 *     5: unused = 0
+	 *     4: WGM13  = 0  Sets Waveform Generation mode to CTC
+	 *     3: WGM12  = 1
+	 *   2-0: CS1x   = 0  Clock stopped. StartWaveTimer() selects it.
+	 */
+	TCCR1B = _BV(WGM12);
+
+	/*----------------- Set TIMSK1 values -------------------------
+	 * Bit 1: OCIE1A = 0  Compare interrupt A is enabled by StartWaveTimer()
+	 */
+	TIMSK1 = 0;
+
+	TCNT1 = 0;
+}
+
+/******************************************************************************
+ * Selects table or DDS mode. If the current frequency is too high for the
+ * new mode, it's limited to the highest one allowed.
+ *****************************************************************************/
+eErrorType SetWaveMode(eWaveModeType Mode)
+{
+	if (Mode > WAVE_MODE_ARBITRARY)
+	{
+		return INVALID_PARAMETER;
+	}
+
+	CLEAR_BIT(TIMSK1, OCIE1A);
+	WaveMode = Mode;
+
+	// Only stream and arbitrary modes get their samples from the foreground
+	SetSampleProducer(0, 0);
+	FlushSampleBuffer();
+	if (ulWaveFrequency > GetFrequencyLimit())
+	{
+		ulWaveFrequency = GetFrequencyLimit();
+	}
+	BuildWaveTable();
+	return NO_ERROR;
+}
+
+/******************************************************************************
+ * Selects the waveform shape. WAVE_OFF stops the generator, leaving the D/A
+ * at its last value.
+ *****************************************************************************/
+eErrorType SetWaveShape(eWaveShapeType Shape)
+{
+	if (Shape > WAVE_SAWTOOTH)
+	{
+		return INVALID_PARAMETER;
+	}
+
+	WaveShape = Shape;
+	BuildWaveTable();
+	return NO_ERROR;
+}
+
+/******************************************************************************
+ * Sets the output frequency, in Hz.
+ *****************************************************************************/
+eErrorType SetWaveFrequency(unsigned int Frequency)
+{
+	return SetWaveFrequencyFine((unsigned long)Frequency * WAVE_FREQ_SCALE);
+}
+
+/******************************************************************************
+ * Sets the output frequency, in 1/WAVE_FREQ_SCALE Hz (mHz).
+ *
+ * In table mode, this sets the sample rate to Frequency * WAVE_TABLE_SIZE.
+ * In DDS and stream modes, only the phase step changes.
+ *****************************************************************************/
+eErrorType SetWaveFrequencyFine(unsigned long Frequency)
+{
+	if ((Frequency < (WAVE_MIN_FREQUENCY * WAVE_FREQ_SCALE)) ||
+		(Frequency > GetFrequencyLimit()))
+	{
+		return PARAMETER_OUT_OF_RANGE;
+	}
+
+	ulWaveFrequency = Frequency;
+
+	if (WaveMode != WAVE_MODE_TABLE)
+	{
+		UpdatePhaseStep();
+	}
+	else
+	{
+		StartWaveTimer();
+	}
+	return NO_ERROR;
+}
+
+/******************************************************************************
+ * Sets the peak-to-peak amplitude, in D/A counts, centered on mid-scale.
+ *****************************************************************************/
+eErrorType SetWaveAmplitude(unsigned int Amplitude)
+{
+	if (Amplitude > WAVE_MAX_AMPLITUDE)
+	{
+		return PARAMETER_OUT_OF_RANGE;
+	}
+
+	uiWaveAmplitude = Amplitude;
+
+	/* DDS and stream samples are scaled as they're made, so only the scale
+	 * changes. Table mode builds a new table beside the one playing. */
+	BeginWaveParams();
+	ShadowParams.uiAmplitude = Amplitude;
+	if ((WaveMode == WAVE_MODE_TABLE) && (WaveShape != WAVE_OFF))
+	{
+		ShadowParams.ptrTable = FillWaveTable();
+	}
+	CommitWaveParams();
+	return NO_ERROR;
+}
+
+/******************************************************************************
+ * Starts a change to the settings in ShadowParams. Any change not taken up
+ * yet is held back, so the new one can be added to it.
+ *****************************************************************************/
+static void BeginWaveParams(void)
+{
+	bParamsPending = FALSE;
+}
+
+/******************************************************************************
+ * Finishes a change to the settings in ShadowParams. If nothing is making
+ * samples from them, they're used at once; otherwise, from the start of the
+ * next period.
+ *****************************************************************************/
+static void CommitWaveParams(void)
+{
+	if (((TIMSK1 & _BV(OCIE1A)) == 0) || (WaveMode == WAVE_MODE_ARBITRARY))
+	{
+		ActiveParams = ShadowParams;
+	}
+	else
+	{
+		bParamsPending = TRUE;
+	}
+}
+
+/******************************************************************************
+ * Copies the new settings over. Called by whatever makes the samples, at
+ * the start of a period: the Timer 1 ISR, or in stream mode the foreground
+ * producer.
+ *****************************************************************************/
+static inline void TakeWaveParams(void)
+{
+	ActiveParams = ShadowParams;
+	bParamsPending = FALSE;
+}
+
+/******************************************************************************
+ * Copies the current settings, and the frequency actually being made, for
+ * display. Only call this from the foreground.
+ *****************************************************************************/
+void GetWaveStatus(WaveStatusType *ptrStatus)
+{
+	ptrStatus->Mode = WaveMode;
+	ptrStatus->Shape = WaveShape;
+	ptrStatus->uiAmplitude = uiWaveAmplitude;
+	ptrStatus->ulFrequency = ulWaveFrequency;
+	ptrStatus->ulActualFrequency = ((WaveShape == WAVE_OFF) ||
+									(WaveMode == WAVE_MODE_ARBITRARY)) ? 0 :
+										ulWaveActualFrequency;
+}
+
+/******************************************************************************
+ * Returns the DDS phase step for a frequency, in mHz, rounded down. This is
+ * what a WaveSegmentType's ulIncrement is made from.
+ *****************************************************************************/
+unsigned long GetWavePhaseStep(unsigned long Frequency)
+{
+	return FractionToPhase(Frequency, DDS_SAMPLE_RATE * WAVE_FREQ_SCALE);
+}
+
+/******************************************************************************
+ * Plays a segment of a sequence (see sequence.c), in place of the frequency
+ * and amplitude settings. DDS mode only. Like any other change, it starts
+ * with the next period; but if the segment playing is a chirp, it starts as
+ * soon as the chirp's last step is made, since the chirp leaves the
+ * frequency where the next one starts.
+ *
+ * Pass 0 to go back to the settings.
+ *****************************************************************************/
+eErrorType SetWaveSegment(const WaveSegmentType *ptrSegment)
+{
+	if (ptrSegment == 0)
+	{
+		BeginWaveParams();
+		ShadowParams.lStep = 0;
+		ShadowParams.ulStepsLeft = 0;
+		ShadowParams.uiCyclesLeft = 0;
+		ShadowParams.uiAmplitude = uiWaveAmplitude;
+		UpdatePhaseStep();
+		return NO_ERROR;
+	}
+
+	if ((WaveMode != WAVE_MODE_DDS) || (WaveShape == WAVE_OFF))
+	{
+		return INVALID_PARAMETER;
+	}
+	if (ptrSegment->uiAmplitude > WAVE_MAX_AMPLITUDE)
+	{
+		return PARAMETER_OUT_OF_RANGE;
+	}
+
+	BeginWaveParams();
+	ShadowParams.ulIncrement = ptrSegment->ulIncrement;
+	ShadowParams.lStep = ptrSegment->lStep;
+	ShadowParams.ulStepsLeft = (ptrSegment->lStep == 0) ? 0 :
+								ptrSegment->ulSteps;
+	ShadowParams.uiAmplitude = ptrSegment->uiAmplitude;
+	ShadowParams.uiCyclesLeft = ptrSegment->uiCycles;
+	bBurstDone = FALSE;
+	CommitWaveParams();
+	return NO_ERROR;
+}
+
+/******************************************************************************
+ * Returns TRUE while the last change of settings or segment hasn't been
+ * taken up yet.
+ *****************************************************************************/
+eBooleanType WaveSegmentPending(void)
+{
+	return bParamsPending;
+}
+
+/******************************************************************************
+ * Returns TRUE once the burst SetWaveSegment last started has played all of
+ * its periods.
+ *****************************************************************************/
+eBooleanType WaveBurstDone(void)
+{
+	return bBurstDone;
+}
+
+/******************************************************************************
+ * Returns the highest frequency allowed in the current mode, in mHz.
+ *****************************************************************************/
+static unsigned long GetFrequencyLimit(void)
+{
+	if (WaveMode == WAVE_MODE_DDS)
+	{
+		return DDS_MAX_FREQUENCY * WAVE_FREQ_SCALE;
+	}
+	else if (WaveMode >= WAVE_MODE_STREAM)
+	{
+		return (STREAM_SAMPLE_RATE / 2) * WAVE_FREQ_SCALE;
+	}
+	return WAVE_MAX_FREQUENCY * WAVE_FREQ_SCALE;
+}
+
+/******************************************************************************
+ * Returns (Num * 2^32) / Den, rounded down, for Num < Den < 2^31. This is
+ * the DDS phase step for a frequency of Num/Den of the sample rate. It's a
+ * long division done a bit at a time, so we don't need 64-bit arithmetic.
+ *****************************************************************************/
+static unsigned long FractionToPhase(unsigned long Num, unsigned long Den)
+{
+	unsigned long Quotient = 0;
+	unsigned char i;
+
+	for (i = 0; i < 32; ++i)
+	{
+		Num <<= 1;
+		Quotient <<= 1;
+		if (Num >= Den)
+		{
+			Num -= Den;
+			Quotient |= 1;
+		}
+	}
+	return Quotient;
+}
+
+/******************************************************************************
+ * Returns (A * B) / 2^32, rounded down. It's built from four 16 x 16-bit
+ * products, so we don't need 64-bit arithmetic.
+ *****************************************************************************/
+unsigned long MultiplyHigh(unsigned long A, unsigned long B)
+{
+	unsigned long High  = (A >> 16) * (B >> 16);
+	unsigned long Mid1  = (A >> 16) * (B & 0xFFFF);
+	unsigned long Mid2  = (A & 0xFFFF) * (B >> 16);
+	unsigned long Low   = (A & 0xFFFF) * (B & 0xFFFF);
+	unsigned long Carry = (Low >> 16) + (Mid1 & 0xFFFF) + (Mid2 & 0xFFFF);
+
+	return High + (Mid1 >> 16) + (Mid2 >> 16) + (Carry >> 16);
+}
+
+/******************************************************************************
+ * Sets the DDS phase step for the current frequency and sample rate. It
+ * takes effect at the start of the next period, so it's phase continuous.
+ *****************************************************************************/
+static void UpdatePhaseStep(void)
+{
+	unsigned long Increment;
+	unsigned long SampleRate;
+
+	SampleRate = (WaveMode == WAVE_MODE_DDS) ?
+					(DDS_SAMPLE_RATE * WAVE_FREQ_SCALE) :
+					(STREAM_SAMPLE_RATE * WAVE_FREQ_SCALE);
+	Increment = FractionToPhase(ulWaveFrequency, SampleRate);
+	BeginWaveParams();
+	ShadowParams.ulIncrement = Increment;
+	CommitWaveParams();
+
+	// The step is rounded down, so say what it really gives
+	ulWaveActualFrequency = MultiplyHigh(Increment, SampleRate);
+}
+
+/******************************************************************************
+ * Returns the value of the selected shape at the specified table index,
+ * scaled to the range -512 to 511.
+ *****************************************************************************/
+static int GetShapeValue(eWaveShapeType Shape, unsigned char Index)
+{
+	int Value;
+
+	switch (Shape)
+	{
+		case WAVE_SINE:
+			Value = (int)pgm_read_word(&SineTable[Index *
+						(256/WAVE_TABLE_SIZE)]) - 512;
+			break;
+
+		case WAVE_SQUARE:
+			Value = (Index < (WAVE_TABLE_SIZE/2)) ? 511 : -512;
+			break;
+
+		case WAVE_TRIANGLE:
+			// Rise from 0 for a quarter period, fall for a half, then rise
+			if (Index < (WAVE_TABLE_SIZE/4))
+			{
+				Value = Index * (2048/WAVE_TABLE_SIZE);
+			}
+			else if (Index < (3*WAVE_TABLE_SIZE/4))
+			{
+				Value = ((WAVE_TABLE_SIZE/2) - Index) * (2048/WAVE_TABLE_SIZE);
+			}
+			else
+			{
+				Value = (Index - WAVE_TABLE_SIZE) * (2048/WAVE_TABLE_SIZE);
+			}
+
+			if (Value > 511)
+			{
+				Value = 511;
+			}
+			break;
+
+		case WAVE_SAWTOOTH:
+			Value = (Index * (1024/WAVE_TABLE_SIZE)) - 512;
+			break;
+
+		default:
+			Value = 0;
+			break;
+	}
+
+	return Value;
+}
+
+/******************************************************************************
+ * Fills the table that isn't being played with one period of the current
+ * shape and amplitude, and returns it. Call after BeginWaveParams, so the
+ * one being played can't change meanwhile.
+ *****************************************************************************/
+static const unsigned int *FillWaveTable(void)
+{
+	unsigned int *ptrTable;
+	unsigned char i;
+	long Sample;
+
+	ptrTable = (ActiveParams.ptrTable == auiWaveTables[0]) ?
+					auiWaveTables[1] : auiWaveTables[0];
+
+	for (i = 0; i < WAVE_TABLE_SIZE; ++i)
+	{
+		Sample = WAVE_OFFSET +
+			(((long)GetShapeValue(WaveShape, i) * uiWaveAmplitude) >> 10);
+
+		if (Sample < 0)
+		{
+			Sample = 0;
+		}
+		else if (Sample > DTOA_MAX_VALUE)
+		{
+			Sample = DTOA_MAX_VALUE;
+		}
+
+		ptrTable[i] = (unsigned int)Sample;
+	}
+	return ptrTable;
+}
+
+/******************************************************************************
+ * Gets the current mode and shape ready, then (re)starts the timer. The
+ * Timer 1 interrupt is disabled meanwhile; the output simply holds its last
+ * value for that time.
+ *****************************************************************************/
+static void BuildWaveTable(void)
+{
+	CLEAR_BIT(TIMSK1, OCIE1A);
+
+	if (WaveShape == WAVE_OFF)
+	{	// Leave timer stopped
+		TCCR1B = _BV(WGM12);
+		return;
+	}
+
+	// A restart plays the settings, not whatever segment was playing
+	ShadowParams.lStep = 0;
+	ShadowParams.ulStepsLeft = 0;
+	ShadowParams.uiCyclesLeft = 0;
+	ShadowParams.uiAmplitude = uiWaveAmplitude;
+
+	if (WaveMode == WAVE_MODE_TABLE)
+	{
+		BeginWaveParams();
+		ShadowParams.ptrTable = FillWaveTable();
+		CommitWaveParams();
+	}
+	else if (WaveMode == WAVE_MODE_DDS)
+	{
+		UpdatePhaseStep();
+	}
+	else if (WaveMode == WAVE_MODE_STREAM)
+	{	// Prime the buffer before the timer starts.
+		UpdatePhaseStep();
+		SetSampleProducer(0, ProduceStreamSample);
+		ServiceSampleBuffer();
+	}
+	else
+	{	// Arbitrary mode. The shape only turns it on or off.
+		SetSampleProducer(0, ProduceArbSample);
+		ServiceSampleBuffer();
+	}
+
+	StartWaveTimer();
+}
+
+/******************************************************************************
+ * Programs Timer 1 for the current sample rate, and enables its interrupt if
+ * a waveform is selected. The fixed rates' prescalers come from config.h.
+ * Table mode uses no prescaling if the count fits in 16 bits; otherwise it
+ * divides the clock by 8. If table mode is already playing, the ISR changes
+ * the rate at the start of the next period instead.
+ *****************************************************************************/
+static void StartWaveTimer(void)
+{
+	unsigned long Count;
+	unsigned char ClockSelect;
+	unsigned char ucSREG;
+
+	if (WaveShape == WAVE_OFF)
+	{
+		return;
+	}
+
+	if (WaveMode == WAVE_MODE_DDS)
+	{	// Fixed rates are worked out by the compiler
+		Count = DDS_TIMER_CNT;
+		ClockSelect = (DDS_TIMER_CS << CS10);
+	}
+	else if (WaveMode >= WAVE_MODE_STREAM)
+	{
+		Count = STREAM_TIMER_CNT;
+		ClockSelect = (STREAM_TIMER_CS << CS10);
+	}
+	else
+	{
+		Count = ((F_CPU / WAVE_TABLE_SIZE) * WAVE_FREQ_SCALE) / ulWaveFrequency;
+
+		if (Count > TIMER1_TOP)
+		{	// clk/8
+			Count /= 8;
+			ClockSelect = _BV(CS11);
+		}
+		else
+		{	// clk/1
+			ClockSelect = _BV(CS10);
+		}
+	}
+
+	if (WaveMode == WAVE_MODE_TABLE)
+	{	// Count was rounded down, so say what it really gives
+		ulWaveActualFrequency = ((F_CPU / WAVE_TABLE_SIZE) * WAVE_FREQ_SCALE) /
+					(Count * ((ClockSelect == _BV(CS11)) ? 8 : 1));
+	}
+
+	BeginWaveParams();
+	ShadowParams.uiTimerTop = (unsigned int)(Count - 1);
+	ShadowParams.ucClockSelect = ClockSelect;
+	if ((TIMSK1 & _BV(OCIE1A)) != 0)
+	{	// Retuning table mode
+		CommitWaveParams();
+		return;
+	}
+	CommitWaveParams();
+
+	TRACE(WAVE, TRACE_INFO, TRACE_ID_WAVE_START,
+		  ((unsigned int)WaveMode << 8) | WaveShape);
+
+	/* 16-bit timer registers are written through a shared TEMP register,
+	 * so don't let an interrupt in while we write them. */
+	ucSREG = SREG;
+	cli();
+	OCR1A = ActiveParams.uiTimerTop;
+	if (TCNT1 >= OCR1A)
+	{	// Lowering TOP below the count would make us wait for a wrap
+		TCNT1 = 0;
+	}
+	TCCR1B = _BV(WGM12) | ClockSelect;
+	SET_BIT(TIMSK1, OCIE1A);
+	SREG = ucSREG;
+}
+
+/******************************************************************************
+ * Returns the sample of the current shape and amplitude at the specified
+ * phase (the top 8 bits of a phase accumulator), in D/A counts. This is the
+ * DDS sample calculation; it's inline so the ISR doesn't pay for a call.
+ *****************************************************************************/
+static inline unsigned int GetSampleAtPhase(unsigned char ucPhase,
+											unsigned int uiAmplitude)
+{
+	int Value;
+
+	switch (WaveShape)
+	{
+		case WAVE_SINE:
+			Value = (int)pgm_read_word(&SineTable[ucPhase]) - 512;
+			break;
+
+		case WAVE_SQUARE:
+			Value = (ucPhase & 0x80) ? -512 : 511;
+			break;
+
+		case WAVE_TRIANGLE:
+			// Shift by a quarter period, so we start at 0 and rising
+			ucPhase += 64;
+			Value = ((ucPhase & 0x80) ? (255 - ucPhase) : ucPhase) * 8 - 512;
+			break;
+
+		default:	// WAVE_SAWTOOTH
+			Value = ((int)ucPhase << 2) - 512;
+			break;
+	}
+
+	return WAVE_OFFSET + (int)(((long)Value * uiAmplitude) >> 10);
+}
+
+/******************************************************************************
+ * Sample producer for stream mode. Called from the foreground loop to
+ * compute the next sample. New settings are taken over when the phase
+ * wraps; the ISR only plays the samples.
+ *****************************************************************************/
+static unsigned int ProduceStreamSample(void)
+{
+	ulStreamPhase += ActiveParams.ulIncrement;
+	if ((bParamsPending == TRUE) && (ulStreamPhase < ActiveParams.ulIncrement))
+	{
+		TakeWaveParams();
+	}
+	return GetSampleAtPhase((unsigned char)(ulStreamPhase >> 24),
+							ActiveParams.uiAmplitude);
+}
+
+/******************************************************************************
+ * Interrupt handlers
+ *****************************************************************************/
+/*
+ * Timer 1 Compare A interrupt. Runs once per sample, so keep this short.
+ * Table mode is one lookup; DDS mode is one add, one flash read (or a few
+ * shifts for the other shapes), and one multiply to scale the amplitude.
+ * A chirp adds one more add and a count; a burst, a count once a period.
+ * Stream and arbitrary modes take the next frame from the sample buffer, and
+ * send every D/A channel in one burst; on an underrun, the D/As just hold
+ * their last values. The other modes drive channel 0.
+ */
+ISR(TIMER1_COMPA_vect)
+{
+	DtoAFrameType Frame;
+	eBooleanType bWrapped;
+	unsigned int uiLatency = TCNT1;		// Read first; it's counting from the match
+	PROFILE_START(PROFILE_TIMER1);
+
+	if (WaveMode == WAVE_MODE_TABLE)
+	{
+		if ((ucWaveIndex == 0) && (bParamsPending == TRUE))
+		{	// Start of a period. The new rate starts with this sample.
+			TakeWaveParams();
+			OCR1A = ActiveParams.uiTimerTop;
+			if (TCNT1 >= OCR1A)
+			{
+				TCNT1 = 0;
+			}
+			TCCR1B = _BV(WGM12) | ActiveParams.ucClockSelect;
+		}
+		WriteDtoASampleAsync(ActiveParams.ptrTable[ucWaveIndex]);
+		ucWaveIndex = (ucWaveIndex + 1) & (WAVE_TABLE_SIZE - 1);
+	}
+	else if (WaveMode == WAVE_MODE_DDS)
+	{
+		ulDDSPhase += ActiveParams.ulIncrement;
+		bWrapped = (ulDDSPhase < ActiveParams.ulIncrement) ? TRUE : FALSE;
+
+		// Count the burst's periods before any new settings start another
+		if ((bWrapped == TRUE) && (ActiveParams.uiCyclesLeft != 0) &&
+			(--ActiveParams.uiCyclesLeft == 0))
+		{	// Silence at mid-scale, from the zero crossing
+			ActiveParams.uiAmplitude = 0;
+			bBurstDone = TRUE;
+		}
+
+		if (ActiveParams.ulStepsLeft != 0)
+		{	// Chirping. The next segment waits until it's done.
+			ActiveParams.ulIncrement += ActiveParams.lStep;
+			--ActiveParams.ulStepsLeft;
+		}
+		else if ((bParamsPending == TRUE) &&
+				 ((bWrapped == TRUE) || (ActiveParams.lStep != 0)))
+		{	// Start of a period, or the end of a chirp
+			TakeWaveParams();
+		}
+		WriteDtoASampleAsync(GetSampleAtPhase((unsigned char)(ulDDSPhase >> 24),
+											  ActiveParams.uiAmplitude));
+	}
+	else if (GetSample(&Frame) == TRUE)
+	{
+		WriteDtoAFrame(&Frame);
+	}
+
+	/* At clk/1 the count is in CPU cycles. At clk/8 it's too coarse to be
+	 * worth recording. */
+	if ((TCCR1B & (_BV(CS12) | _BV(CS11) | _BV(CS10))) == _BV(CS10))
+	{
+		RecordSampleLatency(uiLatency);
+	}
+
+	PROFILE_END(PROFILE_TIMER1);
+}
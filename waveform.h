@@ -0,0 +1,93 @@
+/******************************************************************************
+ * File Name:	waveform.h
+ * Program:		Project for Real-Time Embedded Systems Programming class
+ * Purpose:		Header file for waveform.c file.
+ ******************************************************************************/
+#if !defined(WAVEFORM_H)	/* Prevents including this file multiple times */
+#define WAVEFORM_H
+
+#include "lib.h"
+#include "errors.h"
+#include "config.h"
+
+/* Number of samples in one period of the waveform table. Must be a power
+ * of 2, so the ISR can wrap its index with a mask. */
+#define WAVE_TABLE_SIZE                 64
+
+/* Fastest rate the sample ISR is allowed to run, in samples/second. Each
+ * sample costs one Timer 1 and two SPI interrupts. */
+#define WAVE_MAX_SAMPLE_RATE            20000
+
+/* Frequency limits, in Hz */
+#define WAVE_MIN_FREQUENCY              1
+#define WAVE_MAX_FREQUENCY              (WAVE_MAX_SAMPLE_RATE/WAVE_TABLE_SIZE)
+
+/* DDS mode runs at a fixed sample rate, DDS_SAMPLE_RATE in config.h. The
+ * highest usable frequency is half of it. Stream and arbitrary modes play
+ * samples from the sample buffer at STREAM_SAMPLE_RATE. */
+#define DDS_MAX_FREQUENCY               (DDS_SAMPLE_RATE/2)
+
+/* SetWaveFrequencyFine takes frequencies in units of 1/WAVE_FREQ_SCALE Hz */
+#define WAVE_FREQ_SCALE                 1000UL
+
+/* Maximum peak-to-peak amplitude, in D/A counts */
+#define WAVE_MAX_AMPLITUDE              1023
+
+typedef enum
+{
+	WAVE_MODE_TABLE = 0,
+	WAVE_MODE_DDS,
+	WAVE_MODE_STREAM,
+	WAVE_MODE_ARBITRARY		// Plays a block uploaded by arb.c
+} eWaveModeType;
+
+typedef enum
+{
+	WAVE_OFF = 0,
+	WAVE_SINE,
+	WAVE_SQUARE,
+	WAVE_TRIANGLE,
+	WAVE_SAWTOOTH
+} eWaveShapeType;
+
+/* Settings, and what's actually being made, for display */
+typedef struct
+{
+	eWaveModeType Mode;
+	eWaveShapeType Shape;
+	unsigned int uiAmplitude;			// Peak to peak, D/A counts
+	unsigned long ulFrequency;			// Setting, mHz
+	unsigned long ulActualFrequency;	// After rounding, mHz. 0 when off,
+										// or playing an uploaded block.
+} WaveStatusType;
+
+/*
+ * One segment of a sequence, for SetWaveSegment. DDS mode only. The phase
+ * step starts at ulIncrement (see GetWavePhaseStep), and lStep is added to
+ * it every sample, ulSteps times; an lStep of 0 gives a steady tone. With
+ * uiCycles set, the output goes to mid-scale after that many periods.
+ */
+typedef struct
+{
+	unsigned long ulIncrement;			// DDS phase step to start with
+	long lStep;							// Added to it every sample...
+	unsigned long ulSteps;				// ...this many times
+	unsigned int uiAmplitude;			// Peak to peak, D/A counts
+	unsigned int uiCycles;				// Periods to play; 0 = no end
+} WaveSegmentType;
+
+/* Function Prototypes */
+void InitWaveform(void);
+eErrorType SetWaveMode(eWaveModeType);
+eErrorType SetWaveShape(eWaveShapeType);
+eErrorType SetWaveFrequency(unsigned int);	// Hz
+eErrorType SetWaveFrequencyFine(unsigned long);	// mHz
+eErrorType SetWaveAmplitude(unsigned int);	// Peak to peak, D/A counts
+void GetWaveStatus(WaveStatusType *);
+unsigned long GetWavePhaseStep(unsigned long);	// mHz
+eErrorType SetWaveSegment(const WaveSegmentType *);	// 0 = settings again
+eBooleanType WaveSegmentPending(void);
+eBooleanType WaveBurstDone(void);
+unsigned long MultiplyHigh(unsigned long, unsigned long);	// (A * B) / 2^32
+
+#endif /* WAVEFORM_H */